@@ -0,0 +1,111 @@
+#include <cstdint>
+#include <cstdlib>  // atoi
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>  // move
+#include <vector>
+
+#include "bench_utils.h"
+#include "benchmarks.h"
+#include "files/file_utils.h"
+#include "util/json.h"
+
+using namespace Anno;
+
+// Installation sizes to benchmark, from a small mod collection up to a stress test
+static const std::vector<int> fixture_scales = { 10, 1000, 50000 };
+
+static Bench::GeneratedInstall generate_fixture(int num_scenarios)
+{
+    Bench::GeneratorOptions options;
+    options.num_scenarios = num_scenarios;
+    return Bench::generate_install(Bench::get_scratch_dir() / std::format("install_{}", num_scenarios), options);
+}
+
+static void print_usage()
+{
+    std::cerr << "Usage: AnnoToolBench [--json <path>] [--max-scenarios <n>]\n";
+}
+
+static void write_json_results(const std::filesystem::path& path)
+{
+    std::vector<Json::Value> results;
+    results.reserve(Bench::reported_results.size());
+    for (const auto& result : Bench::reported_results)
+    {
+        Json::Value entry;
+        entry.set("group", result.group);
+        entry.set("name", result.name);
+        entry.set("ns_per_iteration", static_cast<std::int64_t>(result.seconds_per_iteration * 1e9));
+        entry.set("bytes_per_iteration", static_cast<std::int64_t>(result.bytes_per_iteration));
+        entry.set("iterations", result.num_iterations);
+        results.push_back(std::move(entry));
+    }
+
+    Json::Value document;
+    document.set("results", std::move(results));
+    FileUtils::write_text_file(path, document.to_string() + '\n');
+}
+
+int main(int argc, char* argv[])
+{
+    std::filesystem::path json_path;
+    int max_scenarios = fixture_scales.back();
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        if (arg == "--json" && i + 1 < argc)
+        {
+            json_path = argv[++i];
+        }
+        else if (arg == "--max-scenarios" && i + 1 < argc)
+        {
+            max_scenarios = std::atoi(argv[++i]);
+        }
+        else
+        {
+            print_usage();
+            return 1;
+        }
+    }
+
+    Bench::begin_group("CodCodec");
+    Bench::run_cod_codec_benchmarks();
+
+    Bench::begin_group("TextCodFile");
+    Bench::run_text_cod_benchmarks();
+
+    Bench::begin_group("GameDatFile");
+    Bench::run_game_dat_benchmarks();
+
+    for (int num_scenarios : fixture_scales)
+    {
+        if (num_scenarios > max_scenarios)
+        {
+            break;
+        }
+
+        const Bench::GeneratedInstall install = generate_fixture(num_scenarios);
+
+        Bench::begin_group("ScenarioFile");
+        Bench::run_scenario_benchmarks(install);
+
+        Bench::begin_group("Tool");
+        Bench::run_tool_benchmarks(install);
+
+        // These can be fairly large
+        std::filesystem::remove_all(install.anno_dir);
+    }
+
+    if (!json_path.empty())
+    {
+        write_json_results(json_path);
+        std::cout << "\nResults written to " << json_path.string() << '\n';
+    }
+
+    return 0;
+}
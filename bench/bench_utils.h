@@ -0,0 +1,159 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <utility>  // move
+#include <vector>
+
+namespace Anno { namespace Bench {
+
+struct Result
+{
+    /** Group that the benchmark belongs to, e.g. the class under test. */
+    std::string group;
+
+    std::string name;
+
+    /** Average time taken by a single iteration. */
+    double seconds_per_iteration = 0.0;
+
+    /** Number of bytes processed by a single iteration, or 0 if not applicable. */
+    size_t bytes_per_iteration = 0;
+
+    int num_iterations = 0;
+};
+
+/** Minimum time spent measuring each benchmark, to smooth out noise. */
+static constexpr double min_measurement_seconds = 0.5;
+
+/** Runs `func` repeatedly (after a warm-up run) and measures the average time taken. */
+template <typename Func>
+Result measure(std::string name, size_t bytes_per_iteration, Func&& func)
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Warm up caches, page in buffers, etc.
+    func();
+
+    int num_iterations = 0;
+    const auto start = Clock::now();
+    std::chrono::duration<double> elapsed {};
+    do
+    {
+        func();
+        ++num_iterations;
+        elapsed = Clock::now() - start;
+    } while (elapsed.count() < min_measurement_seconds);
+
+    return { {}, std::move(name), elapsed.count() / num_iterations, bytes_per_iteration, num_iterations };
+}
+
+/** Like `measure`, but calls `setup` before every iteration, without timing it.
+ * This is useful for benchmarks that modify their inputs. */
+template <typename Setup, typename Func>
+Result measure_with_setup(std::string name, size_t bytes_per_iteration, Setup&& setup, Func&& func)
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Warm up caches, page in buffers, etc.
+    setup();
+    func();
+
+    int num_iterations = 0;
+    std::chrono::duration<double> elapsed {};
+    do
+    {
+        setup();
+        const auto start = Clock::now();
+        func();
+        elapsed += Clock::now() - start;
+        ++num_iterations;
+    } while (elapsed.count() < min_measurement_seconds);
+
+    return { {}, std::move(name), elapsed.count() / num_iterations, bytes_per_iteration, num_iterations };
+}
+
+// Group that results are currently being reported under
+inline std::string current_group;
+
+// Every result reported so far, in order
+inline std::vector<Result> reported_results;
+
+/** Starts a new group of results. */
+inline void begin_group(std::string group)
+{
+    std::cout << (reported_results.empty() ? "" : "\n") << group << ":\n";
+    current_group = std::move(group);
+}
+
+/** Prints a benchmark result to the console, and records it under the current group. */
+inline void print_result(Result result)
+{
+    std::cout << "  " << result.name << ": " << (result.seconds_per_iteration * 1000.0) << " ms";
+    if (result.bytes_per_iteration > 0)
+    {
+        const double gb_per_second = result.bytes_per_iteration / result.seconds_per_iteration / 1e9;
+        std::cout << " (" << gb_per_second << " GB/s)";
+    }
+    std::cout << '\n';
+
+    result.group = current_group;
+    reported_results.push_back(std::move(result));
+}
+
+/** Gets a scratch directory for any files needed by the benchmarks, creating it if necessary. */
+inline std::filesystem::path get_scratch_dir()
+{
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "AnnoToolBench";
+    std::filesystem::create_directories(dir);
+    return dir;
+}
+
+// Written to by `do_not_optimize`
+inline volatile char do_not_optimize_sink = 0;
+
+/** Discards anything written to it, e.g. for silencing the console while a benchmark runs. */
+class NullBuffer : public std::streambuf
+{
+protected:
+    int overflow(int c) override
+    {
+        return c;
+    }
+};
+
+/** Redirects a stream to a NullBuffer for as long as it exists. */
+class ScopedSilence
+{
+public:
+    explicit ScopedSilence(std::ostream& stream)
+        : stream(stream)
+        , original_buffer(stream.rdbuf(&null_buffer))
+    {
+    }
+
+    ~ScopedSilence()
+    {
+        stream.rdbuf(original_buffer);
+    }
+
+    ScopedSilence(const ScopedSilence&) = delete;
+    ScopedSilence& operator=(const ScopedSilence&) = delete;
+
+private:
+    NullBuffer null_buffer;
+    std::ostream& stream;
+    std::streambuf* original_buffer;
+};
+
+/** Prevents the compiler from optimising away a computation whose result is otherwise unused. */
+template <typename T>
+void do_not_optimize(const T& value)
+{
+    do_not_optimize_sink = *reinterpret_cast<const volatile char*>(&value);
+}
+
+}}  // namespace Anno::Bench
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "install_generator.h"
+
+namespace Anno { namespace Bench {
+
+void run_cod_codec_benchmarks();
+void run_text_cod_benchmarks();
+void run_game_dat_benchmarks();
+void run_scenario_benchmarks(const GeneratedInstall& install);
+void run_tool_benchmarks(const GeneratedInstall& install);
+
+}}  // namespace Anno::Bench
@@ -0,0 +1,54 @@
+#include <vector>
+
+#include "bench_utils.h"
+#include "benchmarks.h"
+#include "files/cod_codec.h"
+
+namespace Anno { namespace Bench {
+
+// Roughly 4x the size of the game's `text.cod`, so that the timings are not dominated by overhead
+static constexpr size_t buffer_size = 4 * 1024 * 1024;
+
+// The original implementation, kept here as a baseline
+static void transform_chars_legacy(std::vector<char>& buffer)
+{
+    for (int i = 0; i < static_cast<int>(buffer.size()); ++i)
+    {
+        buffer[i] = -buffer[i] & 0xff;
+    }
+}
+
+void run_cod_codec_benchmarks()
+{
+    std::vector<char> src(buffer_size);
+    for (size_t i = 0; i < src.size(); ++i)
+    {
+        src[i] = static_cast<char>(i * 31);
+    }
+    std::vector<char> dst(buffer_size);
+
+    print_result(measure("Legacy loop (in-place)", buffer_size, [&]() {
+        transform_chars_legacy(dst);
+        do_not_optimize(dst[0]);
+    }));
+
+    for (const auto kernel : { CodCodec::Kernel::Scalar, CodCodec::Kernel::SSE2, CodCodec::Kernel::AVX2 })
+    {
+        if (!CodCodec::is_kernel_supported(kernel))
+        {
+            continue;
+        }
+
+        const std::string kernel_name(CodCodec::get_kernel_name(kernel));
+        print_result(measure(kernel_name + " (out-of-place)", buffer_size, [&]() {
+            CodCodec::transform_with_kernel(kernel, src, dst);
+            do_not_optimize(dst[0]);
+        }));
+        print_result(measure(kernel_name + " (in-place)", buffer_size, [&]() {
+            CodCodec::transform_with_kernel(kernel, dst, dst);
+            do_not_optimize(dst[0]);
+        }));
+    }
+}
+
+}}  // namespace Anno::Bench
@@ -0,0 +1,520 @@
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/regex.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/regex.hpp>
+
+#include <array>
+#include <format>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bench_utils.h"
+#include "benchmarks.h"
+#include "files/file_utils.h"
+#include "files/game_dat_file.h"
+
+namespace Anno { namespace Bench {
+
+// Enough for every campaign slot to be in use
+static constexpr int num_campaigns = 512;
+
+static std::filesystem::path write_game_dat()
+{
+    std::string text = "\n  Musik:     TRUE, 0\n  Samples:   TRUE\n  Random:    TRUE\n  Volume:    80, 80, -595\n"
+                       "  VideoQual: TRUE\n\n  \n";
+    for (int i = 0; i < 8; ++i)
+    {
+        text += std::format("  Speach:    {}, FALSE\n", i);
+    }
+    text += "  \n";
+    for (int i = 0; i < 8; ++i)
+    {
+        text += std::format("  Video:     {}, FALSE\n", i);
+    }
+    text += "  \n  Lastfile: \"\"\n\n  Endlosnr: 0\n  Tutornr:  0\n\n";
+    for (int i = 0; i < num_campaigns; ++i)
+    {
+        text += std::format("  Kampagne: {}, {}\n", i, i % 4);
+    }
+    text += "  \n  Objekt:   SPIELNAME\n\n";
+    for (int i = 0; i < 12; ++i)
+    {
+        text += std::format("    Name:{:>7}, \"Savegame {}\", 1\n", i, i);
+    }
+    text += "  \n  EndObj;\n\n";
+
+    const std::filesystem::path path = get_scratch_dir() / "Game.dat";
+    FileUtils::write_text_file(path, text);
+    return path;
+}
+
+/*
+ * The original implementation, kept here as a baseline. Apart from some casts (to satisfy our warnings), this is the
+ * reader and writer as they were before `GameDatFile` was rewritten.
+ */
+
+namespace {
+
+class LegacyGameDatFile
+{
+    struct SaveSlot
+    {
+        std::string name;
+        int num_players = 1;
+    };
+
+public:
+    LegacyGameDatFile(const std::filesystem::path& path, GameVersion game_version)
+        : game_version(game_version)
+    {
+        read_dat_file(path);
+    }
+
+    // Split out of the original `save_to_path` (without any other changes), so that it can be measured on its own
+    std::string serialize() const;
+
+    void save_to_path(const std::filesystem::path& path) const
+    {
+        FileUtils::write_text_file(path, serialize());
+    }
+
+private:
+    void read_dat_file(const std::filesystem::path& path);
+    bool parse_bool_setting(const std::string& line) const;
+    int parse_int_setting(const std::string& line, int default_value = 0) const;
+    void parse_music_setting(const std::string& line);
+    void parse_volume_setting(const std::string& line);
+    void parse_disabled_music_track(const std::string& line);
+    void parse_disabled_speech(const std::string& line);
+    void parse_disabled_video(const std::string& line);
+    void parse_autosave(const std::string& line);
+    void parse_campaign_progress(const std::string& line);
+    void parse_save_slots(const std::vector<std::string>& lines, size_t& i);
+
+    static constexpr int num_speech_categories = 8;
+    static constexpr int num_video_categories = 8;
+    static constexpr int num_savegames = 12;
+
+    GameVersion game_version;
+
+    int music_bitmask = 0;
+    int music_volume = 0;
+    int sound_volume = 0;
+    int main_game_progress = -595;
+    bool is_music_enabled = true;
+    bool is_music_shuffle_enabled = true;
+    bool is_sound_enabled = true;
+    bool video_quality_flag = true;
+    std::vector<int> disabled_music_tracks;
+    std::array<bool, num_speech_categories> disabled_speech {};
+    std::array<bool, num_video_categories> disabled_videos {};
+    std::string last_save_file;
+    int continuous_play_selection = 0;
+    int tutorial_selection = 0;
+    std::map<int, int> campaign_progress;
+    std::array<SaveSlot, num_savegames> save_slots;
+};
+
+std::string extract_value(const std::string& line)
+{
+    const auto split_pos = line.find(':');
+    if (split_pos == std::string::npos)
+    {
+        std::cerr << "Failed to extract value from line: " << line << '\n';
+        return "";
+    }
+
+    std::string value = line.substr(split_pos + 1);
+    boost::algorithm::trim(value);
+    return value;
+}
+
+bool extract_multipart_value(const std::string& line, std::vector<std::string>& parts, size_t expected_num_parts)
+{
+    const std::string value = extract_value(line);
+    if (value.empty())
+    {
+        return false;
+    }
+
+    boost::algorithm::split_regex(parts, value, boost::regex(",\\s*"));
+    if (parts.size() != expected_num_parts)
+    {
+        std::cerr << "Failed to find " << expected_num_parts << " values in line: " << line << '\n';
+        return false;
+    }
+
+    return true;
+}
+
+void trim_quotes(std::string& line)
+{
+    boost::trim_if(line, boost::is_any_of("\""));
+}
+
+std::string bool_as_str(bool b)
+{
+    return b ? "TRUE" : "FALSE";
+}
+
+void LegacyGameDatFile::read_dat_file(const std::filesystem::path& path)
+{
+    std::vector<std::string> lines = FileUtils::read_text_file(path);
+
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        std::string line = boost::trim_copy(lines[i]);
+
+        if (line.empty())
+        {
+            continue;
+        }
+
+        if (line.starts_with("Musik:"))
+        {
+            parse_music_setting(line);
+        }
+        else if (line.starts_with("Samples:"))
+        {
+            is_sound_enabled = parse_bool_setting(line);
+        }
+        else if (line.starts_with("Random:"))
+        {
+            is_music_shuffle_enabled = parse_bool_setting(line);
+        }
+        else if (line.starts_with("Volume:"))
+        {
+            parse_volume_setting(line);
+        }
+        else if (line.starts_with("VideoQual:"))
+        {
+            video_quality_flag = parse_bool_setting(line);
+        }
+        else if (line.starts_with("Song:"))
+        {
+            parse_disabled_music_track(line);
+        }
+        else if (line.starts_with("Speach:"))
+        {
+            parse_disabled_speech(line);
+        }
+        else if (line.starts_with("Video:"))
+        {
+            parse_disabled_video(line);
+        }
+        else if (line.starts_with("Lastfile:"))
+        {
+            parse_autosave(line);
+        }
+        else if (line.starts_with("Endlosnr:"))
+        {
+            continuous_play_selection = parse_int_setting(line);
+        }
+        else if (line.starts_with("Tutornr:"))
+        {
+            tutorial_selection = parse_int_setting(line);
+        }
+        else if (line.starts_with("Kampagne:"))
+        {
+            parse_campaign_progress(line);
+        }
+        else if (line.starts_with("Objekt:"))
+        {
+            parse_save_slots(lines, i);
+        }
+        else
+        {
+            std::cerr << "Encountered unexpected setting: " << line << '\n';
+        }
+    }
+}
+
+bool LegacyGameDatFile::parse_bool_setting(const std::string& line) const
+{
+    const std::string value = extract_value(line);
+    return value == "TRUE";
+}
+
+int LegacyGameDatFile::parse_int_setting(const std::string& line, int default_value) const
+{
+    const std::string value = extract_value(line);
+
+    try
+    {
+        return std::stoi(value);
+    }
+    catch (const std::logic_error& err)
+    {
+        std::cerr << "Failed to parse int value: " << err.what() << '\n'  //
+                  << " in line: " << line << '\n';
+        return default_value;
+    }
+}
+
+void LegacyGameDatFile::parse_music_setting(const std::string& line)
+{
+    std::vector<std::string> parts;
+    if (!extract_multipart_value(line, parts, 2))
+    {
+        return;
+    }
+
+    is_music_enabled = (parts[0] == "TRUE");
+
+    try
+    {
+        music_bitmask = std::stoi(parts[1]);
+    }
+    catch (const std::logic_error& err)
+    {
+        std::cerr << "Failed to parse music setting: " << err.what() << '\n';
+    }
+}
+
+void LegacyGameDatFile::parse_volume_setting(const std::string& line)
+{
+    std::vector<std::string> parts;
+    if (!extract_multipart_value(line, parts, 3))
+    {
+        return;
+    }
+
+    try
+    {
+        music_volume = std::stoi(parts[0]);
+        sound_volume = std::stoi(parts[1]);
+        main_game_progress = std::stoi(parts[2]);
+    }
+    catch (const std::logic_error& err)
+    {
+        std::cerr << "Failed to parse music setting: " << err.what() << '\n';
+    }
+}
+
+void LegacyGameDatFile::parse_disabled_music_track(const std::string& line)
+{
+    std::vector<std::string> parts;
+    if (!extract_multipart_value(line, parts, 2))
+    {
+        return;
+    }
+
+    try
+    {
+        int track_index = std::stoi(parts[0]);
+        disabled_music_tracks.push_back(track_index);
+    }
+    catch (const std::logic_error& err)
+    {
+        std::cerr << "Failed to parse disabled music track: " << err.what() << '\n';
+    }
+}
+
+void LegacyGameDatFile::parse_disabled_speech(const std::string& line)
+{
+    std::vector<std::string> parts;
+    if (!extract_multipart_value(line, parts, 2))
+    {
+        return;
+    }
+
+    try
+    {
+        int index = std::stoi(parts[0]);
+        bool is_disabled = (parts[1] == "TRUE");
+        disabled_speech[index] = is_disabled;
+    }
+    catch (const std::logic_error& err)
+    {
+        std::cerr << "Failed to parse disabled music track: " << err.what() << '\n';
+    }
+}
+
+void LegacyGameDatFile::parse_disabled_video(const std::string& line)
+{
+    std::vector<std::string> parts;
+    if (!extract_multipart_value(line, parts, 2))
+    {
+        return;
+    }
+
+    try
+    {
+        int index = std::stoi(parts[0]);
+        bool is_disabled = (parts[1] == "TRUE");
+        disabled_videos[index] = is_disabled;
+    }
+    catch (const std::logic_error& err)
+    {
+        std::cerr << "Failed to parse disabled video: " << err.what() << '\n';
+    }
+}
+
+void LegacyGameDatFile::parse_autosave(const std::string& line)
+{
+    last_save_file = extract_value(line);
+    trim_quotes(last_save_file);
+}
+
+void LegacyGameDatFile::parse_campaign_progress(const std::string& line)
+{
+    std::vector<std::string> parts;
+    if (!extract_multipart_value(line, parts, 2))
+    {
+        return;
+    }
+
+    try
+    {
+        int index = std::stoi(parts[0]);
+        int progress = std::stoi(parts[1]);
+        campaign_progress[index] = progress;
+    }
+    catch (const std::logic_error& err)
+    {
+        std::cerr << "Failed to parse campaign progress: " << err.what() << '\n';
+    }
+}
+
+void LegacyGameDatFile::parse_save_slots(const std::vector<std::string>& lines, size_t& i)
+{
+    // Skip over the "Objekt" line
+    ++i;
+
+    for (; i < lines.size(); ++i)
+    {
+        const std::string line = boost::trim_copy(lines[i]);
+
+        if (line.empty())
+        {
+            continue;
+        }
+
+        if (line == "EndObj;")
+        {
+            break;
+        }
+
+        std::vector<std::string> parts;
+        if (!extract_multipart_value(line, parts, 3))
+        {
+            continue;
+        }
+
+        try
+        {
+            int index = std::stoi(parts[0]);
+            std::string name = parts[1];
+            trim_quotes(name);
+            int num_players = std::stoi(parts[2]);
+
+            save_slots[index] = { name, num_players };
+        }
+        catch (const std::logic_error& err)
+        {
+            std::cerr << "Failed to parse campaign progress: " << err.what() << '\n';
+        }
+    }
+}
+
+/* clang-format off */
+std::string LegacyGameDatFile::serialize() const
+{
+    std::stringstream ss;
+
+    ss << '\n'
+       << std::format("  Musik:     {}, {}\n", bool_as_str(is_music_enabled), music_bitmask)
+       << std::format("  Samples:   {}\n", bool_as_str(is_sound_enabled))
+       << std::format("  Random:    {}\n", bool_as_str(is_music_shuffle_enabled))
+       << std::format("  Volume:    {}, {}, {}\n", music_volume, sound_volume, main_game_progress)
+       << std::format("  VideoQual: {}\n\n", bool_as_str(video_quality_flag));
+
+    for (int track_id : disabled_music_tracks)
+    {
+        ss << std::format("  Song:     {}, FALSE\n", track_id);
+    }
+    ss << "  \n";
+
+    for (int i = 0; i < num_speech_categories; i++)
+    {
+        ss << std::format("  Speach:    {}, {}\n", i, bool_as_str(disabled_speech[i]));
+    }
+    ss << "  \n";
+
+    for (int i = 0; i < num_video_categories; i++)
+    {
+        ss << std::format("  Video:     {}, {}\n", i, bool_as_str(disabled_videos[i]));
+    }
+    ss << "  \n";
+
+    ss << std::format("  Lastfile: \"{}\"\n\n", last_save_file);
+
+    ss << std::format("  Endlosnr: {}\n", continuous_play_selection)
+       << std::format("  Tutornr:  {}\n\n", tutorial_selection);
+
+    for (const auto& [campaign_index, progress] : campaign_progress)
+    {
+        ss << std::format("  Kampagne: {}, {}\n", campaign_index, progress);
+    }
+    ss << "  \n";
+
+    if (game_version == GameVersion::Original)
+    {
+        ss << "  Objekt:   SPIELNAME\n\n";
+        for (int i = 0; i < num_savegames; i++)
+        {
+            const auto& save_slot = save_slots[i];
+            ss << std::format("    Name:{:>7}, \"{}\", {}\n", i, save_slot.name, save_slot.num_players);
+        }
+        ss << "  \n  EndObj;\n\n";
+    }
+
+    return ss.str();
+}
+/* clang-format on */
+
+}  // namespace
+
+void run_game_dat_benchmarks()
+{
+    const std::filesystem::path path = write_game_dat();
+    const size_t file_size = std::filesystem::file_size(path);
+    const std::filesystem::path out_path = get_scratch_dir() / "Game_out.dat";
+
+    // Every pair below runs the old and new code over the same file, with the same scope
+
+    print_result(measure("Legacy parse", file_size, [&]() {
+        LegacyGameDatFile game_dat(path, GameVersion::Original);
+        do_not_optimize(game_dat);
+    }));
+
+    print_result(measure("Parse", file_size, [&]() {
+        GameDatFile game_dat(path, GameVersion::Original);
+        do_not_optimize(game_dat);
+    }));
+
+    const LegacyGameDatFile legacy_game_dat(path, GameVersion::Original);
+    GameDatFile game_dat(path, GameVersion::Original);
+
+    print_result(measure("Legacy serialize", file_size, [&]() {
+        const std::string text = legacy_game_dat.serialize();
+        do_not_optimize(text[0]);
+    }));
+
+    print_result(measure("Serialize", file_size, [&]() {
+        const std::string text = game_dat.serialize();
+        do_not_optimize(text[0]);
+    }));
+
+    print_result(measure("Legacy save_to_path", file_size, [&]() { legacy_game_dat.save_to_path(out_path); }));
+
+    print_result(measure("save_to_path", file_size, [&]() { game_dat.save_to_path(out_path); }));
+
+    std::filesystem::remove(out_path);
+}
+
+}}  // namespace Anno::Bench
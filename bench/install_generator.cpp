@@ -0,0 +1,408 @@
+#include "install_generator.h"
+
+#include <algorithm>  // min
+#include <array>
+#include <cmath>
+#include <format>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "files/cod_codec.h"
+#include "files/file_utils.h"
+#include "files/text_cod_file.h"
+#include "util/buffer_utils.h"
+
+namespace Anno { namespace Bench {
+
+/*
+ * Helper methods
+ */
+
+// Real scenarios are made up of many chunks; larger payloads are split so that the chunk index has some work to do
+static constexpr size_t max_chunk_payload_size = 16 * 1024;
+
+static constexpr std::array<std::string_view, 4> filler_chunk_names = { "INSEL5", "INSELHAUS", "KONTOR2", "SHIP4" };
+
+namespace {
+
+/** Deterministic source of randomness.
+ * Standard distributions are avoided, since their output differs between standard library implementations. */
+class Random
+{
+public:
+    explicit Random(std::uint32_t seed)
+        : engine(seed)
+    {
+    }
+
+    /** Returns a value in the range [0, n). */
+    std::uint32_t next_below(std::uint32_t n)
+    {
+        return static_cast<std::uint32_t>((static_cast<std::uint64_t>(engine()) * n) >> 32);
+    }
+
+    /** Returns a value in the range [0, 1). */
+    double next_fraction()
+    {
+        return engine() / 4294967296.0;
+    }
+
+    bool chance(double probability)
+    {
+        return next_fraction() < probability;
+    }
+
+private:
+    std::mt19937 engine;
+};
+
+enum class Corruption : std::uint8_t
+{
+    Empty,
+    Truncated,
+    CampaignIndexOutOfRange,
+    Garbage
+};
+
+}  // namespace
+
+static void validate_options(const GeneratorOptions& options)
+{
+    if (options.num_scenarios < 0 || options.num_text_sections < 0 || options.lines_per_text_section < 0
+            || options.num_uninstalled_campaigns < 0)
+    {
+        throw std::invalid_argument("Counts must not be negative");
+    }
+    if (options.levels_per_campaign < 1 || options.levels_per_campaign > Campaign::max_levels)
+    {
+        throw std::invalid_argument(std::format("Levels per campaign must be between 1 and {}", Campaign::max_levels));
+    }
+    if (options.num_uninstalled_campaigns * options.levels_per_campaign > options.num_scenarios)
+    {
+        throw std::invalid_argument("Not enough scenarios for the uninstalled campaigns");
+    }
+    if (options.num_uninstalled_campaigns > max_campaign_index + 1)
+    {
+        throw std::invalid_argument("Too many uninstalled campaigns");
+    }
+    if (options.min_scenario_size < 1 || options.min_scenario_size > options.max_scenario_size)
+    {
+        throw std::invalid_argument("Invalid scenario size range");
+    }
+    for (double fraction : { options.szm_fraction,
+                 options.linked_fraction,
+                 options.corruption_rate,
+                 options.campaign_gap_rate,
+                 options.duplicate_campaign_rate })
+    {
+        if (!(fraction >= 0.0 && fraction <= 1.0))
+        {
+            throw std::invalid_argument("Fractions and rates must be between 0 and 1");
+        }
+    }
+    if (options.campaign_gap_rate >= 1.0)
+    {
+        throw std::invalid_argument("Gap rate must be less than 1");
+    }
+}
+
+static size_t choose_scenario_size(const GeneratorOptions& options, Random& random)
+{
+    const size_t range = options.max_scenario_size - options.min_scenario_size;
+    if (range == 0)
+    {
+        return options.min_scenario_size;
+    }
+
+    if (options.size_distribution == SizeDistribution::LogUniform)
+    {
+        const double log_min = std::log(static_cast<double>(options.min_scenario_size));
+        const double log_max = std::log(static_cast<double>(options.max_scenario_size));
+        const double size = std::exp(log_min + random.next_fraction() * (log_max - log_min));
+        return std::min(static_cast<size_t>(size), options.max_scenario_size);
+    }
+
+    return options.min_scenario_size + static_cast<size_t>(random.next_fraction() * (range + 1));
+}
+
+static void append_chunk_header(std::vector<char>& data, std::string_view name, std::int32_t length)
+{
+    std::array<char, 16> padded_name {};
+    std::copy(name.begin(), name.end(), padded_name.begin());
+    data.insert(data.end(), padded_name.begin(), padded_name.end());
+    BufferUtils::append(data, length);
+}
+
+static std::vector<char> make_scenario_data(int campaign_index, size_t payload_size, std::uint32_t seed)
+{
+    std::vector<char> data;
+    data.reserve(64 + payload_size + payload_size / max_chunk_payload_size * 20);
+
+    if (campaign_index >= 0)
+    {
+        append_chunk_header(data, "SZENE_KAMPAGNE", 4);
+        BufferUtils::append(data, static_cast<std::int32_t>(campaign_index));
+    }
+
+    size_t num_written = 0;
+    for (size_t chunk = 0; num_written < payload_size; ++chunk)
+    {
+        const size_t chunk_size = std::min(payload_size - num_written, max_chunk_payload_size);
+        append_chunk_header(data,
+                filler_chunk_names[chunk % filler_chunk_names.size()],
+                static_cast<std::int32_t>(chunk_size));
+        for (size_t i = 0; i < chunk_size; ++i)
+        {
+            data.push_back(static_cast<char>(((num_written + i) * 31 + seed) & 0xff));
+        }
+        num_written += chunk_size;
+    }
+
+    return data;
+}
+
+static std::vector<char> make_corrupted_scenario_data(
+        int campaign_index, size_t payload_size, std::uint32_t seed, Random& random)
+{
+    switch (static_cast<Corruption>(random.next_below(4)))
+    {
+    case Corruption::Empty:
+        return {};
+    case Corruption::Truncated:
+    {
+        // Chunk headers now claim more data than the file contains
+        std::vector<char> data = make_scenario_data(campaign_index, payload_size, seed);
+        data.resize(data.size() / 2);
+        return data;
+    }
+    case Corruption::CampaignIndexOutOfRange:
+    {
+        const int invalid_campaign_index = max_campaign_index + 1 + static_cast<int>(random.next_below(1000));
+        return make_scenario_data(invalid_campaign_index, payload_size, seed);
+    }
+    case Corruption::Garbage:
+    default:
+    {
+        std::vector<char> data(payload_size);
+        for (char& c : data)
+        {
+            c = static_cast<char>(random.next_below(256));
+        }
+        return data;
+    }
+    }
+}
+
+static void write_text_cod(const std::filesystem::path& path,
+        const GeneratorOptions& options,
+        const std::map<int, std::vector<std::string>>& campaign_levels)
+{
+    std::string text = "--------------------------------------------------\r\n";
+    for (int i = 0; i < options.num_text_sections; ++i)
+    {
+        text += std::format("[SECTION{}]\r\n", i);
+        for (int j = 0; j < options.lines_per_text_section; ++j)
+        {
+            text += std::format("Line {} of section {}\r\n", j, i);
+        }
+        text += "[END]\r\n--------------------------------------------------\r\n";
+    }
+
+    // Each campaign's level names are followed by a blank line. Gaps still need level names, otherwise every
+    // subsequent campaign would be shifted down.
+    text += std::format("[{}]\r\n", TextCodFile::section_campaign);
+    const int num_entries = campaign_levels.empty() ? 0 : campaign_levels.rbegin()->first + 1;
+    for (int i = 0; i < num_entries; ++i)
+    {
+        const auto it = campaign_levels.find(i);
+        if (it == campaign_levels.cend())
+        {
+            text += "(Unused)\r\n";
+        }
+        else
+        {
+            for (const auto& level_name : it->second)
+            {
+                text += level_name + "\r\n";
+            }
+        }
+        text += "\r\n";
+    }
+    text += "[END]\r\n--------------------------------------------------\r\n";
+
+    std::vector<char> data(text.begin(), text.end());
+    CodCodec::transform_in_place(data);
+    FileUtils::write_binary_file(path, data);
+}
+
+static void write_game_dat(const std::filesystem::path& path,
+        const GeneratorOptions& options,
+        const std::map<int, std::vector<std::string>>& campaign_levels,
+        Random& random)
+{
+    std::string text = "\n  Musik:     TRUE, 0\n  Samples:   TRUE\n  Random:    TRUE\n  Volume:    80, 80, -595\n"
+                       "  VideoQual: TRUE\n\n  \n";
+    for (int i = 0; i < 8; ++i)
+    {
+        text += std::format("  Speach:    {}, FALSE\n", i);
+    }
+    text += "  \n";
+    for (int i = 0; i < 8; ++i)
+    {
+        text += std::format("  Video:     {}, FALSE\n", i);
+    }
+    text += "  \n  Lastfile: \"\"\n\n  Endlosnr: 0\n  Tutornr:  0\n\n";
+    for (const auto& [campaign_index, level_names] : campaign_levels)
+    {
+        const std::uint32_t progress = random.next_below(static_cast<std::uint32_t>(level_names.size()) + 1);
+        text += std::format("  Kampagne: {}, {}\n", campaign_index, progress);
+    }
+    text += "  \n";
+
+    // Save game names (not present in the History Edition)
+    if (options.game_version == GameVersion::Original)
+    {
+        text += "  Objekt:   SPIELNAME\n\n";
+        for (int i = 0; i < 12; ++i)
+        {
+            text += std::format("    Name:{:>7}, \"Savegame {}\", 1\n", i, i);
+        }
+        text += "  \n  EndObj;\n\n";
+    }
+
+    FileUtils::write_text_file(path, text);
+}
+
+/*
+ * Generation
+ */
+
+Config GeneratedInstall::make_config() const
+{
+    Config cfg;
+    cfg.anno_dir = anno_dir;
+    cfg.user_dir = user_dir;
+    cfg.version = game_version;
+    return cfg;
+}
+
+GeneratedInstall generate_install(const std::filesystem::path& anno_dir, const GeneratorOptions& options)
+{
+    validate_options(options);
+
+    GeneratedInstall install;
+    install.anno_dir = anno_dir;
+    install.user_dir = options.user_dir.empty() ? anno_dir : options.user_dir;
+    install.game_version = options.game_version;
+    install.num_scenarios = options.num_scenarios;
+
+    // Only ever replace a directory that we generated ourselves, unless told otherwise
+    std::error_code ec;
+    const bool is_empty = !std::filesystem::exists(anno_dir) || std::filesystem::is_empty(anno_dir, ec);
+    if (!is_empty && !options.force && !std::filesystem::exists(anno_dir / generator_marker_filename))
+    {
+        throw std::invalid_argument("Refusing to replace a directory that was not generated: " + anno_dir.string());
+    }
+
+    std::filesystem::remove_all(anno_dir);
+    std::filesystem::create_directories(anno_dir / "Szenes");
+    FileUtils::write_binary_file(anno_dir / generator_marker_filename, std::vector<char>());
+    std::filesystem::create_directories(install.user_dir);
+
+    const bool is_history_edition = options.game_version == GameVersion::HistoryEdition;
+    FileUtils::write_binary_file(anno_dir / (is_history_edition ? "Anno1602.exe" : "1602.exe"), std::vector<char>());
+
+    Random random(options.seed);
+    int scenario_index = 0;
+
+    auto write_scenario = [&](const std::string& name, int campaign_index, bool allow_corruption) {
+        const std::string extension = random.chance(options.szm_fraction) ? ".szm" : ".szs";
+        const size_t payload_size = choose_scenario_size(options, random);
+        const std::uint32_t seed = static_cast<std::uint32_t>(scenario_index++);
+
+        std::vector<char> data;
+        if (allow_corruption && random.chance(options.corruption_rate))
+        {
+            data = make_corrupted_scenario_data(campaign_index, payload_size, seed, random);
+            ++install.num_corrupted_scenarios;
+        }
+        else
+        {
+            data = make_scenario_data(campaign_index, payload_size, seed);
+        }
+
+        FileUtils::write_binary_file(anno_dir / "Szenes" / (name + extension), data);
+    };
+
+    // Installed campaigns, leaving room to install the uninstalled ones afterwards
+    const int num_uninstalled_scenarios = options.num_uninstalled_campaigns * options.levels_per_campaign;
+    int num_linked_remaining =
+            static_cast<int>(options.linked_fraction * (options.num_scenarios - num_uninstalled_scenarios));
+    const int highest_allowed_index = max_campaign_index - options.num_uninstalled_campaigns;
+    std::map<int, std::vector<std::string>> campaign_levels;
+    int last_campaign_index = -1;
+    for (int campaign_number = 0; num_linked_remaining > 0; ++campaign_number)
+    {
+        int campaign_index;
+        if (last_campaign_index >= 0 && random.chance(options.duplicate_campaign_rate))
+        {
+            campaign_index = last_campaign_index;
+        }
+        else
+        {
+            campaign_index = last_campaign_index + 1;
+            while (random.chance(options.campaign_gap_rate))
+            {
+                ++campaign_index;
+            }
+        }
+        if (campaign_index > highest_allowed_index)
+        {
+            break;
+        }
+
+        const int num_levels = std::min(options.levels_per_campaign, num_linked_remaining);
+        std::vector<std::string> level_names;
+        for (int j = 0; j < num_levels; ++j)
+        {
+            write_scenario(std::format("Campaign{}_{}", campaign_number, j), campaign_index, true);
+            level_names.push_back(std::format("Level {} of campaign {}", j, campaign_number));
+        }
+
+        // For duplicates, the level names of whichever campaign came first are kept
+        campaign_levels.emplace(campaign_index, std::move(level_names));
+        last_campaign_index = campaign_index;
+        num_linked_remaining -= num_levels;
+    }
+    install.num_campaigns = static_cast<int>(campaign_levels.size());
+    install.max_campaign_index_used = last_campaign_index;
+
+    // Campaigns ready to be installed (these are never corrupted, so that installation can succeed)
+    for (int i = 0; i < options.num_uninstalled_campaigns; ++i)
+    {
+        Campaign& campaign = install.uninstalled_campaigns.emplace_back();
+        campaign.name = std::format("Uninstalled{}_", i);
+        for (int j = 0; j < options.levels_per_campaign; ++j)
+        {
+            write_scenario(campaign.name + std::to_string(j), -1, false);
+            campaign.level_names.push_back(std::format("Level {} of uninstalled campaign {}", j, i));
+        }
+    }
+
+    // Standalone scenarios
+    while (scenario_index < options.num_scenarios)
+    {
+        write_scenario(std::format("Scenario{}", scenario_index), -1, true);
+    }
+
+    write_text_cod(anno_dir / "text.cod", options, campaign_levels);
+    write_game_dat(install.user_dir / "Game.dat", options, campaign_levels, random);
+
+    return install;
+}
+
+}}  // namespace Anno::Bench
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "tool/config.h"
+#include "tool/tool.h"
+
+namespace Anno { namespace Bench {
+
+/** How scenario sizes are spread between the minimum and maximum. */
+enum class SizeDistribution : std::uint8_t
+{
+    /** Every size is equally likely. */
+    Uniform,
+
+    /** Small scenarios are much more common than large ones, as in a typical collection. */
+    LogUniform
+};
+
+/** Describes a fake installation to generate.
+ * Generation is deterministic: the same options always produce the same files. */
+struct GeneratorOptions
+{
+    GameVersion game_version = GameVersion::Original;
+
+    /** Directory that receives `Game.dat`; defaults to the installation directory if empty. */
+    std::filesystem::path user_dir;
+
+    /** Filler sections in `text.cod`, in addition to the campaign section. */
+    int num_text_sections = 20;
+    int lines_per_text_section = 100;
+
+    int num_scenarios = 0;
+
+    /** Fraction of scenarios saved as `.szm` rather than `.szs`. */
+    double szm_fraction = 0.0;
+
+    /** Fraction of scenarios that belong to an installed campaign (and so have a `SZENE_KAMPAGNE` chunk). */
+    double linked_fraction = 0.5;
+
+    int levels_per_campaign = 4;
+
+    /** Campaigns whose scenarios are present, but which have not been installed. */
+    int num_uninstalled_campaigns = 1;
+
+    /** Range of scenario sizes, in bytes (excluding the campaign chunk). */
+    size_t min_scenario_size = 1024;
+    size_t max_scenario_size = 1024;
+    SizeDistribution size_distribution = SizeDistribution::Uniform;
+
+    /** Fraction of scenarios that are malformed in some way. */
+    double corruption_rate = 0.0;
+
+    /** Chance of skipping a campaign index when assigning the next one. */
+    double campaign_gap_rate = 0.0;
+
+    /** Chance of reusing the previous campaign index when assigning the next one. */
+    double duplicate_campaign_rate = 0.0;
+
+    std::uint32_t seed = 1;
+
+    /** Replace the installation directory even if it was not created by the generator. */
+    bool force = false;
+};
+
+/** Summary of a generated installation. */
+struct GeneratedInstall
+{
+    std::filesystem::path anno_dir;
+    std::filesystem::path user_dir;
+    GameVersion game_version = GameVersion::Original;
+
+    int num_scenarios = 0;
+
+    /** Number of distinct campaign indices in use. */
+    int num_campaigns = 0;
+
+    /** Highest campaign index in use, or -1 if there are no campaigns. */
+    int max_campaign_index_used = -1;
+
+    int num_corrupted_scenarios = 0;
+
+    /** Campaigns that can be passed to `Tool::install_campaigns`. */
+    std::vector<Campaign> uninstalled_campaigns;
+
+    /** Creates a Config for the generated installation. */
+    Config make_config() const;
+};
+
+/** Name of the (empty) file that marks a directory as one we generated, and so safe to replace. */
+inline constexpr const char* generator_marker_filename = ".anno-install-generator";
+
+/** Writes a fake installation to the given directory, replacing any installation generated there before.
+ * May throw a std::ios_base::failure, or a std::invalid_argument if the options are inconsistent or the directory
+ * already holds something else (and `force` is not set). */
+GeneratedInstall generate_install(const std::filesystem::path& anno_dir, const GeneratorOptions& options);
+
+}}  // namespace Anno::Bench
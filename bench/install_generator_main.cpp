@@ -0,0 +1,127 @@
+#include <boost/program_options.hpp>
+
+#include <algorithm>  // max, min
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "install_generator.h"
+
+namespace po = boost::program_options;
+
+using namespace Anno;
+
+int main(int argc, char* argv[])
+{
+    Bench::GeneratorOptions options;
+    std::string out_dir;
+    std::string user_dir;
+    std::string game_version = "original";
+    std::string size_distribution = "uniform";
+
+    po::options_description all_options("Allowed options");
+    all_options.add_options()                                                                                     //
+            ("help", "produce help message")                                                                      //
+            ("out-dir", po::value(&out_dir), "directory to generate the installation in (see --force)")           //
+            ("user-dir", po::value(&user_dir), "directory to write Game.dat to (default: out-dir)")               //
+            ("game-version", po::value(&game_version), "original or history-edition (default: original)")         //
+            ("text-sections", po::value(&options.num_text_sections), "filler sections in text.cod")               //
+            ("text-lines", po::value(&options.lines_per_text_section), "lines per filler section in text.cod")    //
+            ("scenarios", po::value(&options.num_scenarios), "number of scenario files")                          //
+            ("szm-fraction", po::value(&options.szm_fraction), "fraction of scenarios saved as .szm")             //
+            ("linked-fraction", po::value(&options.linked_fraction), "fraction of scenarios in a campaign")       //
+            ("levels", po::value(&options.levels_per_campaign), "levels per campaign")                            //
+            ("uninstalled", po::value(&options.num_uninstalled_campaigns), "campaigns left ready to install")     //
+            ("min-size", po::value(&options.min_scenario_size), "minimum scenario size in bytes")                 //
+            ("max-size", po::value(&options.max_scenario_size), "maximum scenario size in bytes")                 //
+            ("size-distribution", po::value(&size_distribution), "uniform or log (default: uniform)")             //
+            ("corruption-rate", po::value(&options.corruption_rate), "fraction of scenarios that are malformed")  //
+            ("gap-rate", po::value(&options.campaign_gap_rate), "chance of skipping a campaign index")            //
+            ("duplicate-rate", po::value(&options.duplicate_campaign_rate), "chance of reusing an index")         //
+            ("seed", po::value(&options.seed), "random seed (default: 1)")                                        //
+            ("force", po::bool_switch(&options.force), "replace out-dir even if it was not generated")            //
+            ;
+
+    po::variables_map vm;
+    try
+    {
+        po::store(po::parse_command_line(argc, argv, all_options), vm);
+        po::notify(vm);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error parsing command line: " << e.what() << "\n\n" << all_options << '\n';
+        return 1;
+    }
+
+    if (vm.count("help"))
+    {
+        std::cout << all_options << '\n';
+        return 1;
+    }
+
+    if (out_dir.empty())
+    {
+        std::cerr << "Missing required argument: out-dir\n";
+        return 1;
+    }
+
+    if (game_version == "original")
+    {
+        options.game_version = GameVersion::Original;
+    }
+    else if (game_version == "history-edition")
+    {
+        options.game_version = GameVersion::HistoryEdition;
+    }
+    else
+    {
+        std::cerr << "Invalid game version: " << game_version << '\n';
+        return 1;
+    }
+
+    if (size_distribution == "uniform")
+    {
+        options.size_distribution = Bench::SizeDistribution::Uniform;
+    }
+    else if (size_distribution == "log")
+    {
+        options.size_distribution = Bench::SizeDistribution::LogUniform;
+    }
+    else
+    {
+        std::cerr << "Invalid size distribution: " << size_distribution << '\n';
+        return 1;
+    }
+
+    // Keep sizes consistent if only one end of the range was given
+    if (vm.count("min-size") && !vm.count("max-size"))
+    {
+        options.max_scenario_size = std::max(options.max_scenario_size, options.min_scenario_size);
+    }
+    if (vm.count("max-size") && !vm.count("min-size"))
+    {
+        options.min_scenario_size = std::min(options.min_scenario_size, options.max_scenario_size);
+    }
+
+    options.user_dir = user_dir;
+
+    try
+    {
+        const Bench::GeneratedInstall install = Bench::generate_install(out_dir, options);
+        std::cout << "Generated installation in " << install.anno_dir.string() << '\n';
+        std::cout << "  Scenarios: " << install.num_scenarios << " (" << install.num_corrupted_scenarios
+                  << " corrupted)\n";
+        std::cout << "  Installed campaigns: " << install.num_campaigns
+                  << " (highest index: " << install.max_campaign_index_used << ")\n";
+        std::cout << "  Campaigns ready to install: " << install.uninstalled_campaigns.size() << '\n';
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Failed to generate installation: " << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
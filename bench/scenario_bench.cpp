@@ -0,0 +1,60 @@
+#include <filesystem>
+#include <format>
+#include <vector>
+
+#include "bench_utils.h"
+#include "benchmarks.h"
+#include "files/scenario_file.h"
+
+namespace Anno { namespace Bench {
+
+static std::vector<std::filesystem::path> list_scenarios(const GeneratedInstall& install)
+{
+    std::vector<std::filesystem::path> paths;
+    paths.reserve(install.num_scenarios);
+    for (const auto& entry : std::filesystem::directory_iterator(install.anno_dir / "Szenes"))
+    {
+        paths.push_back(entry.path());
+    }
+    return paths;
+}
+
+void run_scenario_benchmarks(const GeneratedInstall& install)
+{
+    const std::vector<std::filesystem::path> paths = list_scenarios(install);
+
+    size_t total_size = 0;
+    for (const auto& path : paths)
+    {
+        total_size += std::filesystem::file_size(path);
+    }
+
+    print_result(measure(std::format("Probe ({} scenarios)", paths.size()), 0, [&]() {
+        for (const auto& path : paths)
+        {
+            ScenarioFile scenario(path);
+            do_not_optimize(scenario);
+        }
+    }));
+
+    print_result(measure(std::format("Probe + get_chunk_index ({} scenarios)", paths.size()), total_size, [&]() {
+        for (const auto& path : paths)
+        {
+            ScenarioFile scenario(path);
+            const auto& chunks = scenario.get_chunk_index().get_chunks();
+            do_not_optimize(chunks);
+        }
+    }));
+
+    // Only the campaign index itself should be written, since the campaign chunk is already present
+    const std::filesystem::path linked_path = install.anno_dir / "Szenes" / "Campaign0_0.szs";
+    ScenarioFile scenario(linked_path);
+    print_result(measure("save_overwrite (campaign index only)", 0, [&]() {
+        scenario.set_campaign_index(scenario.get_campaign_index() == 0 ? 1 : 0);
+        scenario.save_overwrite();
+    }));
+    scenario.set_campaign_index(0);
+    scenario.save_overwrite();
+}
+
+}}  // namespace Anno::Bench
@@ -0,0 +1,143 @@
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench_utils.h"
+#include "benchmarks.h"
+#include "files/cod_codec.h"
+#include "files/file_utils.h"
+#include "files/text_cod_file.h"
+
+namespace Anno { namespace Bench {
+
+// Roughly the shape of the game's `text.cod`
+static constexpr int num_sections = 60;
+static constexpr int lines_per_section = 400;
+
+static std::string get_section_name(int section_index)
+{
+    return section_index == 0 ? std::string(TextCodFile::section_campaign) : "SECTION" + std::to_string(section_index);
+}
+
+static std::filesystem::path write_text_cod()
+{
+    std::string text = "--------------------------------------------------\r\n";
+    for (int i = 0; i < num_sections; ++i)
+    {
+        text += "[" + get_section_name(i) + "]\r\n";
+        for (int j = 0; j < lines_per_section; ++j)
+        {
+            text += "Line " + std::to_string(j) + " of section " + std::to_string(i) + "\r\n";
+        }
+        text += "[END]\r\n--------------------------------------------------\r\n";
+    }
+
+    std::vector<char> data(text.begin(), text.end());
+    CodCodec::transform_in_place(data);
+
+    const std::filesystem::path path = get_scratch_dir() / "text.cod";
+    FileUtils::write_binary_file(path, data);
+    return path;
+}
+
+/*
+ * The original implementation, kept here as a baseline: every section's lines were held as strings, and saving
+ * streamed all of them into an ostringstream before encoding the result one byte at a time.
+ */
+
+struct LegacySection
+{
+    std::string name;
+    std::vector<std::string> lines;
+};
+
+static void transform_chars_legacy(std::vector<char>& buffer)
+{
+    for (size_t i = 0; i < buffer.size(); ++i)
+    {
+        buffer[i] = -buffer[i] & 0xff;
+    }
+}
+
+static std::vector<char> make_buffer_legacy(const std::vector<LegacySection>& sections, bool should_encode_chars)
+{
+    std::ostringstream oss;
+
+    oss << "--------------------------------------------------\r\n";
+
+    for (const auto& section : sections)
+    {
+        oss << "[" << section.name << "]\r\n";
+
+        for (const auto& line : section.lines)
+        {
+            oss << line << "\r\n";
+        }
+
+        oss << "[END]\r\n"
+               "--------------------------------------------------\r\n";
+    }
+
+    std::string temp = oss.str();
+    std::vector<char> data(temp.begin(), temp.end());
+
+    if (should_encode_chars)
+    {
+        transform_chars_legacy(data);
+    }
+
+    return data;
+}
+
+void run_text_cod_benchmarks()
+{
+    const std::filesystem::path path = write_text_cod();
+    const size_t file_size = std::filesystem::file_size(path);
+
+    print_result(measure("Load (full)", file_size, [&]() {
+        TextCodFile text_cod(path, TextCodFile::LoadMode::Full);
+        do_not_optimize(text_cod);
+    }));
+
+    print_result(measure("Load (lazy) + read 1 section", file_size, [&]() {
+        TextCodFile text_cod(path, TextCodFile::LoadMode::Lazy);
+        const auto lines = text_cod.get_section_lines(TextCodFile::section_campaign);
+        do_not_optimize(lines);
+    }));
+
+    TextCodFile text_cod(path);
+    const std::filesystem::path out_path = get_scratch_dir() / "text_out.cod";
+
+    // The legacy class held every section in memory already, so this is done up front
+    std::vector<LegacySection> legacy_sections;
+    for (int i = 0; i < num_sections; ++i)
+    {
+        const std::string section_name = get_section_name(i);
+        legacy_sections.push_back({ section_name, text_cod.get_section_contents(section_name) });
+    }
+    print_result(measure("Legacy save_encoded", file_size, [&]() {
+        const std::vector<char> data = make_buffer_legacy(legacy_sections, true);
+        FileUtils::write_binary_file(out_path, data);
+    }));
+
+    print_result(measure("save_encoded (no changes)", file_size, [&]() { text_cod.save_encoded(out_path); }));
+
+    // Typical campaign installation
+    auto campaign_lines = text_cod.get_section_contents(TextCodFile::section_campaign);
+    campaign_lines.push_back("New level");
+    text_cod.set_section_contents(TextCodFile::section_campaign, campaign_lines);
+    print_result(measure("save_encoded (1 section modified)", file_size, [&]() { text_cod.save_encoded(out_path); }));
+
+    for (int i = 1; i < num_sections; ++i)
+    {
+        const std::string section_name = get_section_name(i);
+        text_cod.set_section_contents(section_name, text_cod.get_section_contents(section_name));
+    }
+    print_result(measure("save_encoded (all sections modified)", file_size, [&]() {
+        text_cod.save_encoded(out_path);
+    }));
+
+    std::filesystem::remove(out_path);
+}
+
+}}  // namespace Anno::Bench
@@ -0,0 +1,128 @@
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>  // move
+#include <vector>
+
+#include "bench_utils.h"
+#include "benchmarks.h"
+#include "tool/tool.h"
+
+namespace Anno { namespace Bench {
+
+/*
+ * Helper methods
+ */
+
+// Finds the files that installing the given campaign may change, wherever the Config says they live
+static std::vector<std::filesystem::path> get_files_modified_by_install(const Config& cfg, const Campaign& campaign)
+{
+    std::vector<std::filesystem::path> paths { cfg.anno_dir / "text.cod", cfg.user_dir / "Game.dat" };
+    for (size_t i = 0; i < campaign.level_names.size(); ++i)
+    {
+        // Scenarios may have either extension
+        for (const char* extension : { ".szs", ".szm" })
+        {
+            const std::filesystem::path path =
+                    cfg.anno_dir / "Szenes" / std::format("{}{}{}", campaign.name, i, extension);
+            if (std::filesystem::exists(path))
+            {
+                paths.push_back(path);
+            }
+        }
+    }
+    return paths;
+}
+
+// Gets a place to back up each of the given files (which may come from different directories)
+static std::vector<std::filesystem::path> get_backup_paths(const std::vector<std::filesystem::path>& paths,
+        const std::filesystem::path& backup_dir)
+{
+    std::vector<std::filesystem::path> backup_paths;
+    backup_paths.reserve(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        backup_paths.push_back(backup_dir / std::to_string(i));
+    }
+    return backup_paths;
+}
+
+static void copy_files(const std::vector<std::filesystem::path>& src_paths,
+        const std::vector<std::filesystem::path>& dst_paths)
+{
+    for (size_t i = 0; i < src_paths.size(); ++i)
+    {
+        std::filesystem::copy_file(src_paths[i], dst_paths[i], std::filesystem::copy_options::overwrite_existing);
+    }
+}
+
+/*
+ * Benchmarks
+ */
+
+void run_tool_benchmarks(const GeneratedInstall& install)
+{
+    const Config cfg = install.make_config();
+    const std::filesystem::path snapshot_path = install.user_dir / "AnnoTool.snapshot";
+    const std::string scale = std::format("{} scenarios", install.num_scenarios);
+
+    // The Tool reports what it finds, which would drown out the results, so these are only printed at the end
+    std::vector<Result> results;
+    std::optional<ScopedSilence> silence;
+    silence.emplace(std::cout);
+
+    results.push_back(measure_with_setup(
+            std::format("Construct (no snapshot, {})", scale),
+            0,
+            [&]() { std::filesystem::remove(snapshot_path); },
+            [&]() {
+                Tool tool(cfg);
+                do_not_optimize(tool);
+            }));
+
+    results.push_back(measure(std::format("Construct (snapshot, {})", scale), 0, [&]() {
+        Tool tool(cfg);
+        do_not_optimize(tool);
+    }));
+
+    // Every iteration installs the same campaign into a fresh copy of the affected files
+    const Campaign& campaign = install.uninstalled_campaigns.front();
+    const std::vector<std::filesystem::path> modified_paths = get_files_modified_by_install(cfg, campaign);
+    const std::filesystem::path backup_dir = install.anno_dir.string() + "_backup";
+    const std::vector<std::filesystem::path> backup_paths = get_backup_paths(modified_paths, backup_dir);
+    std::filesystem::create_directories(backup_dir);
+    copy_files(modified_paths, backup_paths);
+
+    std::optional<Tool> tool;
+    results.push_back(measure_with_setup(
+            std::format("install_campaign ({})", scale),
+            0,
+            [&]() {
+                tool.reset();
+                copy_files(backup_paths, modified_paths);
+                tool.emplace(cfg);
+            },
+            [&]() {
+                // Timing a failed install would be meaningless
+                if (!tool->install_campaign(campaign))
+                {
+                    throw std::runtime_error("Failed to install campaign: " + campaign.name);
+                }
+            }));
+
+    // Leave the fixture as we found it
+    tool.reset();
+    copy_files(backup_paths, modified_paths);
+    std::filesystem::remove_all(backup_dir);
+
+    silence.reset();
+    for (auto& result : results)
+    {
+        print_result(std::move(result));
+    }
+}
+
+}}  // namespace Anno::Bench
@@ -0,0 +1,79 @@
+#pragma once
+
+/*
+ * C interface to the Anno Tool, for use from other languages (e.g. via cgo or ctypes).
+ *
+ * A handle wraps a single Tool, which is parsed once when the handle is opened and then kept up to date by every
+ * change made through it. Before each call, any files changed by other programs since the last call are re-read.
+ * Handles may be shared between threads: queries run concurrently, and changes run one at a
+ * time.
+ *
+ * All strings are UTF-8; campaign and level names are converted to and from the game's own encoding (Windows-1252),
+ * so names that can't be represented there can't be installed. Functions that can fail return an AnnoStatus; on
+ * failure, `anno_last_error` describes what went wrong. Nothing is ever written to stdout or stderr.
+ */
+
+#include <stddef.h>
+
+#if defined(_WIN32) && defined(ANNO_CORE_SHARED)
+#ifdef ANNO_CORE_EXPORTS
+#define ANNO_CORE_API __declspec(dllexport)
+#else
+#define ANNO_CORE_API __declspec(dllimport)
+#endif
+#elif defined(ANNO_CORE_EXPORTS)
+#define ANNO_CORE_API __attribute__((visibility("default")))
+#else
+#define ANNO_CORE_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct AnnoHandle AnnoHandle;
+
+typedef enum AnnoStatus
+{
+    ANNO_OK = 0,
+
+    /** An argument was invalid (e.g. a null pointer or an out-of-range campaign index). */
+    ANNO_INVALID_ARGUMENT = 1,
+
+    /** The installation could not be found, read or modified. */
+    ANNO_ERROR = 2
+} AnnoStatus;
+
+/** Opens the installation in `anno_dir`.
+ * `user_dir` is the directory containing `Game.dat`; if null, this is determined from the game version.
+ * On success, `*handle_out` receives a handle that must be released with `anno_close`. */
+ANNO_CORE_API AnnoStatus anno_open(const char* anno_dir, const char* user_dir, AnnoHandle** handle_out);
+
+/** Releases a handle. Passing null is allowed. */
+ANNO_CORE_API void anno_close(AnnoHandle* handle);
+
+/** Describes the last error that occurred on the calling thread.
+ * The string remains valid until the next failing call on the same thread. */
+ANNO_CORE_API const char* anno_last_error(void);
+
+/** Gets the installed campaigns as a JSON array of `{"index", "name", "levels", "progress"}` objects.
+ * Unused campaign indices are skipped, so `index` need not match the position in the array.
+ * On success, `*json_out` receives a string that must be released with `anno_free`. */
+ANNO_CORE_API AnnoStatus anno_list_campaigns(AnnoHandle* handle, char** json_out);
+
+/** Installs a campaign, whose scenarios must already be present in the `Szenes` directory. */
+ANNO_CORE_API AnnoStatus anno_install_campaign(
+        AnnoHandle* handle, const char* name, const char* const* level_names, size_t num_levels);
+
+/** Gets the player's progress in a campaign, or in the main game if `campaign_index` is negative. */
+ANNO_CORE_API AnnoStatus anno_get_progress(AnnoHandle* handle, int campaign_index, int* progress_out);
+
+/** Sets and saves the player's progress in a campaign, or in the main game if `campaign_index` is negative. */
+ANNO_CORE_API AnnoStatus anno_set_progress(AnnoHandle* handle, int campaign_index, int progress);
+
+/** Releases a string returned by this library. Passing null is allowed. */
+ANNO_CORE_API void anno_free(char* str);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace Anno {
+
+/**
+ * Flat index over the chunks of a scenario (.szs / .szm) or savegame (.gam) file.
+ *
+ * Each chunk consists of a 16-byte null-padded name, a 4-byte little-endian payload length, and then the payload.
+ * The index is built in a single pass and refers directly into the indexed bytes, so these must outlive it.
+ *
+ * More info:
+ * https://github.com/Green-Sky/anno16_docs/blob/master/file_formats/chunks.md
+ */
+class ChunkIndex
+{
+public:
+    struct Chunk
+    {
+        /** Chunk name, with any null padding removed. */
+        std::string_view name;
+
+        /** Offset of the chunk payload from the start of the file. */
+        size_t offset = 0;
+
+        /** Size of the chunk payload, in bytes. */
+        size_t length = 0;
+    };
+
+    static constexpr size_t chunk_name_size = 16;
+    static constexpr size_t chunk_header_size = 20;
+
+    /** Creates a ChunkIndex by walking the given bytes.
+     * Throws a std::runtime_error if a chunk extends beyond the end of the data. */
+    explicit ChunkIndex(std::span<const char> data);
+
+    const std::vector<Chunk>& get_chunks() const
+    {
+        return chunks;
+    }
+
+    /** Finds the first chunk with the given name, or returns nullptr if there is none. */
+    const Chunk* find_chunk(std::string_view name) const;
+
+    /** Finds all chunks with the given name, in file order. */
+    std::vector<const Chunk*> find_all_chunks(std::string_view name) const;
+
+    /** Gets a view of a chunk's payload. */
+    std::span<const char> get_payload(const Chunk& chunk) const
+    {
+        return data.subspan(chunk.offset, chunk.length);
+    }
+
+private:
+    std::span<const char> data;
+    std::vector<Chunk> chunks;
+};
+
+}  // namespace Anno
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace Anno { namespace CodCodec {
+
+/*
+ * Encoding / decoding of `.cod` files.
+ *
+ * Each byte is simply negated, so the same transform is used in both directions.
+ * The implementation is selected at startup based on the capabilities of the CPU.
+ *
+ * More info:
+ * https://github.com/Green-Sky/anno16_docs/blob/master/file_formats/encryption.md
+ */
+
+enum class Kernel : std::uint8_t
+{
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+/** Transforms a buffer in place. */
+void transform_in_place(std::span<char> data);
+
+/** Transforms `src` into `dst`, which must be at least as large as `src`.
+ * The buffers may be identical, but must not otherwise overlap. */
+void transform(std::span<const char> src, std::span<char> dst);
+
+/** Transforms `src` into a newly-allocated buffer. */
+std::vector<char> transform(std::span<const char> src);
+
+/** Gets the kernel selected for this CPU. */
+Kernel get_active_kernel();
+
+/** Determines whether the given kernel can run on this CPU. */
+bool is_kernel_supported(Kernel kernel);
+
+/** Transforms `src` into `dst` using a specific kernel, which must be supported.
+ * This is mostly useful for benchmarking. */
+void transform_with_kernel(Kernel kernel, std::span<const char> src, std::span<char> dst);
+
+/** Gets a human-readable name for a kernel. */
+std::string_view get_kernel_name(Kernel kernel);
+
+}}  // namespace Anno::CodCodec
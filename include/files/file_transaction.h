@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "files/file_utils.h"
+
+namespace Anno {
+
+/**
+ * Groups writes to several files so that they are applied all-or-nothing, even if the process is killed or the
+ * machine loses power part-way through.
+ *
+ * Every change is first written to a staging file next to its target, and recorded in a journal. On `commit`, all
+ * staged data is flushed to disk in a single batch, a commit marker is appended to the journal, and only then are
+ * the targets replaced. If we are interrupted, `recover` uses the journal to either finish the job (if the commit
+ * marker was written) or throw away the staged changes (if not).
+ *
+ * If a transaction is destroyed without being committed, its staged changes are discarded.
+ *
+ * Only one transaction may use a given journal at a time, across all processes. This is enforced by an exclusive
+ * lock on a file next to the journal, which is held for the lifetime of the transaction and also taken by `recover`.
+ *
+ * Changes may be staged from several threads at once.
+ *
+ * Journal format (one entry per line, fields separated by tabs). Backslashes, tabs and line breaks within paths are
+ * escaped as `\\`, `\t`, `\n` and `\r`.
+ *
+ *     ANNOTOOL-JOURNAL 2
+ *     replace <target> <staged file>
+ *     patch <target> <offset> <hex bytes>
+ *     COMMIT
+ */
+class FileTransaction
+{
+public:
+    /** Starts a new transaction, creating a journal at the given path.
+     * Waits for any other transaction using the same journal to finish, then completes or discards whatever it
+     * left behind (see `recover`) before starting afresh.
+     * `num_jobs` is the number of threads used to apply patches on commit.
+     * May throw a std::ios_base::failure. */
+    FileTransaction(const std::filesystem::path& journal_path, unsigned num_jobs = 1);
+
+    ~FileTransaction();
+
+    FileTransaction(const FileTransaction&) = delete;
+    FileTransaction& operator=(const FileTransaction&) = delete;
+
+    /** Stages new contents for a file, which will replace it on commit.
+     * May throw a std::ios_base::failure. */
+    void stage_file(const std::filesystem::path& target, std::span<const char> data);
+
+    /** Stages new contents for a file: `prefix` followed by the current contents of the file (minus its first
+     * `num_bytes_to_skip` bytes). The file itself is streamed rather than read into memory.
+     * May throw a std::ios_base::failure. */
+    void stage_file_with_prefix(const std::filesystem::path& target,
+            std::uint64_t num_bytes_to_skip,
+            std::span<const char> prefix);
+
+    /** Stages a small in-place change to an existing file, which will be applied on commit.
+     * May throw a std::ios_base::failure. */
+    void stage_patch(const std::filesystem::path& target, std::uint64_t offset, std::span<const char> data);
+
+    /** Registers a function to be called once the transaction has been committed. */
+    void on_commit(std::function<void()> callback);
+
+    /** Applies all staged changes.
+     * May throw a std::ios_base::failure or std::filesystem::filesystem_error; if this happens before the commit marker is written, nothing is changed,
+     * otherwise the changes will be completed by `recover`. */
+    void commit();
+
+    /** Determines whether the commit marker has been written, after which the changes can no longer be abandoned. */
+    bool was_committed() const
+    {
+        return is_committed;
+    }
+
+    /** Completes or discards a transaction that was interrupted, if the given journal exists.
+     * If the journal exists, waits for any transaction that is still in progress to finish first.
+     * Returns true if anything needed recovering.
+     * May throw a std::ios_base::failure. */
+    static bool recover(const std::filesystem::path& journal_path);
+
+private:
+    static constexpr const char* journal_header = "ANNOTOOL-JOURNAL 2";
+    static constexpr const char* commit_marker = "COMMIT";
+
+    struct Replacement
+    {
+        std::filesystem::path target;
+        std::filesystem::path staged_path;
+    };
+
+    struct Patch
+    {
+        std::filesystem::path target;
+        std::uint64_t offset = 0;
+        std::vector<char> data;
+    };
+
+    static bool recover_locked(const std::filesystem::path& journal_path);
+    static std::filesystem::path make_lock_path(const std::filesystem::path& journal_path);
+    static std::filesystem::path make_staged_path(const std::filesystem::path& target);
+    static void apply(const std::vector<Replacement>& replacements,
+            const std::vector<Patch>& patches,
+            unsigned num_jobs);
+    static void sync_parent_directories(const std::vector<Replacement>& replacements);
+    static void discard(const std::vector<Replacement>& replacements, const std::filesystem::path& journal_path);
+
+    void write_journal_line(const std::string& line);
+    std::filesystem::path add_replacement(const std::filesystem::path& target);
+
+    std::filesystem::path journal_path;
+    unsigned num_jobs;
+
+    // Held until the transaction is destroyed, so that nobody else can touch the journal or our staged files
+    FileUtils::FileLock journal_lock;
+
+    // Guards everything below while changes are being staged
+    std::mutex mutex;
+
+    std::ofstream journal_stream;
+    std::vector<Replacement> replacements;
+    std::vector<Patch> patches;
+    std::vector<std::function<void()>> commit_callbacks;
+    bool is_committed = false;
+};
+
+}  // namespace Anno
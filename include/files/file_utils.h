@@ -1,11 +1,99 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace Anno { namespace FileUtils {
 
+/** How a MappedFile is expected to be read, passed on to the OS as a hint. */
+enum class AccessHint : std::uint8_t
+{
+    Sequential,
+    Random
+};
+
+/**
+ * Read-only view of a file's contents, backed by a memory mapping where possible.
+ *
+ * If the file cannot be mapped, its contents are read into memory instead, so callers can always rely on
+ * `get_bytes`.
+ */
+class MappedFile
+{
+public:
+    /** Maps a file on disk.
+     * May throw a std::ios_base::failure. */
+    explicit MappedFile(const std::filesystem::path& path, AccessHint hint = AccessHint::Sequential);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    std::span<const char> get_bytes() const
+    {
+        return { data, size };
+    }
+
+    /** Determines whether the file is memory-mapped, as opposed to having been read into memory. */
+    bool is_mapped() const
+    {
+        return mapping != nullptr;
+    }
+
+private:
+    bool try_map(const std::filesystem::path& path, AccessHint hint);
+    void unmap();
+
+    const char* data = nullptr;
+    size_t size = 0;
+
+    // Start of the mapped view, or nullptr if not mapped
+    void* mapping = nullptr;
+
+#ifdef _WIN32
+    void* mapping_handle = nullptr;
+#endif
+
+    // Used if the file could not be mapped
+    std::vector<char> fallback_buffer;
+};
+
+/**
+ * Exclusive lock on a file, held for the lifetime of the object and shared with other processes.
+ *
+ * The lock file is created if necessary, and is never deleted (doing so would let two processes lock different
+ * files at the same path). Separate FileLocks on the same file exclude each other even within one process.
+ */
+class FileLock
+{
+public:
+    /** Waits until the lock can be taken.
+     * May throw a std::ios_base::failure. */
+    explicit FileLock(const std::filesystem::path& path);
+    ~FileLock();
+
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+private:
+#ifdef _WIN32
+    void* file_handle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+/** Limits how many files the functions in this namespace may hold open at once, across all threads.
+ * Once the limit is reached, further attempts to open a file wait until another file is closed.
+ * A value of 0 (the default) means "no limit". */
+void set_max_open_files(unsigned max_open_files);
+
 /** Gets the current user's Documents folder, e.g. `%USERPROFILE%/Documents` on Windows.
  * Throws a std::runtime_error if an error occurs. */
 std::filesystem::path get_documents_folder();
@@ -14,13 +102,58 @@ std::filesystem::path get_documents_folder();
  * May throw a std::ios_base::failure. */
 std::vector<char> read_binary_file(const std::filesystem::path& path);
 
+/** Reads at most `max_bytes` from the start of a file and returns the bytes contained within.
+ * The returned buffer is shorter than `max_bytes` if the file is smaller.
+ * May throw a std::ios_base::failure. */
+std::vector<char> read_binary_file_prefix(const std::filesystem::path& path, size_t max_bytes);
+
 /** Reads a text file and returns all lines contained within it (with line endings removed).
  * May throw a std::ios_base::failure. */
 std::vector<std::string> read_text_file(const std::filesystem::path& path);
 
+/** Splits a buffer into lines (with line endings removed).
+ * The returned views refer into `data`. */
+std::vector<std::string_view> split_lines(std::span<const char> data);
+
+/** Converts a path to a UTF-8 string, e.g. for storing in one of our own files. */
+std::string path_to_utf8(const std::filesystem::path& path);
+
+/** Converts a UTF-8 string produced by `path_to_utf8` back to a path. */
+std::filesystem::path path_from_utf8(std::string_view text);
+
+/** Gets a path for a temporary file in the same directory as `path`, which can later be renamed over it.
+ * The path is unique to this call, so concurrent writers never share a temporary file. */
+std::filesystem::path make_temp_path(const std::filesystem::path& path);
+
 /** Writes bytes to a file.
  * May throw a std::ios_base::failure. */
-void write_binary_file(const std::filesystem::path& path, const std::vector<char>& data);
+void write_binary_file(const std::filesystem::path& path, std::span<const char> data);
+
+/** Writes bytes to a temporary file, flushes it to disk and then renames it over `path`, so that a reader (or a
+ * crash) never sees a partially-written file.
+ * May throw a std::ios_base::failure. */
+void replace_binary_file(const std::filesystem::path& path, std::span<const char> data);
+
+/** Overwrites bytes at the given offset within an existing file, leaving the rest of the file untouched.
+ * May throw a std::ios_base::failure. */
+void write_binary_file_at(const std::filesystem::path& path, std::uint64_t offset, std::span<const char> data);
+
+/** Writes `prefix` followed by the contents of `src_path` (minus its first `num_bytes_to_skip` bytes) to `dst_path`,
+ * which must be a different file. The source is streamed through a small buffer.
+ * May throw a std::ios_base::failure. */
+void copy_binary_file_with_prefix(const std::filesystem::path& src_path,
+        const std::filesystem::path& dst_path,
+        std::uint64_t num_bytes_to_skip,
+        std::span<const char> prefix);
+
+/** Writes `prefix` followed by the contents of `src_path` (minus its first `num_bytes_to_skip` bytes) to `dst_path`.
+ * The source is streamed through a small buffer into a temporary file, which is then renamed over `dst_path`,
+ * so `src_path` and `dst_path` may refer to the same file.
+ * May throw a std::ios_base::failure. */
+void write_binary_file_with_prefix(const std::filesystem::path& src_path,
+        const std::filesystem::path& dst_path,
+        std::uint64_t num_bytes_to_skip,
+        std::span<const char> prefix);
 
 /** Writes a single string to a file.
  * May throw a std::ios_base::failure. */
@@ -30,4 +163,13 @@ void write_text_file(const std::filesystem::path& path, const std::string& text)
  * May throw a std::ios_base::failure. */
 void write_text_file(const std::filesystem::path& path, const std::vector<std::string>& lines);
 
+/** Flushes the given files to stable storage.
+ * Where possible (Linux), this is done once per filesystem rather than once per file.
+ * May throw a std::ios_base::failure. */
+void sync_files(const std::vector<std::filesystem::path>& paths);
+
+/** Flushes a directory's entries (e.g. the result of a rename) to stable storage.
+ * May throw a std::ios_base::failure. */
+void sync_directory(const std::filesystem::path& path);
+
 }}  // namespace Anno::FileUtils
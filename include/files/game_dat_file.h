@@ -1,10 +1,14 @@
 #pragma once
 
 #include <array>
+#include <bitset>
 #include <filesystem>
-#include <map>
+#include <span>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include "files/file_transaction.h"
 #include "tool/config.h"
 
 namespace Anno {
@@ -30,8 +34,15 @@ public:
 
     void save_overwrite();
 
+    /** Like `save_overwrite`, but the change is staged as part of a transaction rather than written immediately.
+     * May throw a std::ios_base::failure. */
+    void stage_overwrite(FileTransaction& transaction) const;
+
     void save_to_path(const std::filesystem::path& path);
 
+    /** Produces the file contents that would be written by `save_to_path`. */
+    std::string serialize() const;
+
     int get_main_game_progress() const
     {
         return main_game_progress;
@@ -39,27 +50,47 @@ public:
 
     void set_main_game_progress(int new_progress);
 
+    /** Determines whether there is a progress entry for the given campaign. */
+    bool has_campaign_progress(int campaign_index) const;
+
+    /** Gets the progress for a campaign, or 0 if there is no entry for it. */
     int get_campaign_progress(int campaign_index) const;
 
+    /** Gets the progress for many campaigns at once (0 for any without an entry).
+     * Throws a std::invalid_argument if `progress` is smaller than `campaign_indices`. */
+    void get_campaign_progress(std::span<const int> campaign_indices, std::span<int> progress) const;
+
+    /** Sets the progress for a campaign, creating an entry if necessary.
+     * Throws a std::out_of_range if the index exceeds `max_campaign_index`. */
     void set_campaign_progress(int campaign_index, int progress);
 
+    /** Sets the progress for many campaigns at once.
+     * Throws a std::invalid_argument if the spans differ in size (before changing anything), or a std::out_of_range
+     * if any index exceeds `max_campaign_index`. */
+    void set_campaign_progress(std::span<const int> campaign_indices, std::span<const int> progress);
+
+    /** Moves the progress entry for every campaign index `i` to `new_campaign_indices[i]` (e.g. after some campaigns
+     * have been removed), in a single pass. Entries whose new index is negative are removed.
+     * Indices beyond the end of `new_campaign_indices` are left where they are. */
+    void remap_campaign_progress(std::span<const int> new_campaign_indices);
+
 private:
     void read_dat_file(const std::filesystem::path& path);
-    bool parse_bool_setting(const std::string& line) const;
-    int parse_int_setting(const std::string& line, int default_value = 0) const;
-    void parse_music_setting(const std::string& line);
-    void parse_volume_setting(const std::string& line);
-    void parse_disabled_music_track(const std::string& line);
-    void parse_disabled_speech(const std::string& line);
-    void parse_disabled_video(const std::string& line);
-    void parse_autosave(const std::string& line);
-    void parse_campaign_progress(const std::string& line);
-    void parse_save_slots(const std::vector<std::string>& lines, int& i);
+    void parse_dat_data(std::span<const char> data);
+    void parse_setting(std::string_view line);
+    void parse_music_setting(std::string_view value);
+    void parse_volume_setting(std::string_view value);
+    void parse_disabled_music_track(std::string_view value);
+    void parse_disabled_speech(std::string_view value);
+    void parse_disabled_video(std::string_view value);
+    bool parse_campaign_progress(std::string_view value);
+    void parse_save_slot(std::string_view line);
 
 private:
     static constexpr int num_speech_categories = 8;
     static constexpr int num_video_categories = 8;
     static constexpr int num_savegames = 12;
+    static constexpr int num_campaign_slots = max_campaign_index + 1;
 
     static constexpr int new_game_progress = -595;
     static constexpr int completed_game_progress = -580;
@@ -91,8 +122,12 @@ private:
     int continuous_play_selection = 0;
     int tutorial_selection = 0;  // purpose unknown
 
-    // Campaign progress
-    std::map<int, int> campaign_progress;
+    // Campaign progress, indexed by campaign index (only meaningful where the corresponding bit is set)
+    std::array<int, num_campaign_slots> campaign_progress {};
+    std::bitset<num_campaign_slots> has_progress_entry;
+
+    // Campaign progress entries that could not be parsed (e.g. out-of-range indices), written back as they were
+    std::vector<std::string> unrecognized_campaign_progress;
 
     // Save slots
     std::array<SaveSlot, num_savegames> save_slots;
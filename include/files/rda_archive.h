@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "files/file_utils.h"
+
+namespace Anno {
+
+/**
+ * Read-only access to an RDA archive, such as the History Edition's `data/a1he0.rda`.
+ *
+ * The archive is memory-mapped, and its directory is read once when it is opened. Individual entries are decrypted
+ * and decompressed on demand, a piece at a time, so the archive never needs to be extracted to disk.
+ *
+ * An archive is a chain of blocks. Each block has a header, preceded by a directory of the files it contains (which
+ * may itself be compressed and/or encrypted). Compression is zlib; encryption is a simple XOR with a pseudo-random
+ * key stream. "Memory-resident" blocks store all of their files in a single compressed blob.
+ *
+ * Versions 2.0 and 2.2 of the format are supported.
+ *
+ * More info:
+ * https://github.com/lysanntranvouez/RDAExplorer
+ * https://github.com/esno/rda
+ */
+class RdaArchive
+{
+public:
+    struct Entry
+    {
+        /** Path of the file within the archive, in UTF-8, using '/' as the separator. */
+        std::string path;
+
+        /** Offset of the file's data (from the start of the archive, or of the block's blob if memory-resident). */
+        std::uint64_t offset = 0;
+
+        /** Size of the file's data as stored in the archive. */
+        std::uint64_t stored_size = 0;
+
+        /** Size of the file once decrypted and decompressed. */
+        std::uint64_t size = 0;
+
+        /** Last modification time, as a Unix timestamp. */
+        std::uint64_t timestamp = 0;
+
+        /** Index of the block containing the file. */
+        size_t block_index = 0;
+    };
+
+    /** Opens an archive and reads its directory.
+     * May throw a std::ios_base::failure, or a std::runtime_error if the archive is malformed. */
+    explicit RdaArchive(const std::filesystem::path& path);
+
+    RdaArchive(const RdaArchive&) = delete;
+    RdaArchive& operator=(const RdaArchive&) = delete;
+
+    /** Gets every file in the archive, in the order they appear. */
+    const std::vector<Entry>& get_entries() const
+    {
+        return entries;
+    }
+
+    /** Finds a file by its path within the archive (ignoring case and the type of separator), or returns nullptr if
+     * there is none. If a path appears more than once, the last occurrence wins. */
+    const Entry* find_entry(std::string_view path) const;
+
+    /** Passes the contents of a file to `sink`, a piece at a time, in order.
+     * Safe to call from multiple threads.
+     * Throws a std::runtime_error if the file's data is malformed. */
+    void stream_entry(const Entry& entry, const std::function<void(std::span<const char>)>& sink) const;
+
+    /** Reads the contents of a file into `buffer`, which must be exactly `entry.size` bytes long.
+     * Safe to call from multiple threads.
+     * Throws a std::runtime_error if the file's data is malformed. */
+    void read_entry(const Entry& entry, std::span<char> buffer) const;
+
+    /** Reads the contents of a file into a new buffer.
+     * Throws a std::runtime_error if the file's data is malformed. */
+    std::vector<char> read_entry(const Entry& entry) const;
+
+private:
+    // Block flags
+    static constexpr std::uint32_t flag_compressed = 1;
+    static constexpr std::uint32_t flag_encrypted = 2;
+    static constexpr std::uint32_t flag_memory_resident = 4;
+    static constexpr std::uint32_t flag_deleted = 8;
+
+    struct Block
+    {
+        std::uint32_t flags = 0;
+
+        // Location of the blob containing the block's files (memory-resident blocks only)
+        std::uint64_t blob_offset = 0;
+        std::uint64_t blob_stored_size = 0;
+        std::uint64_t blob_size = 0;
+    };
+
+    static std::string normalize_path(std::string_view path);
+
+    void read_blocks();
+    void read_directory(std::span<const char> directory_data, size_t block_index);
+    void unpack(std::span<const char> stored_data,
+            std::uint32_t flags,
+            std::uint64_t size,
+            const std::function<void(std::span<const char>)>& sink) const;
+    const std::vector<char>& get_blob(size_t block_index) const;
+
+    FileUtils::MappedFile file;
+    bool is_version_2_2 = false;
+    std::vector<Block> blocks;
+    std::vector<Entry> entries;
+
+    // Normalized path -> index into `entries`
+    std::unordered_map<std::string, size_t> entry_indices;
+
+    // Unpacked blobs of memory-resident blocks, by block index, only unpacked when first needed
+    mutable std::mutex blobs_mutex;
+    mutable std::map<size_t, std::unique_ptr<std::vector<char>>> blobs;
+};
+
+}  // namespace Anno
@@ -1,9 +1,14 @@
 #pragma once
 
 #include <filesystem>
+#include <optional>
 #include <string_view>
 #include <vector>
 
+#include "files/chunk_index.h"
+#include "files/file_transaction.h"
+#include "files/file_utils.h"
+
 namespace Anno {
 
 /**
@@ -19,10 +24,26 @@ namespace Anno {
 class ScenarioFile
 {
 public:
-    /** Creates a ScenarioFile by reading a file on disk.
+    /** Creates a ScenarioFile by probing a file on disk.
+     * Only the campaign chunk at the start of the file is read; the rest of the file is never held in memory.
      * May throw a std::ios_base::failure. */
     ScenarioFile(const std::filesystem::path& path);
 
+    /** Creates a ScenarioFile from a header that was previously read from the given file (see `get_header_data`),
+     * without accessing the file. */
+    ScenarioFile(const std::filesystem::path& path, std::vector<char> header_data);
+
+    // Not copyable, since the chunk index refers into our own mapping
+    ScenarioFile(const ScenarioFile&) = delete;
+    ScenarioFile& operator=(const ScenarioFile&) = delete;
+    ScenarioFile(ScenarioFile&&) = default;
+    ScenarioFile& operator=(ScenarioFile&&) = default;
+
+    const std::filesystem::path& get_path() const
+    {
+        return src_path;
+    }
+
     std::string get_filename() const;
 
     int get_campaign_index() const
@@ -32,21 +53,54 @@ public:
 
     void set_campaign_index(int new_campaign_index);
 
+    /** Reverts any change to the campaign index that has not been saved yet. */
+    void discard_changes();
+
+    /** Gets the bytes that were read from the start of the file when it was probed. */
+    const std::vector<char>& get_header_data() const
+    {
+        return header_data;
+    }
+
+    /** Reads the whole file (on first use) and returns an index of its chunks.
+     * Payload views remain valid until the file is next saved.
+     * May throw a std::ios_base::failure, or a std::runtime_error if the file is malformed. */
+    const ChunkIndex& get_chunk_index();
+
+    /** Writes any change to the campaign index back to the source file.
+     * If the campaign chunk is already present, only the index itself is overwritten.
+     * May throw a std::ios_base::failure. */
     void save_overwrite();
+
+    /** Like `save_overwrite`, but the change is staged as part of a transaction rather than written immediately.
+     * May throw a std::ios_base::failure. */
+    void stage_overwrite(FileTransaction& transaction);
+
+    /** Writes the scenario, including any change to the campaign index, to the given path.
+     * May throw a std::ios_base::failure. */
     void save_to_path(const std::filesystem::path& path);
-    void update_data();
 
 private:
-    static constexpr std::string_view campaign_chunk_header = "SZENE_KAMPAGNE\0\0";
+    // The length must be given explicitly, otherwise the view would stop at the first null character
+    static constexpr std::string_view campaign_chunk_header { "SZENE_KAMPAGNE\0\0", 16 };
     static constexpr size_t campaign_chunk_size = 24;
-    static constexpr size_t chunk_header_size = 20;
+    static constexpr size_t chunk_header_size = ChunkIndex::chunk_header_size;
 
+    void read_header();
     void parse_scenario_data();
+    void discard_full_data();
     bool is_campaign_chunk_present(const std::vector<char>& data) const;
-    std::vector<char> prepend_campaign_chunk(const std::vector<char>& data) const;
+    std::vector<char> make_campaign_chunk() const;
 
     std::filesystem::path src_path;
-    std::vector<char> file_data;
+
+    // The first `campaign_chunk_size` bytes of the file (or fewer, if the file is smaller)
+    std::vector<char> header_data;
+
+    // The whole file, only mapped when a full parse is requested
+    std::optional<FileUtils::MappedFile> mapped_file;
+    std::optional<ChunkIndex> chunk_index;
+
     int campaign_index = -1;
     bool is_dirty = false;
 };
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Anno {
+
+/**
+ * Class used for reading and writing the startup snapshot, a cache of everything we parse from an Anno installation
+ * when starting up.
+ *
+ * Every cached item is stored alongside the size and modification time of the file it came from, so that it can be
+ * validated with a single `stat` call instead of reading the file again.
+ *
+ * This is our own binary format; values are stored in native byte order, since the snapshot is never shared between
+ * machines. A snapshot written by a different version of the tool is simply rejected.
+ */
+class SnapshotFile
+{
+public:
+    /** Identifies a particular version of a file on disk. */
+    struct FileStamp
+    {
+        std::uint64_t size = 0;
+        std::int64_t modified_time = 0;
+
+        bool operator==(const FileStamp&) const = default;
+    };
+
+    /** Cached header of a scenario file. */
+    struct ScenarioEntry
+    {
+        /** Filename within the "Szenes" directory (UTF-8). */
+        std::string filename;
+
+        FileStamp stamp;
+
+        /** The bytes read by `ScenarioFile` when probing the file. */
+        std::vector<char> header_data;
+    };
+
+    /** Gets the stamp of a file on disk, or nothing if it cannot be accessed. */
+    static std::optional<FileStamp> get_file_stamp(const std::filesystem::path& path);
+
+    /** Gets the stamp of a directory entry, or nothing if it cannot be accessed. */
+    static std::optional<FileStamp> get_file_stamp(const std::filesystem::directory_entry& entry);
+
+    /** Creates an empty SnapshotFile. */
+    SnapshotFile() = default;
+
+    /** Creates a SnapshotFile by reading a file on disk.
+     * May throw a std::ios_base::failure, or a std::runtime_error if the file is malformed or out of date. */
+    SnapshotFile(const std::filesystem::path& path);
+
+    /** Writes the snapshot to the given path, replacing any existing file.
+     * May throw a std::ios_base::failure. */
+    void save_to_path(const std::filesystem::path& path) const;
+
+    /** Directory of the installation that this snapshot describes. */
+    std::filesystem::path anno_dir;
+
+    FileStamp text_cod_stamp;
+    FileStamp game_dat_stamp;
+
+    /** Contents of the campaign section of `text.cod`. */
+    std::vector<std::string> campaign_section_lines;
+
+    int main_game_progress = 0;
+
+    /** Campaign progress, indexed by campaign index (0 for campaigns without an entry). */
+    std::vector<int> campaign_progress;
+
+    /** Scenario headers, in filename order. */
+    std::vector<ScenarioEntry> scenarios;
+
+private:
+    static constexpr std::string_view magic = "ANNOSNAP";
+    static constexpr std::uint32_t format_version = 1;
+};
+
+}  // namespace Anno
@@ -1,12 +1,17 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
 #include <functional>  // less
 #include <map>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 #include <vector>
 
+#include "files/file_transaction.h"
+
 namespace Anno {
 
 /**
@@ -17,40 +22,105 @@ namespace Anno {
  */
 class TextCodFile
 {
+    // Location of some text within the arena
+    struct TextRange
+    {
+        size_t offset = 0;
+        size_t length = 0;
+    };
+
     struct TextCodSection
     {
-        TextCodSection(const std::string& name)
-            : name(name)
-        {
-        }
+        TextRange name;
+
+        // Range of entries within `lines`
+        size_t first_line = 0;
+        size_t num_lines = 0;
+
+        // Where the section (from its name up to and including its `[END]` line) appeared in the original file.
+        // Not set for sections that have been added since.
+        std::optional<TextRange> source_range;
 
-        std::string name;
-        std::vector<std::string> lines;
+        // Where the section's lines (plus its `[END]` line) appeared in the original file
+        TextRange source_body;
+
+        // Whether `source_body` has been decoded within the arena
+        bool is_body_decoded = false;
+
+        // Whether `lines` has been populated for this section
+        bool are_lines_loaded = false;
+
+        // Whether the lines have changed since the file was read
+        bool is_dirty = false;
     };
 
 public:
+    enum class LoadMode : std::uint8_t
+    {
+        /** Decode all sections up front. */
+        Full,
+
+        /** Only locate sections up front; each section is decoded the first time it is accessed. */
+        Lazy
+    };
+
     /** Creates a TextCodFile by reading a file on disk.
      * May throw a std::ios_base::failure. */
-    TextCodFile(const std::filesystem::path& path);
+    TextCodFile(const std::filesystem::path& path, LoadMode load_mode = LoadMode::Full);
 
     void save_overwrite();
+
+    /** Like `save_overwrite`, but the change is staged as part of a transaction rather than written immediately.
+     * May throw a std::ios_base::failure. */
+    void stage_overwrite(FileTransaction& transaction) const;
+
     void save_plain_text(const std::filesystem::path& path);
     void save_encoded(const std::filesystem::path& path);
 
-    std::vector<std::string> get_section_contents(std::string_view section_name) const;
+    std::vector<std::string> get_section_contents(std::string_view section_name);
+
+    /** Gets the lines of a section without copying them.
+     * The views are invalidated by any subsequent modification. */
+    std::vector<std::string_view> get_section_lines(std::string_view section_name);
+
     void set_section_contents(std::string_view section_name, std::vector<std::string> lines);
 
     static constexpr std::string_view section_campaign = "KAMPAGNE";
 
 private:
     void read_cod_file(const std::filesystem::path& path);
-    int add_new_section(std::string_view section_name);
+    void parse_cod_data(std::span<const char> encoded_data);
+
+    // Serializes the file to a buffer, which is what gets written by the `save_*` methods.
+    // Sections that have not been modified are copied verbatim from the original file.
     std::vector<char> make_buffer(bool should_encode_chars) const;
 
-    static constexpr size_t line_buffer_size = 128;
+    void load_section_lines(TextCodSection& section);
+    int add_new_section(TextRange section_name);
+    void abandon_section_lines(TextCodSection& section);
+    void compact_arena();
+    TextRange append_to_arena(std::string_view text);
+    std::string_view get_text(TextRange range) const;
+    size_t get_serialized_size(const TextCodSection& section) const;
 
     std::filesystem::path src_path;
 
+    // Starts out as a copy of the original file, which stays encoded except for the parts that have been accessed:
+    // section names are decoded when the file is read, and section bodies are decoded on demand.
+    // All section names and lines refer into this buffer; modified lines are appended to it (decoded), and the arena is
+    // compacted once most of what has been appended is no longer in use.
+    std::vector<char> arena;
+
+    // Size of the original file, which occupies the start of the arena
+    size_t source_size = 0;
+
+    // Lines of all sections, stored contiguously for each section
+    std::vector<TextRange> lines;
+
+    // Amount of the arena (beyond the original file) and of `lines` that belongs to lines which have been replaced
+    size_t num_abandoned_bytes = 0;
+    size_t num_abandoned_lines = 0;
+
     std::vector<TextCodSection> sections;
     std::map<std::string, int, std::less<>> section_map;
 };
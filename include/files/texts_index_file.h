@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "files/file_utils.h"
+#include "files/snapshot_file.h"
+
+namespace Anno {
+
+/**
+ * Class used for reading and writing the localization index, which maps History Edition localization keys (e.g.
+ * `[[103]]`) to localized strings.
+ *
+ * The index is built once from `texts.xml`, and saved so that later runs can simply map it into memory. It consists of
+ * an open-addressing hash table of (key, offset, length) slots, followed by the strings themselves, so any key can be
+ * looked up without reading anything else.
+ *
+ * This is our own binary format; values are stored in native byte order, since the index is never shared between
+ * machines. An index written by a different version of the tool is simply rejected.
+ */
+class TextsIndexFile
+{
+public:
+    /** Creates an empty TextsIndexFile. */
+    TextsIndexFile() = default;
+
+    /** Creates a TextsIndexFile by mapping a file on disk.
+     * May throw a std::ios_base::failure, or a std::runtime_error if the file is malformed or out of date. */
+    explicit TextsIndexFile(const std::filesystem::path& path);
+
+    /** Creates a TextsIndexFile from the texts read from a `texts.xml` file with the given stamp.
+     * If a key appears more than once, the last occurrence wins. */
+    TextsIndexFile(const SnapshotFile::FileStamp& source_stamp,
+            const std::vector<std::pair<std::uint32_t, std::string>>& texts);
+
+    /** Writes the index to the given path, replacing any existing file.
+     * May throw a std::ios_base::failure. */
+    void save_to_path(const std::filesystem::path& path) const;
+
+    /** Stamp of the file that the texts were read from. */
+    const SnapshotFile::FileStamp& get_source_stamp() const
+    {
+        return source_stamp;
+    }
+
+    /** Gets the number of texts in the index. */
+    size_t get_num_texts() const
+    {
+        return num_texts;
+    }
+
+    /** Finds the text with the given key, or returns nothing if there is none. */
+    std::optional<std::string_view> find_text(std::uint32_t id) const;
+
+private:
+    static constexpr std::string_view magic = "ANNOTEXT";
+    static constexpr std::uint32_t format_version = 1;
+
+    // Each slot holds a key, and the offset and length of its text; slots with no text have the maximum length
+    static constexpr size_t slot_size = 3 * sizeof(std::uint32_t);
+    static constexpr std::uint32_t empty_slot_length = 0xFFFFFFFF;
+
+    static size_t get_slot_index(std::uint32_t id, size_t num_slots);
+
+    void read_header();
+
+    // Backing storage: either a mapped file, or an index that we built ourselves (moving either keeps `data` valid)
+    std::optional<FileUtils::MappedFile> file;
+    std::vector<char> built_data;
+    std::span<const char> data;
+
+    SnapshotFile::FileStamp source_stamp;
+    size_t num_slots = 0;
+    size_t num_texts = 0;
+    size_t slots_offset = 0;
+    size_t strings_offset = 0;
+    size_t strings_size = 0;
+};
+
+}  // namespace Anno
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace Anno {
+
+/**
+ * Streaming parser for the History Edition's `texts.xml`, which maps localization keys (as used in `text.cod`, e.g.
+ * `[[103]]`) to localized strings.
+ *
+ * The document is fed in a piece at a time, and each text is reported as soon as it has been read, so the document
+ * never needs to be held in memory (or turned into a tree). Only the handful of XML features used by localization
+ * files are supported: elements, attributes, character data, CDATA sections and the standard entities.
+ *
+ * A text is recognised in either of these forms:
+ *
+ *     <Text><GUID>103</GUID><Text>Localized string</Text></Text>
+ *     <Text id="103">Localized string</Text>
+ *
+ * The key may be given by a `GUID`, `LineId` or `Id` element or attribute (ignoring case), and the string by a `Text`
+ * or `Value` element.
+ */
+class TextsXmlParser
+{
+public:
+    using TextHandler = std::function<void(std::uint32_t id, std::string_view text)>;
+
+    /** Creates a parser that reports each text to `on_text`. */
+    explicit TextsXmlParser(TextHandler on_text);
+
+    /** Parses the next piece of the document.
+     * Throws a std::runtime_error if the document is malformed. */
+    void parse(std::span<const char> data);
+
+    /** Checks that the whole document has been parsed.
+     * Throws a std::runtime_error if the document ends unexpectedly. */
+    void finish();
+
+private:
+    void parse_markup(std::string_view markup);
+    void start_element(std::string_view tag);
+    void end_element(std::string_view tag);
+    void emit_record();
+
+    TextHandler on_text;
+
+    // Data that could not be parsed yet, because it ends partway through some markup
+    std::string pending;
+    bool is_start = true;
+    int depth = 0;
+
+    // Character data since the last start tag
+    std::string current_text;
+    bool current_has_children = false;
+    std::optional<std::uint32_t> current_attribute_id;
+
+    // Parts of the record being read, from child elements
+    std::optional<std::uint32_t> record_id;
+    std::optional<std::string> record_text;
+};
+
+}  // namespace Anno
@@ -2,9 +2,13 @@
 
 #include <cstdint>
 #include <filesystem>
+#include <optional>
 
 namespace Anno {
 
+/** Highest campaign index that we consider valid; anything above this is a sign of a corrupted file. */
+inline constexpr int max_campaign_index = 512;
+
 enum class GameVersion : std::uint8_t
 {
     Original,
@@ -22,6 +26,16 @@ struct Config
     std::filesystem::path user_dir;
 
     GameVersion version = GameVersion::Original;
+
+    /** Number of worker threads used when scanning the `Szenes` directory.
+     * A value of 0 means "use all available cores". */
+    int num_jobs = 0;
 };
 
+/** Determines which version of the game is installed in the given directory, if any. */
+std::optional<GameVersion> detect_game_version(const std::filesystem::path& anno_dir);
+
+/** Gets the directory containing `Game.dat` for the given installation (see `Config::user_dir`). */
+std::filesystem::path get_default_user_dir(const std::filesystem::path& anno_dir, GameVersion version);
+
 }  // namespace Anno
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "tool/tool.h"
+
+namespace Anno {
+
+/** An installation managed as part of a fleet. */
+struct FleetInstall
+{
+    /** Directory containing the game executable. */
+    std::filesystem::path anno_dir;
+
+    /** Directory containing `Game.dat`, or empty to determine this from the game version. */
+    std::filesystem::path user_dir;
+};
+
+/** An operation to perform on every installation in a fleet. */
+struct FleetOperation
+{
+    enum class Type : std::uint8_t
+    {
+        ListCampaigns,
+        InstallCampaigns,
+        UninstallCampaigns,
+        CompactCampaigns,
+        SetProgress
+    };
+
+    Type type = Type::ListCampaigns;
+
+    /** Campaigns to install or uninstall (InstallCampaigns / UninstallCampaigns only). */
+    std::vector<Campaign> campaigns;
+
+    /** Campaign whose progress should be set, or -1 for the main game (SetProgress only). */
+    int campaign_index = -1;
+
+    /** Progress to set (SetProgress only). */
+    int progress = 0;
+};
+
+/** The outcome of performing an operation on a single installation. */
+struct FleetResult
+{
+    std::filesystem::path anno_dir;
+
+    bool success = false;
+
+    /** Reason for failure, if the operation did not succeed. */
+    std::string error;
+
+    /** Installed campaigns after the operation, along with the progress in each. */
+    std::vector<InstalledCampaign> installed_campaigns;
+
+    std::chrono::milliseconds duration { 0 };
+};
+
+/**
+ * Performs the same operation on many installations at once (e.g. every Wine prefix on a host).
+ *
+ * Installations are handed out to a pool of worker threads one at a time, so a few slow disks do not hold up the rest
+ * of the fleet. A failure in one installation is recorded in its result, and does not affect any of the others.
+ *
+ * To limit the number of files open at once, see `FileUtils::set_max_open_files`.
+ */
+class Fleet
+{
+public:
+    /** `num_jobs` is the number of installations to work on at once; 0 means "use all available cores". */
+    Fleet(std::vector<FleetInstall> installs, int num_jobs);
+
+    /** Reads a fleet manifest, which lists one installation per line.
+     * Each line contains an Anno directory, optionally followed by a tab and the user directory for that
+     * installation. Relative paths are relative to the manifest itself.
+     * May throw a std::ios_base::failure. */
+    static std::vector<FleetInstall> read_manifest(const std::filesystem::path& path);
+
+    /** Performs an operation on every installation, and returns the results in the same order as the installations.
+     * Progress messages logged by different installations may be interleaved. */
+    std::vector<FleetResult> run(const FleetOperation& operation) const;
+
+private:
+    FleetResult run_one(const FleetInstall& install, const FleetOperation& operation, int num_scan_jobs) const;
+
+    std::vector<FleetInstall> installs;
+    int num_jobs;
+};
+
+}  // namespace Anno
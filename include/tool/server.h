@@ -0,0 +1,81 @@
+#pragma once
+
+#include <filesystem>
+#include <istream>
+#include <ostream>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "tool/tool.h"
+#include "util/json.h"
+
+namespace Anno {
+
+/**
+ * Serves requests against a long-lived Tool, so that clients don't pay for start-up with every call.
+ *
+ * The protocol is newline-delimited JSON: each request is a single-line object of the form
+ * `{"id": ..., "method": "...", "params": {...}}`, and receives a single-line response of the form
+ * `{"id": ..., "ok": true, "result": {...}}` or `{"id": ..., "ok": false, "error": "..."}`.
+ * All strings are UTF-8; campaign and level names are converted to and from the game's own encoding (Windows-1252).
+ *
+ * Supported methods:
+ *
+ * - `list_campaigns`: lists installed campaigns, with their levels and progress.
+ * - `get_progress`: gets the progress for `params.campaign`, or for the main game if this is omitted.
+ * - `set_progress`: sets the progress for `params.campaign` (or the main game) to `params.progress`, and saves it.
+ * - `install_campaigns`: installs `params.campaigns`, a list of `{"name": "...", "levels": ["...", ...]}`.
+ * - `uninstall_campaigns`: uninstalls `params.campaigns`, a list of campaign names.
+ * - `compact_campaigns`: renumbers the installed campaigns to remove any gaps between them.
+ *
+ * Read-only requests may run concurrently; requests that modify anything run one at a time.
+ *
+ * Before each request, any game files that have been changed by another program since the last request are re-read.
+ */
+class Server
+{
+public:
+    /** Maximum length of a single request, to protect against misbehaving clients. */
+    static constexpr size_t max_request_size = 1024 * 1024;
+
+    /** Maximum number of socket connections served at once; any others wait until one of these closes. */
+    static constexpr unsigned max_connections = 16;
+
+    Server(Tool& tool);
+
+    /** Handles a single request, and returns the response (without a trailing newline).
+     * Safe to call from multiple threads. */
+    std::string handle_request(std::string_view request_text);
+
+    /** Serves requests from a stream, one per line, until the end of the stream is reached. */
+    void serve_stream(std::istream& in, std::ostream& out);
+
+    /** Listens for connections on a Unix domain socket, serving up to `max_connections` at once on a pool of
+     * worker threads.
+     * Never returns normally: if anything goes wrong, every connection is closed and the workers are joined before
+     * a std::runtime_error is thrown. This is also thrown if the socket cannot be created, or sockets are not
+     * supported. */
+    void serve_socket(const std::filesystem::path& socket_path);
+
+    /** Describes installed campaigns as a JSON array of `{"index", "name", "levels", "progress"}` objects, as
+     * returned by `list_campaigns`. */
+    static Json::Value describe_campaigns(const std::vector<InstalledCampaign>& installed_campaigns);
+
+private:
+    Json::Value list_campaigns() const;
+    Json::Value get_progress(const Json::Value& params) const;
+    Json::Value set_progress(const Json::Value& params);
+    Json::Value install_campaigns(const Json::Value& params);
+    Json::Value uninstall_campaigns(const Json::Value& params);
+    Json::Value compact_campaigns();
+    void serve_connection(int fd);
+
+    Tool& tool;
+
+    // Guards the Tool: shared for read-only requests, exclusive for anything else
+    std::shared_mutex tool_mutex;
+};
+
+}  // namespace Anno
@@ -1,13 +1,20 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
+#include <map>
+#include <optional>
+#include <set>
+#include <span>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "files/game_dat_file.h"
 #include "files/scenario_file.h"
+#include "files/snapshot_file.h"
 #include "files/text_cod_file.h"
+#include "files/texts_index_file.h"
 #include "tool/config.h"
 
 namespace Anno {
@@ -20,6 +27,43 @@ struct Campaign
 
     std::string name;
     std::vector<std::string> level_names;
+
+    bool operator==(const Campaign&) const = default;
+};
+
+/** An installed campaign, as reported by `Tool::list_campaigns`. */
+struct InstalledCampaign
+{
+    /** Index of the campaign, as used by scenario files and `Game.dat`. */
+    int index = -1;
+
+    Campaign campaign;
+
+    /** The player's progress in the campaign. */
+    int progress = 0;
+};
+
+/** A change to the state of the installation, as detected by `Tool::refresh`. */
+struct StateChange
+{
+    enum class Type : std::uint8_t
+    {
+        ScenarioAdded,
+        ScenarioChanged,
+        ScenarioRemoved,
+        CampaignAdded,
+        CampaignChanged,
+        CampaignRemoved,
+        ProgressChanged
+    };
+
+    Type type;
+
+    /** Name of the affected scenario or campaign. */
+    std::string name;
+
+    /** Index of the affected campaign, if any. */
+    int campaign_index = -1;
 };
 
 class Tool
@@ -30,36 +74,116 @@ public:
     /** Gets the list of installed campaigns. */
     std::vector<Campaign> get_installed_campaigns() const;
 
+    /** Lists the installed campaigns along with the player's progress, skipping any unused campaign indices. */
+    std::vector<InstalledCampaign> list_campaigns() const;
+
     /** Installs a campaign. */
     bool install_campaign(const Campaign& campaign);
 
-    /** Uninstalls a campaign. */
-    void uninstall_campaign(const Campaign& campaign);
+    /** Installs several campaigns at once.
+     * Any gaps in the campaign indices are filled first; the remaining campaigns are added at the end.
+     * Every affected file is written exactly once. */
+    bool install_campaigns(const std::vector<Campaign>& campaigns);
+
+    /** Uninstalls a campaign. Only the campaign name is used. */
+    bool uninstall_campaign(const Campaign& campaign);
+
+    /** Uninstalls several campaigns at once. Only the campaign names are used.
+     * Later campaigns are moved down to fill the gaps, along with their progress. Every affected file is written
+     * exactly once, and campaigns before the first one removed are not touched at all. */
+    bool uninstall_campaigns(const std::vector<Campaign>& campaigns);
+
+    /** Renumbers the installed campaigns so that there are no gaps between them, keeping their order and progress.
+     * Every affected file is written exactly once, and campaigns before the first gap are not touched at all. */
+    bool compact_campaigns();
 
     /** Gets the player's progress in the main game. */
     int get_main_game_progress() const;
 
-    /** Sets the player's progress in the main game. */
+    /** Sets the player's progress in the main game.
+     * Changes will not be saved to disk until `save_player_data` is called. */
     void set_main_game_progress(int progress);
 
     /** Gets the player's progress in a campaign. */
     int get_campaign_progress(int campaign_index) const;
 
+    /** Gets the player's progress in many campaigns at once.
+     * `progress` must be at least as large as `campaign_indices`. */
+    void get_campaign_progress(std::span<const int> campaign_indices, std::span<int> progress) const;
+
     /** Sets the player's progress in a campaign.
      * Changes will not be saved to disk until `save_player_data` is called. */
     void set_campaign_progress(int campaign_index, int progress);
 
-private:
-    static constexpr int max_campaign_index = 512;
+    /** Saves any changes to the player's progress to disk.
+     * May throw a std::ios_base::failure. */
+    void save_player_data();
+
+    /** Throws away any changes to the player's progress that have not been saved, e.g. because saving failed.
+     * The saved progress is read back from disk. */
+    void discard_player_data_changes();
+
+    /** Re-reads the given files, which have been changed by someone else, and appends how our state has changed
+     * to `changes`.
+     * Paths that are not scenarios, `text.cod` or `Game.dat` are ignored.
+     * May throw a std::ios_base::failure or std::filesystem::filesystem_error, but only once our state is
+     * consistent again; any changes that were made are still reported. */
+    void refresh(const std::vector<std::filesystem::path>& changed_paths, std::vector<StateChange>& changes);
 
-    void read_installed_scenarios();
-    void parse_campaign_level_names();
+    /** Checks whether `text.cod`, `Game.dat` or any scenario has changed on disk since we last saw it (going by
+     * size and modification time), and refreshes any that have, as `refresh` does.
+     * This is much cheaper than `refresh_all`, since unchanged files are not read. */
+    void refresh_if_changed(std::vector<StateChange>& changes);
+
+    /** Re-reads every file that could have changed, e.g. if some change notifications were lost.
+     * Errors are handled as for `refresh`. */
+    void refresh_all(std::vector<StateChange>& changes);
+
+private:
+    bool load_snapshot();
+    void save_snapshot();
+    void update_snapshot_entry(const std::filesystem::path& path, const ScenarioFile* scenario);
+    bool read_installed_scenarios();
+    void refresh_scenario(const std::filesystem::path& path, std::vector<StateChange>& changes);
+    void move_scenario_to_campaign(const std::string& scenario_name, int old_campaign_index, int new_campaign_index);
+    void rebuild_installed_campaigns();
+    std::vector<int> allocate_campaign_indices(size_t count) const;
+    bool renumber_campaigns(const std::vector<int>& new_campaign_indices);
+    bool reload_if_needed();
+    void parse_campaign_level_names(const std::vector<std::string_view>& campaign_data);
+    std::string localize(std::string_view text);
+    void load_texts_index();
+    GameDatFile& get_game_dat_file();
+    TextCodFile& get_text_cod();
 
     Config cfg;
-    GameDatFile game_dat_file;
-    TextCodFile text_cod;
+
+    // These are only loaded when needed if the snapshot is up to date; until then, the snapshot is used instead
+    std::optional<GameDatFile> game_dat_file;
+    std::optional<TextCodFile> text_cod;
+
+    // Only loaded once a localization key is found (History Edition only); empty if the texts could not be read
+    std::optional<TextsIndexFile> texts_index;
+    bool is_texts_index_loaded = false;
+
+    // Cached state of the installation, kept up to date with any changes we make
+    SnapshotFile snapshot;
+
     std::unordered_map<std::string, ScenarioFile> installed_scenarios;
+
+    // Names of the scenarios linked to each campaign, in order; the first determines the campaign name
+    std::map<int, std::set<std::string>> campaign_scenarios;
+
     std::vector<Campaign> installed_campaigns;
+
+    // Indices below `installed_campaigns.size()` that have no scenarios, and can be reused by new campaigns
+    std::set<int> free_campaign_indices;
+
+    // Missing campaigns that have already been warned about
+    std::set<int> reported_missing_campaign_indices;
+
+    // Set if a transaction failed after being committed, in which case our state may not match the files on disk
+    bool needs_reload = false;
 };
 
 }  // namespace Anno
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tool/config.h"
+#include "tool/tool.h"
+
+namespace Anno {
+
+/**
+ * Keeps a Tool up to date with changes made to the game files by other programs.
+ *
+ * The directories containing `text.cod`, `Game.dat` and the scenarios are watched for changes. Watching directories
+ * rather than individual files means that we also see files that are replaced (e.g. by renaming a new version over
+ * them), which is how most programs (including this one) save files safely.
+ *
+ * Events are collected until things go quiet, so that a burst of changes (e.g. copying in a whole campaign) results in
+ * a single update. Each update is reported as a change feed, one change per line.
+ *
+ * Currently only supported on Linux (using inotify).
+ */
+class Watcher
+{
+public:
+    /** How long to wait for more events before processing a batch. */
+    static constexpr std::chrono::milliseconds quiet_period { 250 };
+
+    /** Maximum time to hold on to a batch, in case events never stop. */
+    static constexpr std::chrono::milliseconds max_batch_delay { 2000 };
+
+    /** Starts watching the files used by the given Tool.
+     * Throws a std::runtime_error if watching is not supported, or fails. */
+    Watcher(Tool& tool, const Config& cfg);
+
+    ~Watcher();
+
+    Watcher(const Watcher&) = delete;
+    Watcher& operator=(const Watcher&) = delete;
+
+    /** Processes changes as they happen, writing a change feed to the given stream.
+     * Only returns if an error occurs. */
+    void run(std::ostream& out);
+
+    /** Describes a change in the format used by the change feed. */
+    static std::string describe_change(const StateChange& change);
+
+private:
+    void add_watch(const std::filesystem::path& dir);
+    bool wait_for_changes(std::vector<std::filesystem::path>& changed_paths);
+    bool read_events(std::vector<std::filesystem::path>& changed_paths);
+
+    Tool& tool;
+    int inotify_fd = -1;
+
+    // Watched directories, by watch descriptor
+    std::unordered_map<int, std::filesystem::path> watched_dirs;
+};
+
+}  // namespace Anno
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstring>  // memcpy
+#include <span>
+#include <stdexcept>
 #include <vector>
 
 namespace Anno { namespace BufferUtils {
@@ -15,4 +18,18 @@ void append(std::vector<char>& buf, const T& value)
     buf.insert(buf.end(), data, data + sizeof(T));
 }
 
+/** Reads `num_bytes` bytes from the given buffer, starting at `offset`, and advances `offset` past them.
+ * Throws a std::runtime_error if the buffer is too short. */
+std::span<const char> read_bytes(std::span<const char> buf, size_t& offset, size_t num_bytes);
+
+/** Reads a value from the given buffer, starting at `offset`, and advances `offset` past it.
+ * Throws a std::runtime_error if the buffer is too short. */
+template <typename T>
+T read(std::span<const char> buf, size_t& offset)
+{
+    T value;
+    std::memcpy(&value, read_bytes(buf, offset, sizeof(T)).data(), sizeof(T));
+    return value;
+}
+
 }}  // namespace Anno::BufferUtils
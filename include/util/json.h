@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Anno { namespace Json {
+
+/** Thrown when text is not valid JSON, or a value is not of the expected type. */
+class Error : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+struct Member;
+
+/**
+ * Minimal JSON value, sufficient for the request protocol used by the server.
+ *
+ * Numbers are stored as 64-bit integers, since the protocol never needs fractions. Object members keep their original
+ * order.
+ */
+class Value
+{
+public:
+    enum class Type : std::uint8_t
+    {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    Value() = default;
+    Value(std::nullptr_t) {}
+    Value(bool value);
+    Value(int value);
+    Value(std::int64_t value);
+    Value(std::string value);
+    Value(std::string_view value);
+    Value(const char* value);
+    Value(std::vector<Value> values);
+    Value(std::vector<Member> members);
+
+    Type get_type() const
+    {
+        return type;
+    }
+
+    bool is_null() const
+    {
+        return type == Type::Null;
+    }
+
+    /** These throw a Json::Error if the value is of the wrong type. */
+    bool as_bool() const;
+    std::int64_t as_int() const;
+    const std::string& as_string() const;
+    const std::vector<Value>& as_array() const;
+    const std::vector<Member>& as_object() const;
+
+    /** Finds a member of an object, or returns nullptr if there is none (or this is not an object). */
+    const Value* find(std::string_view key) const;
+
+    /** Gets a member of an object.
+     * Throws a Json::Error if there is none. */
+    const Value& at(std::string_view key) const;
+
+    /** Adds a member to an object (replacing a null value with an empty object first). */
+    Value& set(std::string key, Value value);
+
+    /** Appends this value to `out`, as compact single-line JSON. */
+    void write(std::string& out) const;
+
+    /** Converts this value to compact single-line JSON. */
+    std::string to_string() const;
+
+private:
+    Type type = Type::Null;
+    bool bool_value = false;
+    std::int64_t number_value = 0;
+    std::string string_value;
+    std::vector<Value> array_value;
+    std::vector<Member> object_value;
+};
+
+struct Member
+{
+    std::string key;
+    Value value;
+};
+
+/** Parses a JSON document.
+ * Throws a Json::Error if the text is not valid JSON. */
+Value parse(std::string_view text);
+
+}}  // namespace Anno::Json
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <ostream>
+#include <sstream>
+#include <string>
+
+namespace Anno { namespace Log {
+
+/**
+ * Streams that the core library writes its messages to.
+ *
+ * By default these are simply `std::cout` and `std::cerr`, but a program embedding the library can capture them
+ * instead (see `Capture`), so that the library never writes to the console behind its back.
+ */
+
+/** Gets the stream for progress messages. */
+std::ostream& out();
+
+/** Gets the stream for warnings and errors. */
+std::ostream& err();
+
+/**
+ * Captures the messages written by the current thread for as long as it exists.
+ *
+ * Errors are collected so that they can be reported some other way, and progress messages are discarded. Captures may
+ * be nested, in which case only the innermost one receives messages.
+ */
+class Capture
+{
+public:
+    Capture();
+    ~Capture();
+
+    Capture(const Capture&) = delete;
+    Capture& operator=(const Capture&) = delete;
+
+    /** Gets everything written to `err` so far, without any trailing newline. */
+    std::string get_errors() const;
+
+private:
+    friend std::ostream& out();
+    friend std::ostream& err();
+
+    // Capture that was active on this thread before this one
+    Capture* previous;
+
+    std::ostringstream errors;
+
+    // Stream with no buffer, so that anything written to it goes nowhere
+    std::ostream discarded { nullptr };
+};
+
+}}  // namespace Anno::Log
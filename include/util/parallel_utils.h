@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>  // min
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Anno { namespace ParallelUtils {
+
+/** Gets the number of worker threads to use for a requested job count.
+ * A value of 0 or less means "use all available cores". */
+unsigned resolve_num_jobs(int requested_jobs);
+
+/** Calls `func(i)` for every `i` in `[0, count)`, spread across at most `num_jobs` worker threads.
+ * Work items are claimed one at a time, so slow items do not hold up the rest of the batch.
+ * If any call throws, the remaining items are abandoned and the first exception is rethrown once all workers have
+ * finished. */
+template <typename Func>
+void parallel_for(size_t count, unsigned num_jobs, Func&& func)
+{
+    const size_t num_workers = std::min<size_t>(std::max(num_jobs, 1u), count);
+    if (num_workers <= 1)
+    {
+        // Not worth spinning up any threads
+        for (size_t i = 0; i < count; ++i)
+        {
+            func(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next_index = 0;
+    std::atomic<bool> has_failed = false;
+    std::exception_ptr first_error;
+    std::mutex error_mutex;
+
+    auto worker = [&]() {
+        while (!has_failed)
+        {
+            const size_t i = next_index++;
+            if (i >= count)
+            {
+                break;
+            }
+
+            try
+            {
+                func(i);
+            }
+            catch (...)
+            {
+                std::scoped_lock lock(error_mutex);
+                if (!first_error)
+                {
+                    first_error = std::current_exception();
+                }
+                has_failed = true;
+            }
+        }
+    };
+
+    {
+        std::vector<std::jthread> workers;
+        workers.reserve(num_workers);
+        for (size_t i = 0; i < num_workers; ++i)
+        {
+            workers.emplace_back(worker);
+        }
+        // Workers are joined here
+    }
+
+    if (first_error)
+    {
+        std::rethrow_exception(first_error);
+    }
+}
+
+}}  // namespace Anno::ParallelUtils
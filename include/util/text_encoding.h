@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace Anno { namespace TextEncoding {
+
+/**
+ * Conversions between the encodings we have to deal with.
+ *
+ * The game files (`text.cod`, scenario names, etc.) use Windows-1252, and this is what the Tool works with
+ * internally. Anything we exchange with other programs (JSON, the C API) is UTF-8, so text must be converted at
+ * those boundaries.
+ */
+
+/** Appends the UTF-8 encoding of a code point to `out`. */
+void append_utf8(std::string& out, std::uint32_t code_point);
+
+/** Decodes the UTF-8 sequence starting at `pos`, and advances `pos` past it.
+ * If the sequence is invalid (or truncated), returns nothing and advances `pos` by a single byte. */
+std::optional<std::uint32_t> decode_utf8(std::string_view text, size_t& pos);
+
+/** Converts Windows-1252 text to UTF-8. */
+std::string windows1252_to_utf8(std::string_view text);
+
+/** Converts UTF-8 text to Windows-1252.
+ * Characters that can't be represented (and invalid sequences) are replaced with '?'. */
+std::string utf8_to_windows1252(std::string_view text);
+
+}}  // namespace Anno::TextEncoding
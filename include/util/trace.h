@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace Anno { namespace Trace {
+
+namespace Detail {
+
+// Checked by every span, so this must be as cheap as possible to read
+inline std::atomic<bool> is_enabled = false;
+
+}  // namespace Detail
+
+/** Determines whether spans are currently being recorded. */
+inline bool is_enabled()
+{
+    return Detail::is_enabled.load(std::memory_order_relaxed);
+}
+
+/** Starts recording spans on all threads. */
+void start();
+
+/** Stops recording, and writes everything recorded since `start` to a file in the Chrome trace-event format
+ * (viewable in `chrome://tracing` or https://ui.perfetto.dev).
+ * Safe to call while other threads are recording; any spans still open are not included.
+ * May throw a std::ios_base::failure. */
+void stop(const std::filesystem::path& output_path);
+
+/** Records a trace for as long as it exists, then writes it to a file (see `stop`).
+ * The trace is also written if the process is interrupted (e.g. by Ctrl+C, SIGINT or SIGTERM), so that long-running
+ * modes can be traced too. Only one Session may exist at a time, and it should be created before any other threads.
+ * Any error writing the file is logged rather than thrown. */
+class Session
+{
+public:
+    explicit Session(std::filesystem::path output_path);
+    ~Session();
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+private:
+    void handle_interruptions();
+    void stop_handling_interruptions();
+
+    // Waits for interruptions (where these are delivered as signals)
+    std::thread interruption_thread;
+};
+
+/**
+ * Records the time between its construction and destruction.
+ *
+ * When tracing is disabled, a Span does nothing beyond checking a flag.
+ * Names and categories must be string literals (or otherwise outlive the trace).
+ */
+class Span
+{
+public:
+    Span(const char* category, const char* name)
+        : category(category)
+        , name(is_enabled() ? name : nullptr)
+    {
+        if (this->name)
+        {
+            start_time = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~Span()
+    {
+        if (name)
+        {
+            record();
+        }
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    /** Attaches the number of bytes processed to the span. */
+    void set_bytes(std::uint64_t num_bytes)
+    {
+        bytes = num_bytes;
+    }
+
+    /** Attaches the file being processed to the span. */
+    void set_path(const std::filesystem::path& path)
+    {
+        if (name)
+        {
+            const std::u8string path_utf8 = path.u8string();
+            detail.assign(path_utf8.begin(), path_utf8.end());
+        }
+    }
+
+private:
+    void record();
+
+    const char* category;
+    const char* name;
+    std::chrono::steady_clock::time_point start_time;
+    std::optional<std::uint64_t> bytes;
+    std::string detail;
+};
+
+}}  // namespace Anno::Trace
@@ -0,0 +1,259 @@
+#include "capi/anno_core.h"
+
+#include <cstdlib>  // malloc, free
+#include <cstring>  // memcpy
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>  // move
+#include <vector>
+
+#include "files/file_utils.h"
+#include "tool/config.h"
+#include "tool/server.h"
+#include "tool/tool.h"
+#include "util/json.h"
+#include "util/log.h"
+#include "util/text_encoding.h"
+
+using namespace Anno;
+
+struct AnnoHandle
+{
+    explicit AnnoHandle(const Config& cfg)
+        : tool(cfg)
+    {
+    }
+
+    Tool tool;
+
+    // Shared for queries, exclusive for anything that modifies the Tool
+    std::shared_mutex mutex;
+};
+
+/*
+ * Helper methods
+ */
+
+static thread_local std::string last_error;
+
+// Messages may contain text from the game files, which is Windows-1252 rather than UTF-8
+static std::string to_valid_utf8(std::string text)
+{
+    for (size_t pos = 0; pos < text.size();)
+    {
+        if (!TextEncoding::decode_utf8(text, pos).has_value())
+        {
+            return TextEncoding::windows1252_to_utf8(text);
+        }
+    }
+    return text;
+}
+
+static AnnoStatus fail(AnnoStatus status, std::string message)
+{
+    last_error = to_valid_utf8(std::move(message));
+    return status;
+}
+
+// Exceptions must never cross the C boundary, and nothing may be written to the console.
+// If the Tool reports a failure, whatever it logged is a better description than anything we could come up with.
+template <typename Func>
+static AnnoStatus call_safely(Func&& func)
+{
+    Log::Capture capture;
+    try
+    {
+        const AnnoStatus status = func();
+        const std::string errors = capture.get_errors();
+        if (status != ANNO_OK && !errors.empty())
+        {
+            return fail(status, errors);
+        }
+        return status;
+    }
+    catch (const std::invalid_argument& e)
+    {
+        return fail(ANNO_INVALID_ARGUMENT, e.what());
+    }
+    catch (const std::out_of_range& e)
+    {
+        return fail(ANNO_INVALID_ARGUMENT, e.what());
+    }
+    catch (const std::exception& e)
+    {
+        return fail(ANNO_ERROR, e.what());
+    }
+    catch (...)
+    {
+        return fail(ANNO_ERROR, "Unknown error");
+    }
+}
+
+// Other programs (e.g. the game saving progress) may have changed the files since the handle was last used, and we
+// must never act on (or overwrite) an out-of-date view of them
+static void refresh_if_changed(AnnoHandle* handle)
+{
+    std::unique_lock lock(handle->mutex);
+    std::vector<StateChange> changes;
+    handle->tool.refresh_if_changed(changes);
+}
+
+static char* copy_string(const std::string& str)
+{
+    char* copy = static_cast<char*>(std::malloc(str.size() + 1));
+    if (copy == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    std::memcpy(copy, str.c_str(), str.size() + 1);
+    return copy;
+}
+
+/*
+ * C interface
+ */
+
+AnnoStatus anno_open(const char* anno_dir, const char* user_dir, AnnoHandle** handle_out)
+{
+    if (anno_dir == nullptr || handle_out == nullptr)
+    {
+        return fail(ANNO_INVALID_ARGUMENT, "Missing argument");
+    }
+    *handle_out = nullptr;
+
+    return call_safely([&]() {
+        Config cfg;
+        cfg.anno_dir = FileUtils::path_from_utf8(anno_dir);
+
+        const auto version = detect_game_version(cfg.anno_dir);
+        if (!version.has_value())
+        {
+            return fail(ANNO_ERROR, "Invalid Anno directory: " + std::string(anno_dir));
+        }
+        cfg.version = *version;
+        cfg.user_dir = user_dir != nullptr ? FileUtils::path_from_utf8(user_dir)
+                                           : get_default_user_dir(cfg.anno_dir, cfg.version);
+
+        *handle_out = new AnnoHandle(cfg);
+        return ANNO_OK;
+    });
+}
+
+void anno_close(AnnoHandle* handle)
+{
+    Log::Capture capture;
+    delete handle;
+}
+
+const char* anno_last_error(void)
+{
+    return last_error.c_str();
+}
+
+AnnoStatus anno_list_campaigns(AnnoHandle* handle, char** json_out)
+{
+    if (handle == nullptr || json_out == nullptr)
+    {
+        return fail(ANNO_INVALID_ARGUMENT, "Missing argument");
+    }
+    *json_out = nullptr;
+
+    return call_safely([&]() {
+        refresh_if_changed(handle);
+        std::shared_lock lock(handle->mutex);
+        *json_out = copy_string(Server::describe_campaigns(handle->tool.list_campaigns()).to_string());
+        return ANNO_OK;
+    });
+}
+
+AnnoStatus anno_install_campaign(
+        AnnoHandle* handle, const char* name, const char* const* level_names, size_t num_levels)
+{
+    if (handle == nullptr || name == nullptr || (level_names == nullptr && num_levels > 0))
+    {
+        return fail(ANNO_INVALID_ARGUMENT, "Missing argument");
+    }
+
+    return call_safely([&]() {
+        Campaign campaign;
+        campaign.name = TextEncoding::utf8_to_windows1252(name);
+        for (size_t i = 0; i < num_levels; ++i)
+        {
+            if (level_names[i] == nullptr)
+            {
+                return fail(ANNO_INVALID_ARGUMENT, "Missing level name");
+            }
+            campaign.level_names.push_back(TextEncoding::utf8_to_windows1252(level_names[i]));
+        }
+
+        refresh_if_changed(handle);
+        std::unique_lock lock(handle->mutex);
+        if (!handle->tool.install_campaign(campaign))
+        {
+            return fail(ANNO_ERROR, "Failed to install campaign: " + std::string(name));
+        }
+        return ANNO_OK;
+    });
+}
+
+AnnoStatus anno_get_progress(AnnoHandle* handle, int campaign_index, int* progress_out)
+{
+    if (handle == nullptr || progress_out == nullptr)
+    {
+        return fail(ANNO_INVALID_ARGUMENT, "Missing argument");
+    }
+    if (campaign_index > max_campaign_index)
+    {
+        return fail(ANNO_INVALID_ARGUMENT, "Invalid campaign index: " + std::to_string(campaign_index));
+    }
+
+    return call_safely([&]() {
+        refresh_if_changed(handle);
+        std::shared_lock lock(handle->mutex);
+        *progress_out = campaign_index < 0 ? handle->tool.get_main_game_progress()
+                                           : handle->tool.get_campaign_progress(campaign_index);
+        return ANNO_OK;
+    });
+}
+
+AnnoStatus anno_set_progress(AnnoHandle* handle, int campaign_index, int progress)
+{
+    if (handle == nullptr)
+    {
+        return fail(ANNO_INVALID_ARGUMENT, "Missing argument");
+    }
+
+    return call_safely([&]() {
+        refresh_if_changed(handle);
+        std::unique_lock lock(handle->mutex);
+        if (campaign_index < 0)
+        {
+            handle->tool.set_main_game_progress(progress);
+        }
+        else
+        {
+            handle->tool.set_campaign_progress(campaign_index, progress);
+        }
+
+        // The caller is told that nothing changed if saving fails, so the handle must agree
+        try
+        {
+            handle->tool.save_player_data();
+        }
+        catch (const std::exception&)
+        {
+            handle->tool.discard_player_data_changes();
+            throw;
+        }
+        return ANNO_OK;
+    });
+}
+
+void anno_free(char* str)
+{
+    std::free(str);
+}
@@ -0,0 +1,65 @@
+#include "files/chunk_index.h"
+
+#include <cstdint>
+#include <cstring>  // memcpy
+#include <stdexcept>
+#include <string>
+
+namespace Anno {
+
+ChunkIndex::ChunkIndex(std::span<const char> data)
+    : data(data)
+{
+    size_t pos = 0;
+    while (pos < data.size())
+    {
+        if (data.size() - pos < chunk_header_size)
+        {
+            throw std::runtime_error("Truncated chunk header at offset " + std::to_string(pos));
+        }
+
+        // Read the name, excluding any null padding
+        std::string_view name(data.data() + pos, chunk_name_size);
+        name = name.substr(0, name.find('\0'));
+
+        // Read the payload length (stored as little-endian)
+        std::int32_t length = 0;
+        std::memcpy(&length, data.data() + pos + chunk_name_size, sizeof(std::int32_t));
+
+        const size_t payload_offset = pos + chunk_header_size;
+        if (length < 0 || static_cast<size_t>(length) > data.size() - payload_offset)
+        {
+            throw std::runtime_error("Chunk " + std::string(name) + " extends beyond the end of the file");
+        }
+
+        chunks.push_back({ name, payload_offset, static_cast<size_t>(length) });
+        pos = payload_offset + static_cast<size_t>(length);
+    }
+}
+
+const ChunkIndex::Chunk* ChunkIndex::find_chunk(std::string_view name) const
+{
+    for (const auto& chunk : chunks)
+    {
+        if (chunk.name == name)
+        {
+            return &chunk;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<const ChunkIndex::Chunk*> ChunkIndex::find_all_chunks(std::string_view name) const
+{
+    std::vector<const Chunk*> matches;
+    for (const auto& chunk : chunks)
+    {
+        if (chunk.name == name)
+        {
+            matches.push_back(&chunk);
+        }
+    }
+    return matches;
+}
+
+}  // namespace Anno
@@ -0,0 +1,249 @@
+#include "files/cod_codec.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>  // memcpy
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ANNO_COD_CODEC_X86
+#endif
+
+#ifdef ANNO_COD_CODEC_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+// Allows individual functions to use instructions beyond the baseline that we are compiling for.
+// MSVC does not need this, as it allows any intrinsics to be used anywhere.
+#if defined(__GNUC__) || defined(__clang__)
+#define ANNO_TARGET(isa) __attribute__((target(isa)))
+#else
+#define ANNO_TARGET(isa)
+#endif
+
+namespace Anno { namespace CodCodec {
+
+using TransformFunc = void (*)(const char* src, char* dst, size_t size);
+
+/*
+ * Kernels
+ */
+
+static void transform_bytes(const char* src, char* dst, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        dst[i] = static_cast<char>(-static_cast<unsigned char>(src[i]));
+    }
+}
+
+// Portable fallback which negates 8 bytes at a time within a 64-bit integer ("SWAR").
+// For each byte this computes `0 - b`, without letting borrows cross into the neighbouring byte.
+static void transform_scalar(const char* src, char* dst, size_t size)
+{
+    constexpr std::uint64_t high_bits = 0x8080808080808080ull;
+
+    size_t i = 0;
+    for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t))
+    {
+        std::uint64_t word = 0;
+        std::memcpy(&word, src + i, sizeof(word));
+        word = (high_bits - (word & ~high_bits)) ^ (~word & high_bits);
+        std::memcpy(dst + i, &word, sizeof(word));
+    }
+
+    // Handle any leftover bytes
+    transform_bytes(src + i, dst + i, size - i);
+}
+
+#ifdef ANNO_COD_CODEC_X86
+
+ANNO_TARGET("sse2")
+static void transform_sse2(const char* src, char* dst, size_t size)
+{
+    constexpr size_t block_size = sizeof(__m128i);
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + block_size <= size; i += block_size)
+    {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_sub_epi8(zero, block));
+    }
+
+    // Handle any leftover bytes
+    transform_bytes(src + i, dst + i, size - i);
+}
+
+ANNO_TARGET("avx2")
+static void transform_avx2(const char* src, char* dst, size_t size)
+{
+    constexpr size_t block_size = sizeof(__m256i);
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t i = 0;
+
+    // Process 2 blocks per iteration to hide some of the load latency
+    for (; i + 2 * block_size <= size; i += 2 * block_size)
+    {
+        const __m256i block_a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        const __m256i block_b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + block_size));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_sub_epi8(zero, block_a));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + block_size), _mm256_sub_epi8(zero, block_b));
+    }
+    for (; i + block_size <= size; i += block_size)
+    {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_sub_epi8(zero, block));
+    }
+
+    // Handle any leftover bytes
+    transform_bytes(src + i, dst + i, size - i);
+}
+
+#endif  // ANNO_COD_CODEC_X86
+
+/*
+ * CPU detection
+ */
+
+static bool cpu_supports_sse2()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    // Always present on x86-64
+    return true;
+#elif defined(ANNO_COD_CODEC_X86) && defined(_MSC_VER)
+    int info[4] {};
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#elif defined(ANNO_COD_CODEC_X86)
+    return __builtin_cpu_supports("sse2");
+#else
+    return false;
+#endif
+}
+
+static bool cpu_supports_avx2()
+{
+#if defined(ANNO_COD_CODEC_X86) && defined(_MSC_VER)
+    int info[4] {};
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+
+    // Check that the CPU supports AVX and that the OS saves the YMM registers
+    __cpuid(info, 1);
+    const bool has_osxsave = (info[2] & (1 << 27)) != 0;
+    const bool has_avx = (info[2] & (1 << 28)) != 0;
+    if (!has_osxsave || !has_avx || (_xgetbv(0) & 0x6) != 0x6)
+    {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(ANNO_COD_CODEC_X86)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+static TransformFunc get_kernel_func(Kernel kernel)
+{
+    switch (kernel)
+    {
+#ifdef ANNO_COD_CODEC_X86
+    case Kernel::SSE2:
+        return transform_sse2;
+    case Kernel::AVX2:
+        return transform_avx2;
+#endif
+    default:
+        return transform_scalar;
+    }
+}
+
+static Kernel select_kernel()
+{
+    if (cpu_supports_avx2())
+    {
+        return Kernel::AVX2;
+    }
+    if (cpu_supports_sse2())
+    {
+        return Kernel::SSE2;
+    }
+    return Kernel::Scalar;
+}
+
+/*
+ * Public API
+ */
+
+Kernel get_active_kernel()
+{
+    // Selected once, on first use
+    static const Kernel active_kernel = select_kernel();
+    return active_kernel;
+}
+
+bool is_kernel_supported(Kernel kernel)
+{
+    switch (kernel)
+    {
+    case Kernel::Scalar:
+        return true;
+    case Kernel::SSE2:
+        return cpu_supports_sse2();
+    case Kernel::AVX2:
+        return cpu_supports_avx2();
+    }
+    return false;
+}
+
+std::string_view get_kernel_name(Kernel kernel)
+{
+    switch (kernel)
+    {
+    case Kernel::Scalar:
+        return "Scalar";
+    case Kernel::SSE2:
+        return "SSE2";
+    case Kernel::AVX2:
+        return "AVX2";
+    }
+    return "Unknown";
+}
+
+void transform_with_kernel(Kernel kernel, std::span<const char> src, std::span<char> dst)
+{
+    assert(dst.size() >= src.size());
+    get_kernel_func(kernel)(src.data(), dst.data(), src.size());
+}
+
+void transform(std::span<const char> src, std::span<char> dst)
+{
+    static const TransformFunc active_func = get_kernel_func(get_active_kernel());
+
+    assert(dst.size() >= src.size());
+    active_func(src.data(), dst.data(), src.size());
+}
+
+void transform_in_place(std::span<char> data)
+{
+    transform(data, data);
+}
+
+std::vector<char> transform(std::span<const char> src)
+{
+    std::vector<char> dst(src.size());
+    transform(src, dst);
+    return dst;
+}
+
+}}  // namespace Anno::CodCodec
@@ -0,0 +1,438 @@
+#include "files/file_transaction.h"
+
+#include <algorithm>  // find
+#include <charconv>
+#include <ios>
+#include <map>
+#include <string_view>
+#include <system_error>
+#include <utility>  // move
+
+#include "files/file_utils.h"
+#include "util/log.h"
+#include "util/parallel_utils.h"
+#include "util/trace.h"
+
+namespace Anno {
+
+/*
+ * Helper methods
+ */
+
+static std::string to_hex(std::span<const char> data)
+{
+    static constexpr std::string_view digits = "0123456789abcdef";
+
+    std::string hex;
+    hex.reserve(data.size() * 2);
+    for (char c : data)
+    {
+        const auto byte = static_cast<unsigned char>(c);
+        hex.push_back(digits[byte >> 4]);
+        hex.push_back(digits[byte & 0x0f]);
+    }
+    return hex;
+}
+
+static bool from_hex(std::string_view hex, std::vector<char>& data)
+{
+    if (hex.length() % 2 != 0)
+    {
+        return false;
+    }
+
+    data.clear();
+    data.reserve(hex.length() / 2);
+    for (size_t i = 0; i < hex.length(); i += 2)
+    {
+        unsigned int byte = 0;
+        const auto result = std::from_chars(hex.data() + i, hex.data() + i + 2, byte, 16);
+        if (result.ec != std::errc() || result.ptr != hex.data() + i + 2)
+        {
+            return false;
+        }
+        data.push_back(static_cast<char>(byte));
+    }
+    return true;
+}
+
+// Escapes a path so that it can't be mistaken for a field or line separator
+static std::string escape_path(const std::filesystem::path& path)
+{
+    const std::string text = FileUtils::path_to_utf8(path);
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text)
+    {
+        switch (c)
+        {
+        case '\\':
+            escaped += "\\\\";
+            break;
+        case '\t':
+            escaped += "\\t";
+            break;
+        case '\n':
+            escaped += "\\n";
+            break;
+        case '\r':
+            escaped += "\\r";
+            break;
+        default:
+            escaped.push_back(c);
+            break;
+        }
+    }
+    return escaped;
+}
+
+static bool unescape_path(std::string_view escaped, std::filesystem::path& path)
+{
+    std::string text;
+    text.reserve(escaped.size());
+    for (size_t i = 0; i < escaped.size(); ++i)
+    {
+        if (escaped[i] != '\\')
+        {
+            text.push_back(escaped[i]);
+            continue;
+        }
+
+        if (++i == escaped.size())
+        {
+            return false;
+        }
+        switch (escaped[i])
+        {
+        case '\\':
+            text.push_back('\\');
+            break;
+        case 't':
+            text.push_back('\t');
+            break;
+        case 'n':
+            text.push_back('\n');
+            break;
+        case 'r':
+            text.push_back('\r');
+            break;
+        default:
+            return false;
+        }
+    }
+    path = FileUtils::path_from_utf8(text);
+    return true;
+}
+
+static std::vector<std::string_view> split_fields(std::string_view line)
+{
+    std::vector<std::string_view> fields;
+    size_t start = 0;
+    while (true)
+    {
+        const size_t end = line.find('\t', start);
+        fields.push_back(line.substr(start, end - start));
+        if (end == std::string_view::npos)
+        {
+            return fields;
+        }
+        start = end + 1;
+    }
+}
+
+/*
+ * FileTransaction class
+ */
+
+FileTransaction::FileTransaction(const std::filesystem::path& journal_path, unsigned num_jobs)
+    : journal_path(journal_path)
+    , num_jobs(num_jobs)
+    , journal_lock(make_lock_path(journal_path))
+{
+    // A journal left behind by an earlier transaction may be the only record of committed changes, so it must be
+    // dealt with before we can start a new one
+    recover_locked(journal_path);
+
+    journal_stream.open(journal_path, std::ios::binary | std::ios::trunc);
+    if (!journal_stream)
+    {
+        throw std::ios_base::failure("Failed to create journal: " + journal_path.string());
+    }
+    write_journal_line(journal_header);
+}
+
+FileTransaction::~FileTransaction()
+{
+    if (is_committed)
+    {
+        return;
+    }
+
+    // Roll back anything that was staged
+    try
+    {
+        journal_stream.close();
+        discard(replacements, journal_path);
+    }
+    catch (const std::exception& e)
+    {
+        Log::err() << "Failed to clean up after incomplete transaction: " << e.what() << '\n';
+    }
+}
+
+void FileTransaction::stage_file(const std::filesystem::path& target, std::span<const char> data)
+{
+    const std::filesystem::path staged_path = add_replacement(target);
+    FileUtils::write_binary_file(staged_path, data);
+}
+
+void FileTransaction::stage_file_with_prefix(const std::filesystem::path& target,
+        std::uint64_t num_bytes_to_skip,
+        std::span<const char> prefix)
+{
+    const std::filesystem::path staged_path = add_replacement(target);
+    FileUtils::copy_binary_file_with_prefix(target, staged_path, num_bytes_to_skip, prefix);
+}
+
+void FileTransaction::stage_patch(const std::filesystem::path& target, std::uint64_t offset, std::span<const char> data)
+{
+    std::scoped_lock lock(mutex);
+    write_journal_line("patch\t" + escape_path(target) + '\t' + std::to_string(offset) + '\t' + to_hex(data));
+    patches.push_back({ target, offset, std::vector<char>(data.begin(), data.end()) });
+}
+
+void FileTransaction::on_commit(std::function<void()> callback)
+{
+    std::scoped_lock lock(mutex);
+    commit_callbacks.push_back(std::move(callback));
+}
+
+void FileTransaction::commit()
+{
+    if (is_committed)
+    {
+        return;
+    }
+
+    Trace::Span span("io", "FileTransaction::commit");
+
+    // Make sure all staged data has reached the disk, in one batch, before we commit to using it
+    std::vector<std::filesystem::path> paths_to_sync;
+    paths_to_sync.reserve(replacements.size() + 1);
+    for (const auto& replacement : replacements)
+    {
+        paths_to_sync.push_back(replacement.staged_path);
+    }
+    paths_to_sync.push_back(journal_path);
+    FileUtils::sync_files(paths_to_sync);
+
+    // Write the commit marker. From this point on, the changes will be completed by `recover` if we are interrupted.
+    write_journal_line(commit_marker);
+    journal_stream.close();
+    FileUtils::sync_files({ journal_path });
+    FileUtils::sync_directory(journal_path.has_parent_path() ? journal_path.parent_path() : ".");
+    is_committed = true;
+
+    apply(replacements, patches, num_jobs);
+
+    // Now the journal is no longer needed
+    std::filesystem::remove(journal_path);
+
+    for (const auto& callback : commit_callbacks)
+    {
+        callback();
+    }
+}
+
+bool FileTransaction::recover(const std::filesystem::path& journal_path)
+{
+    // Usually there is nothing to recover, in which case we don't need the lock (which may not even be possible to
+    // create, e.g. if the game directory is read-only)
+    if (!std::filesystem::exists(journal_path))
+    {
+        return false;
+    }
+
+    // Another process may be part-way through a transaction using this journal, so check again once it's done
+    const FileUtils::FileLock lock(make_lock_path(journal_path));
+    return recover_locked(journal_path);
+}
+
+bool FileTransaction::recover_locked(const std::filesystem::path& journal_path)
+{
+    if (!std::filesystem::exists(journal_path))
+    {
+        return false;
+    }
+
+    const std::vector<char> journal_data = FileUtils::read_binary_file(journal_path);
+    const std::vector<std::string_view> lines = FileUtils::split_lines(journal_data);
+
+    std::vector<Replacement> replacements;
+    std::vector<Patch> patches;
+    bool has_commit_marker = false;
+
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        const std::string_view line = lines[i];
+        if (i == 0)
+        {
+            if (line != journal_header)
+            {
+                throw std::ios_base::failure("Unrecognised journal: " + journal_path.string());
+            }
+            continue;
+        }
+
+        if (line == commit_marker)
+        {
+            has_commit_marker = true;
+            break;
+        }
+
+        // Anything after the last complete entry may have been cut short by a crash; this is fine, as long as the
+        // commit marker was never written
+        const std::vector<std::string_view> fields = split_fields(line);
+        if (fields[0] == "replace" && fields.size() == 3)
+        {
+            Replacement replacement;
+            if (unescape_path(fields[1], replacement.target) && unescape_path(fields[2], replacement.staged_path))
+            {
+                replacements.push_back(std::move(replacement));
+            }
+        }
+        else if (fields[0] == "patch" && fields.size() == 4)
+        {
+            Patch patch;
+            const auto result =
+                    std::from_chars(fields[2].data(), fields[2].data() + fields[2].size(), patch.offset);
+            if (unescape_path(fields[1], patch.target) && result.ec == std::errc() && from_hex(fields[3], patch.data))
+            {
+                patches.push_back(std::move(patch));
+            }
+        }
+    }
+
+    if (has_commit_marker)
+    {
+        // Finish the job. Every step here is safe to repeat, in case we are interrupted again.
+        Log::out() << "Completing interrupted changes...\n";
+        apply(replacements, patches, 1);
+        std::filesystem::remove(journal_path);
+    }
+    else
+    {
+        Log::out() << "Discarding incomplete changes...\n";
+        discard(replacements, journal_path);
+    }
+
+    return true;
+}
+
+std::filesystem::path FileTransaction::make_lock_path(const std::filesystem::path& journal_path)
+{
+    std::filesystem::path lock_path = journal_path;
+    lock_path += ".lock";
+    return lock_path;
+}
+
+std::filesystem::path FileTransaction::make_staged_path(const std::filesystem::path& target)
+{
+    // Unique per call, so that a staged file can never be confused with one left behind by someone else
+    std::filesystem::path staged_path = FileUtils::make_temp_path(target);
+    staged_path += ".anno-new";
+    return staged_path;
+}
+
+void FileTransaction::apply(const std::vector<Replacement>& replacements,
+        const std::vector<Patch>& patches,
+        unsigned num_jobs)
+{
+    for (const auto& replacement : replacements)
+    {
+        // If the staged file is missing, this replacement was already made before we were interrupted
+        if (std::filesystem::exists(replacement.staged_path))
+        {
+            std::filesystem::rename(replacement.staged_path, replacement.target);
+        }
+    }
+
+    // Group the patches by file, so that different files can be patched in parallel while the patches to any one
+    // file are still applied in order
+    std::map<std::filesystem::path, std::vector<const Patch*>> patches_by_path;
+    for (const auto& patch : patches)
+    {
+        patches_by_path[patch.target].push_back(&patch);
+    }
+
+    std::vector<std::filesystem::path> patched_paths;
+    std::vector<const std::vector<const Patch*>*> patch_groups;
+    patched_paths.reserve(patches_by_path.size());
+    patch_groups.reserve(patches_by_path.size());
+    for (const auto& [path, file_patches] : patches_by_path)
+    {
+        patched_paths.push_back(path);
+        patch_groups.push_back(&file_patches);
+    }
+
+    ParallelUtils::parallel_for(patch_groups.size(), num_jobs, [&](size_t i) {
+        for (const Patch* patch : *patch_groups[i])
+        {
+            FileUtils::write_binary_file_at(patch->target, patch->offset, patch->data);
+        }
+    });
+
+    // Make everything durable before the journal is removed
+    FileUtils::sync_files(patched_paths);
+    sync_parent_directories(replacements);
+}
+
+void FileTransaction::sync_parent_directories(const std::vector<Replacement>& replacements)
+{
+    std::vector<std::filesystem::path> directories;
+    for (const auto& replacement : replacements)
+    {
+        std::filesystem::path directory = replacement.target.parent_path();
+        if (directory.empty())
+        {
+            directory = ".";
+        }
+        if (std::find(directories.begin(), directories.end(), directory) == directories.end())
+        {
+            FileUtils::sync_directory(directory);
+            directories.push_back(std::move(directory));
+        }
+    }
+}
+
+void FileTransaction::discard(const std::vector<Replacement>& replacements,
+        const std::filesystem::path& journal_path)
+{
+    std::error_code ec;
+    for (const auto& replacement : replacements)
+    {
+        std::filesystem::remove(replacement.staged_path, ec);
+    }
+    std::filesystem::remove(journal_path, ec);
+}
+
+void FileTransaction::write_journal_line(const std::string& line)
+{
+    journal_stream << line << '\n';
+    if (!journal_stream.flush())
+    {
+        throw std::ios_base::failure("Error writing journal: " + journal_path.string());
+    }
+}
+
+std::filesystem::path FileTransaction::add_replacement(const std::filesystem::path& target)
+{
+    // Record our intent before creating the staged file, so that it can always be cleaned up
+    const std::filesystem::path staged_path = make_staged_path(target);
+    std::scoped_lock lock(mutex);
+    write_journal_line("replace\t" + escape_path(target) + '\t' + escape_path(staged_path));
+    replacements.push_back({ target, staged_path });
+    return staged_path;
+}
+
+}  // namespace Anno
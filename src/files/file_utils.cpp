@@ -1,16 +1,100 @@
 #include "files/file_utils.h"
 
+#include <algorithm>  // find
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <fstream>
+#include <mutex>
 #include <stdexcept>
+#include <utility>  // exchange, move
+
+#include "util/trace.h"
 
 #ifdef _WIN32
 #include <windows.h>
 
 #include <shlobj.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 namespace Anno { namespace FileUtils {
 
+// Size of the buffer used when streaming one file into another
+static constexpr size_t copy_buffer_size = 64 * 1024;
+
+static std::mutex open_files_mutex;
+static std::condition_variable open_files_changed;
+static unsigned max_open_files = 0;
+static unsigned num_open_files = 0;
+
+namespace {
+
+// Reserves room for some files to be opened, subject to the limit set by `set_max_open_files`
+class OpenFileSlots
+{
+public:
+    explicit OpenFileSlots(unsigned num_files = 1)
+        : num_files(num_files)
+    {
+        std::unique_lock lock(open_files_mutex);
+
+        // A request larger than the limit could never be satisfied, so let it through on its own
+        open_files_changed.wait(lock, [&]() {
+            return max_open_files == 0 || num_open_files == 0 || num_open_files + num_files <= max_open_files;
+        });
+        num_open_files += num_files;
+    }
+
+    ~OpenFileSlots()
+    {
+        {
+            std::scoped_lock lock(open_files_mutex);
+            num_open_files -= num_files;
+        }
+        open_files_changed.notify_all();
+    }
+
+    OpenFileSlots(const OpenFileSlots&) = delete;
+    OpenFileSlots& operator=(const OpenFileSlots&) = delete;
+
+private:
+    unsigned num_files;
+};
+
+}  // namespace
+
+std::filesystem::path make_temp_path(const std::filesystem::path& path)
+{
+    // Several processes (or threads) may be replacing the same file at once, so each needs its own temporary file
+    static std::atomic<std::uint64_t> next_temp_index = 0;
+#ifdef _WIN32
+    const auto process_id = static_cast<std::uint64_t>(GetCurrentProcessId());
+#else
+    const auto process_id = static_cast<std::uint64_t>(getpid());
+#endif
+
+    // Keep the temporary file in the same directory so that it can be renamed over the original
+    std::filesystem::path temp_path = path;
+    temp_path += "." + std::to_string(process_id) + "." + std::to_string(next_temp_index++) + ".tmp";
+    return temp_path;
+}
+
+void set_max_open_files(unsigned new_max_open_files)
+{
+    {
+        std::scoped_lock lock(open_files_mutex);
+        max_open_files = new_max_open_files;
+    }
+    open_files_changed.notify_all();
+}
+
 std::filesystem::path get_documents_folder()
 {
 #ifdef _WIN32
@@ -34,9 +118,241 @@ std::filesystem::path get_documents_folder()
 #endif
 }
 
+/*
+ * MappedFile class
+ */
+
+MappedFile::MappedFile(const std::filesystem::path& path, AccessHint hint)
+{
+    Trace::Span span("io", "FileUtils::map_file");
+    span.set_path(path);
+
+    if (!try_map(path, hint))
+    {
+        // Fall back to reading the file into memory
+        fallback_buffer = read_binary_file(path);
+        data = fallback_buffer.data();
+        size = fallback_buffer.size();
+    }
+    span.set_bytes(size);
+}
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        unmap();
+
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+        mapping = std::exchange(other.mapping, nullptr);
+#ifdef _WIN32
+        mapping_handle = std::exchange(other.mapping_handle, nullptr);
+#endif
+        // Moving a vector keeps its storage, so `data` remains valid
+        fallback_buffer = std::move(other.fallback_buffer);
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::try_map(const std::filesystem::path& path, AccessHint hint)
+{
+    const OpenFileSlots slots;
+    const DWORD flags = (hint == AccessHint::Sequential) ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+    HANDLE file_handle = CreateFileW(path.c_str(),
+            GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            NULL,
+            OPEN_EXISTING,
+            flags,
+            NULL);
+    if (file_handle == INVALID_HANDLE_VALUE)
+    {
+        throw std::ios_base::failure("Failed to open file for reading: " + path.string());
+    }
+
+    LARGE_INTEGER file_size {};
+    if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0)
+    {
+        // Empty files cannot be mapped
+        CloseHandle(file_handle);
+        return false;
+    }
+
+    // The mapping keeps the file open, so we don't need to hold onto the file handle
+    HANDLE new_mapping_handle = CreateFileMappingW(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file_handle);
+    if (new_mapping_handle == NULL)
+    {
+        return false;
+    }
+
+    void* view = MapViewOfFile(new_mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL)
+    {
+        CloseHandle(new_mapping_handle);
+        return false;
+    }
+
+    mapping = view;
+    mapping_handle = new_mapping_handle;
+    data = static_cast<const char*>(view);
+    size = static_cast<size_t>(file_size.QuadPart);
+    return true;
+}
+
+void MappedFile::unmap()
+{
+    if (mapping)
+    {
+        UnmapViewOfFile(mapping);
+        CloseHandle(mapping_handle);
+        mapping = nullptr;
+        mapping_handle = nullptr;
+    }
+}
+
+#else
+
+bool MappedFile::try_map(const std::filesystem::path& path, AccessHint hint)
+{
+    const OpenFileSlots slots;
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::ios_base::failure("Failed to open file for reading: " + path.string());
+    }
+
+    struct stat file_stat {};
+    if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) || file_stat.st_size == 0)
+    {
+        // Empty files cannot be mapped
+        close(fd);
+        return false;
+    }
+
+    const size_t file_size = static_cast<size_t>(file_stat.st_size);
+    const int advice = (hint == AccessHint::Sequential) ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_RANDOM;
+    posix_fadvise(fd, 0, 0, advice);
+
+    // The mapping keeps the file open, so we don't need to hold onto the file descriptor
+    void* view = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+    {
+        return false;
+    }
+
+    madvise(view, file_size, (hint == AccessHint::Sequential) ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+    mapping = view;
+    data = static_cast<const char*>(view);
+    size = file_size;
+    return true;
+}
+
+void MappedFile::unmap()
+{
+    if (mapping)
+    {
+        munmap(mapping, size);
+        mapping = nullptr;
+    }
+}
+
+#endif
+
+/*
+ * FileLock class
+ */
+
+#ifdef _WIN32
+
+FileLock::FileLock(const std::filesystem::path& path)
+{
+    // Locks are held for a long time, so they don't count towards the limit on open files
+    HANDLE handle = CreateFileW(path.c_str(),
+            GENERIC_READ | GENERIC_WRITE,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            NULL,
+            OPEN_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL,
+            NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        throw std::ios_base::failure("Failed to open lock file: " + path.string());
+    }
+
+    OVERLAPPED overlapped {};
+    if (!LockFileEx(handle, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped))
+    {
+        CloseHandle(handle);
+        throw std::ios_base::failure("Failed to lock file: " + path.string());
+    }
+    file_handle = handle;
+}
+
+FileLock::~FileLock()
+{
+    // Closing the handle releases the lock
+    CloseHandle(file_handle);
+}
+
+#else
+
+FileLock::FileLock(const std::filesystem::path& path)
+{
+    // Locks are held for a long time, so they don't count towards the limit on open files
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        throw std::ios_base::failure("Failed to open lock file: " + path.string());
+    }
+
+    // `flock` locks belong to the open file description, so this also excludes other FileLocks in this process
+    int result = 0;
+    do
+    {
+        result = flock(fd, LOCK_EX);
+    } while (result != 0 && errno == EINTR);
+    if (result != 0)
+    {
+        close(fd);
+        throw std::ios_base::failure("Failed to lock file: " + path.string());
+    }
+}
+
+FileLock::~FileLock()
+{
+    // Closing the file releases the lock
+    close(fd);
+}
+
+#endif
+
+/*
+ * Free functions
+ */
+
 std::vector<char> read_binary_file(const std::filesystem::path& path)
 {
+    Trace::Span span("io", "FileUtils::read_binary_file");
+    span.set_path(path);
+
     // Try to open the file
+    const OpenFileSlots slots;
     std::ifstream file_stream(path, std::ios::binary);
     if (!file_stream)
     {
@@ -49,6 +365,7 @@ std::vector<char> read_binary_file(const std::filesystem::path& path)
 
     // Read the file fully
     file_stream.read(buffer.data(), file_size);
+    span.set_bytes(file_size);
 
     // Check for errors
     if (file_stream.bad())
@@ -59,9 +376,41 @@ std::vector<char> read_binary_file(const std::filesystem::path& path)
     return buffer;
 }
 
+std::vector<char> read_binary_file_prefix(const std::filesystem::path& path, size_t max_bytes)
+{
+    Trace::Span span("io", "FileUtils::read_binary_file_prefix");
+    span.set_path(path);
+
+    // Try to open the file
+    const OpenFileSlots slots;
+    std::ifstream file_stream(path, std::ios::binary);
+    if (!file_stream)
+    {
+        throw std::ios_base::failure("Failed to open file for reading: " + path.string());
+    }
+
+    // Read up to `max_bytes`; a short read just means the file is smaller than requested
+    std::vector<char> buffer(max_bytes);
+    file_stream.read(buffer.data(), max_bytes);
+
+    // Check for errors
+    if (file_stream.bad())
+    {
+        throw std::ios_base::failure("Error reading file: " + path.string());
+    }
+
+    buffer.resize(static_cast<size_t>(file_stream.gcount()));
+    span.set_bytes(buffer.size());
+    return buffer;
+}
+
 std::vector<std::string> read_text_file(const std::filesystem::path& path)
 {
+    Trace::Span span("io", "FileUtils::read_text_file");
+    span.set_path(path);
+
     // Try to open the file
+    const OpenFileSlots slots;
     std::ifstream file_stream(path, std::ios::binary);
     if (!file_stream)
     {
@@ -74,6 +423,7 @@ std::vector<std::string> read_text_file(const std::filesystem::path& path)
     // Reserve some space based on a rough line count estimate
     const auto file_size = std::filesystem::file_size(path);
     lines.reserve(static_cast<size_t>(file_size / 32));
+    span.set_bytes(file_size);
 
     // Read the file line-by-line
     while (std::getline(file_stream, line))
@@ -96,9 +446,53 @@ std::vector<std::string> read_text_file(const std::filesystem::path& path)
     return lines;
 }
 
-void write_binary_file(const std::filesystem::path& path, const std::vector<char>& data)
+std::vector<std::string_view> split_lines(std::span<const char> data)
 {
+    std::vector<std::string_view> lines;
+    const std::string_view text(data.data(), data.size());
+
+    size_t start = 0;
+    while (start < text.size())
+    {
+        size_t end = text.find('\n', start);
+        if (end == std::string_view::npos)
+        {
+            end = text.size();
+        }
+
+        // Strip out carriage return ('\r') if present
+        std::string_view line = text.substr(start, end - start);
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+
+        lines.push_back(line);
+        start = end + 1;
+    }
+
+    return lines;
+}
+
+std::string path_to_utf8(const std::filesystem::path& path)
+{
+    const std::u8string utf8 = path.u8string();
+    return std::string(utf8.begin(), utf8.end());
+}
+
+std::filesystem::path path_from_utf8(std::string_view text)
+{
+    return std::filesystem::path(std::u8string(text.begin(), text.end()));
+}
+
+void write_binary_file(const std::filesystem::path& path, std::span<const char> data)
+{
+    Trace::Span span("io", "FileUtils::write_binary_file");
+    span.set_path(path);
+    span.set_bytes(data.size());
+
     // Try to open the file
+    const OpenFileSlots slots;
     std::ofstream file_stream(path, std::ios::binary);
     if (!file_stream)
     {
@@ -115,9 +509,141 @@ void write_binary_file(const std::filesystem::path& path, const std::vector<char
     }
 }
 
+void write_binary_file_at(const std::filesystem::path& path, std::uint64_t offset, std::span<const char> data)
+{
+    Trace::Span span("io", "FileUtils::write_binary_file_at");
+    span.set_path(path);
+    span.set_bytes(data.size());
+
+    // Try to open the existing file without truncating it
+    const OpenFileSlots slots;
+    std::fstream file_stream(path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file_stream)
+    {
+        throw std::ios_base::failure("Failed to open file for writing: " + path.string());
+    }
+
+    // Write the data at the requested position
+    file_stream.seekp(static_cast<std::streamoff>(offset));
+    file_stream.write(data.data(), data.size());
+
+    // Check for errors
+    if (!file_stream)
+    {
+        throw std::ios_base::failure("Error writing file: " + path.string());
+    }
+}
+
+void copy_binary_file_with_prefix(const std::filesystem::path& src_path,
+        const std::filesystem::path& dst_path,
+        std::uint64_t num_bytes_to_skip,
+        std::span<const char> prefix)
+{
+    Trace::Span span("io", "FileUtils::copy_binary_file_with_prefix");
+    span.set_path(dst_path);
+
+    // Try to open both files
+    const OpenFileSlots slots(2);
+    std::ifstream src_stream(src_path, std::ios::binary);
+    if (!src_stream)
+    {
+        throw std::ios_base::failure("Failed to open file for reading: " + src_path.string());
+    }
+    std::ofstream dst_stream(dst_path, std::ios::binary);
+    if (!dst_stream)
+    {
+        throw std::ios_base::failure("Failed to open file for writing: " + dst_path.string());
+    }
+
+    // Write the new prefix, then stream the rest of the source file after it
+    dst_stream.write(prefix.data(), prefix.size());
+    src_stream.seekg(static_cast<std::streamoff>(num_bytes_to_skip));
+
+    std::array<char, copy_buffer_size> buffer;
+    std::uint64_t num_bytes_written = prefix.size();
+    while (src_stream.read(buffer.data(), buffer.size()) || src_stream.gcount() > 0)
+    {
+        dst_stream.write(buffer.data(), src_stream.gcount());
+        num_bytes_written += static_cast<std::uint64_t>(src_stream.gcount());
+    }
+    span.set_bytes(num_bytes_written);
+
+    // Check for errors
+    if (src_stream.bad())
+    {
+        throw std::ios_base::failure("Error reading file: " + src_path.string());
+    }
+    if (!dst_stream.flush())
+    {
+        throw std::ios_base::failure("Error writing file: " + dst_path.string());
+    }
+}
+
+void write_binary_file_with_prefix(const std::filesystem::path& src_path,
+        const std::filesystem::path& dst_path,
+        std::uint64_t num_bytes_to_skip,
+        std::span<const char> prefix)
+{
+    const std::filesystem::path temp_path = make_temp_path(dst_path);
+
+    try
+    {
+        copy_binary_file_with_prefix(src_path, temp_path, num_bytes_to_skip, prefix);
+    }
+    catch (const std::ios_base::failure&)
+    {
+        // Don't leave a partially-written file lying around
+        std::error_code ignored;
+        std::filesystem::remove(temp_path, ignored);
+        throw;
+    }
+
+    // Replace the destination file
+    std::error_code error;
+    std::filesystem::rename(temp_path, dst_path, error);
+    if (error)
+    {
+        std::filesystem::remove(temp_path, error);
+        throw std::ios_base::failure("Failed to replace file: " + dst_path.string());
+    }
+}
+
+void replace_binary_file(const std::filesystem::path& path, std::span<const char> data)
+{
+    const std::filesystem::path temp_path = make_temp_path(path);
+
+    try
+    {
+        write_binary_file(temp_path, data);
+
+        // Make sure the data has reached the disk before it takes the place of the old file
+        sync_files({ temp_path });
+    }
+    catch (const std::ios_base::failure&)
+    {
+        // Don't leave a partially-written file lying around
+        std::error_code ignored;
+        std::filesystem::remove(temp_path, ignored);
+        throw;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    if (error)
+    {
+        std::filesystem::remove(temp_path, error);
+        throw std::ios_base::failure("Failed to replace file: " + path.string());
+    }
+}
+
 void write_text_file(const std::filesystem::path& path, const std::string& text)
 {
+    Trace::Span span("io", "FileUtils::write_text_file");
+    span.set_path(path);
+    span.set_bytes(text.size());
+
     // Try to open the file
+    const OpenFileSlots slots;
     std::ofstream file_stream(path, std::ios::binary);
     if (!file_stream)
     {
@@ -136,7 +662,11 @@ void write_text_file(const std::filesystem::path& path, const std::string& text)
 
 void write_text_file(const std::filesystem::path& path, const std::vector<std::string>& lines)
 {
+    Trace::Span span("io", "FileUtils::write_text_file");
+    span.set_path(path);
+
     // Try to open the file
+    const OpenFileSlots slots;
     std::ofstream file_stream(path, std::ios::binary);
     if (!file_stream)
     {
@@ -144,11 +674,14 @@ void write_text_file(const std::filesystem::path& path, const std::vector<std::s
     }
 
     // Write file line-by-line
+    std::uint64_t num_bytes_written = 0;
     for (const auto& line : lines)
     {
         file_stream.write(line.data(), line.size());
         file_stream.put('\n');
+        num_bytes_written += line.size() + 1;
     }
+    span.set_bytes(num_bytes_written);
 
     // Check for write errors
     if (!file_stream)
@@ -157,4 +690,127 @@ void write_text_file(const std::filesystem::path& path, const std::vector<std::s
     }
 }
 
+#ifdef _WIN32
+
+void sync_files(const std::vector<std::filesystem::path>& paths)
+{
+    Trace::Span span("io", "FileUtils::sync_files");
+
+    for (const auto& path : paths)
+    {
+        const OpenFileSlots slots;
+        HANDLE file_handle = CreateFileW(path.c_str(),
+                GENERIC_WRITE,
+                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                NULL,
+                OPEN_EXISTING,
+                FILE_ATTRIBUTE_NORMAL,
+                NULL);
+        if (file_handle == INVALID_HANDLE_VALUE)
+        {
+            throw std::ios_base::failure("Failed to open file for syncing: " + path.string());
+        }
+
+        const bool success = FlushFileBuffers(file_handle);
+        CloseHandle(file_handle);
+        if (!success)
+        {
+            throw std::ios_base::failure("Failed to sync file: " + path.string());
+        }
+    }
+}
+
+void sync_directory(const std::filesystem::path&)
+{
+    // Not required (or possible) on Windows; renames are made durable along with the file metadata
+}
+
+#else
+
+static void sync_fd(int fd, const std::filesystem::path& path, bool whole_filesystem)
+{
+#ifdef __linux__
+    const int result = whole_filesystem ? syncfs(fd) : fsync(fd);
+#else
+    (void) whole_filesystem;
+    const int result = fsync(fd);
+#endif
+    if (result != 0)
+    {
+        throw std::ios_base::failure("Failed to sync file: " + path.string());
+    }
+}
+
+void sync_files(const std::vector<std::filesystem::path>& paths)
+{
+    Trace::Span span("io", "FileUtils::sync_files");
+
+#ifdef __linux__
+    // A single syncfs flushes every file on the same filesystem, which is much cheaper than an fsync per file
+    // when there are many of them
+    constexpr bool use_syncfs = true;
+#else
+    constexpr bool use_syncfs = false;
+#endif
+
+    std::vector<dev_t> synced_devices;
+    for (const auto& path : paths)
+    {
+        const OpenFileSlots slots;
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            throw std::ios_base::failure("Failed to open file for syncing: " + path.string());
+        }
+
+        struct stat file_stat {};
+        const bool has_stat = (fstat(fd, &file_stat) == 0);
+        if (use_syncfs && has_stat
+                && std::find(synced_devices.begin(), synced_devices.end(), file_stat.st_dev) != synced_devices.end())
+        {
+            // Already covered by an earlier syncfs
+            close(fd);
+            continue;
+        }
+
+        try
+        {
+            sync_fd(fd, path, use_syncfs);
+        }
+        catch (const std::ios_base::failure&)
+        {
+            close(fd);
+            throw;
+        }
+        close(fd);
+
+        if (has_stat)
+        {
+            synced_devices.push_back(file_stat.st_dev);
+        }
+    }
+}
+
+void sync_directory(const std::filesystem::path& path)
+{
+    Trace::Span span("io", "FileUtils::sync_directory");
+    span.set_path(path);
+
+    const OpenFileSlots slots;
+    const int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::ios_base::failure("Failed to open directory for syncing: " + path.string());
+    }
+
+    const int result = fsync(fd);
+    close(fd);
+    if (result != 0)
+    {
+        throw std::ios_base::failure("Failed to sync directory: " + path.string());
+    }
+}
+
+#endif
+
 }}  // namespace Anno::FileUtils
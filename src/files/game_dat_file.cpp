@@ -1,18 +1,15 @@
 #include "files/game_dat_file.h"
 
-#include <boost/algorithm/string/regex.hpp>
-#include <boost/algorithm/string/split.hpp>
-#include <boost/algorithm/string/trim.hpp>
-#include <boost/regex.hpp>
-
 #include <algorithm>  // clamp
+#include <array>
+#include <charconv>
 #include <format>
-#include <fstream>
-#include <iostream>
-#include <sstream>
+#include <iterator>  // back_inserter
 #include <stdexcept>
 
 #include "files/file_utils.h"
+#include "util/log.h"
+#include "util/trace.h"
 
 namespace Anno {
 
@@ -20,46 +17,72 @@ namespace Anno {
  * Helper methods
  */
 
-static std::string extract_value(const std::string& line)
+static std::string_view trim(std::string_view text)
 {
-    const auto split_pos = line.find(':');
-    if (split_pos == std::string::npos)
+    constexpr std::string_view whitespace = " \t\r\n";
+
+    const size_t start = text.find_first_not_of(whitespace);
+    if (start == std::string_view::npos)
     {
-        // line does not contain a colon
-        std::cerr << "Failed to extract value from line: " << line << '\n';
-        return "";
+        return {};
     }
 
-    std::string value = line.substr(split_pos + 1);
-    boost::algorithm::trim(value);
-    return value;
+    const size_t end = text.find_last_not_of(whitespace);
+    return text.substr(start, end - start + 1);
 }
 
-static bool extract_multipart_value(
-        const std::string& line, /* out */ std::vector<std::string>& parts, int expected_num_parts)
+static std::string_view trim_quotes(std::string_view text)
 {
-    const std::string value = extract_value(line);
-    if (value.empty())
+    const size_t start = text.find_first_not_of('"');
+    if (start == std::string_view::npos)
     {
-        return false;
+        return {};
     }
 
-    boost::algorithm::split_regex(parts, value, boost::regex(",\\s*"));
-    if (parts.size() != expected_num_parts)
+    const size_t end = text.find_last_not_of('"');
+    return text.substr(start, end - start + 1);
+}
+
+static bool parse_bool(std::string_view value)
+{
+    return value == "TRUE";
+}
+
+static bool parse_int(std::string_view value, /* out */ int& result)
+{
+    const auto [ptr, error] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (error != std::errc())
     {
-        std::cerr << "Failed to find " << expected_num_parts << " values in line: " << line << '\n';
+        Log::err() << "Failed to parse int value: " << value << '\n';
         return false;
     }
-
     return true;
 }
 
-static void trim_quotes(std::string& line)
+// Splits a comma-separated value into exactly `N` parts (with surrounding whitespace removed)
+template <size_t N>
+static bool split_value(std::string_view value, /* out */ std::array<std::string_view, N>& parts)
 {
-    boost::trim_if(line, boost::is_any_of("\""));
+    std::string_view remaining = value;
+    for (size_t i = 0; i < N; ++i)
+    {
+        const size_t comma_pos = remaining.find(',');
+        const bool is_last_part = (i == N - 1);
+        if (is_last_part != (comma_pos == std::string_view::npos))
+        {
+            // Too many or too few parts
+            Log::err() << "Failed to find " << N << " values in: " << value << '\n';
+            return false;
+        }
+
+        parts[i] = trim(remaining.substr(0, comma_pos));
+        remaining.remove_prefix(is_last_part ? remaining.size() : comma_pos + 1);
+    }
+
+    return true;
 }
 
-static std::string bool_as_str(bool b)
+static std::string_view bool_as_str(bool b)
 {
     return b ? "TRUE" : "FALSE";
 }
@@ -75,270 +98,252 @@ GameDatFile::GameDatFile(const std::filesystem::path& path, GameVersion game_ver
     read_dat_file(path);
 }
 
+void GameDatFile::read_dat_file(const std::filesystem::path& path)
+{
+    const FileUtils::MappedFile file(path, FileUtils::AccessHint::Sequential);
+    parse_dat_data(file.get_bytes());
+}
+
 // TODO: We could use some better error handling here.
 // For now, errors are generally logged to the console but otherwise ignored.
-void GameDatFile::read_dat_file(const std::filesystem::path& path)
+void GameDatFile::parse_dat_data(std::span<const char> data)
 {
-    std::vector<std::string> lines = FileUtils::read_text_file(path);
+    Trace::Span span("parse", "GameDatFile::parse");
+    span.set_bytes(data.size());
+
+    const std::string_view text(data.data(), data.size());
+    bool is_in_save_slots = false;
 
-    for (int i = 0; i < lines.size(); ++i)
+    size_t start = 0;
+    while (start < text.size())
     {
-        std::string line = boost::trim_copy(lines[i]);
+        size_t end = text.find('\n', start);
+        if (end == std::string_view::npos)
+        {
+            end = text.size();
+        }
+
+        const std::string_view line = trim(text.substr(start, end - start));
+        start = end + 1;
 
         if (line.empty())
         {
             continue;
         }
 
-        if (line.starts_with("Musik:"))
-        {
-            parse_music_setting(line);
-        }
-        else if (line.starts_with("Samples:"))
-        {
-            is_sound_enabled = parse_bool_setting(line);
-        }
-        else if (line.starts_with("Random:"))
-        {
-            is_music_shuffle_enabled = parse_bool_setting(line);
-        }
-        else if (line.starts_with("Volume:"))
-        {
-            parse_volume_setting(line);
-        }
-        else if (line.starts_with("VideoQual:"))
-        {
-            video_quality_flag = parse_bool_setting(line);
-        }
-        else if (line.starts_with("Song:"))
-        {
-            parse_disabled_music_track(line);
-        }
-        else if (line.starts_with("Speach:"))
-        {
-            parse_disabled_speech(line);
-        }
-        else if (line.starts_with("Video:"))
+        if (is_in_save_slots)
         {
-            parse_disabled_video(line);
-        }
-        else if (line.starts_with("Lastfile:"))
-        {
-            parse_autosave(line);
-        }
-        else if (line.starts_with("Endlosnr:"))
-        {
-            continuous_play_selection = parse_int_setting(line);
-        }
-        else if (line.starts_with("Tutornr:"))
-        {
-            tutorial_selection = parse_int_setting(line);
-        }
-        else if (line.starts_with("Kampagne:"))
-        {
-            parse_campaign_progress(line);
+            if (line == "EndObj;")
+            {
+                // End of section
+                is_in_save_slots = false;
+            }
+            else
+            {
+                parse_save_slot(line);
+            }
         }
         else if (line.starts_with("Objekt:"))
         {
-            parse_save_slots(lines, i);
+            is_in_save_slots = true;
         }
         else
         {
-            std::cerr << "Encountered unexpected setting: " << line << '\n';
+            parse_setting(line);
         }
     }
 }
 
-bool GameDatFile::parse_bool_setting(const std::string& line) const
-{
-    const std::string value = extract_value(line);
-    return value == "TRUE";
-}
-
-int GameDatFile::parse_int_setting(const std::string& line, int default_value) const
+void GameDatFile::parse_setting(std::string_view line)
 {
-    const std::string value = extract_value(line);
+    using SettingParser = void (*)(GameDatFile & file, std::string_view value);
 
-    try
+    struct SettingHandler
+    {
+        std::string_view key;
+        SettingParser parse;
+    };
+
+    // Keys are listed in the order they normally appear in the file
+    static constexpr std::array handlers {
+        SettingHandler { "Musik", [](GameDatFile& f, std::string_view v) { f.parse_music_setting(v); } },
+        SettingHandler { "Samples", [](GameDatFile& f, std::string_view v) { f.is_sound_enabled = parse_bool(v); } },
+        SettingHandler { "Random",
+                [](GameDatFile& f, std::string_view v) { f.is_music_shuffle_enabled = parse_bool(v); } },
+        SettingHandler { "Volume", [](GameDatFile& f, std::string_view v) { f.parse_volume_setting(v); } },
+        SettingHandler { "VideoQual",
+                [](GameDatFile& f, std::string_view v) { f.video_quality_flag = parse_bool(v); } },
+        SettingHandler { "Song", [](GameDatFile& f, std::string_view v) { f.parse_disabled_music_track(v); } },
+        SettingHandler { "Speach", [](GameDatFile& f, std::string_view v) { f.parse_disabled_speech(v); } },
+        SettingHandler { "Video", [](GameDatFile& f, std::string_view v) { f.parse_disabled_video(v); } },
+        SettingHandler { "Lastfile",
+                [](GameDatFile& f, std::string_view v) { f.last_save_file = trim_quotes(v); } },
+        SettingHandler { "Endlosnr",
+                [](GameDatFile& f, std::string_view v) { parse_int(v, f.continuous_play_selection); } },
+        SettingHandler { "Tutornr", [](GameDatFile& f, std::string_view v) { parse_int(v, f.tutorial_selection); } },
+        SettingHandler { "Kampagne",
+                [](GameDatFile& f, std::string_view v) {
+                    if (!f.parse_campaign_progress(v))
+                    {
+                        // Keep anything we don't understand, so that saving doesn't lose it
+                        f.unrecognized_campaign_progress.emplace_back(v);
+                    }
+                } },
+    };
+
+    const size_t split_pos = line.find(':');
+    if (split_pos == std::string_view::npos)
     {
-        return std::stoi(value);
+        Log::err() << "Encountered unexpected setting: " << line << '\n';
+        return;
     }
-    catch (const std::logic_error& err)
+
+    const std::string_view key = trim(line.substr(0, split_pos));
+    const std::string_view value = trim(line.substr(split_pos + 1));
+
+    for (const auto& handler : handlers)
     {
-        std::cerr << "Failed to parse int value: " << err.what() << '\n'  //
-                  << " in line: " << line << '\n';
-        return default_value;
+        if (handler.key == key)
+        {
+            handler.parse(*this, value);
+            return;
+        }
     }
+
+    Log::err() << "Encountered unexpected setting: " << line << '\n';
 }
 
-void GameDatFile::parse_music_setting(const std::string& line)
+void GameDatFile::parse_music_setting(std::string_view value)
 {
-    std::vector<std::string> parts;
-    if (!extract_multipart_value(line, /* out */ parts, 2))
+    std::array<std::string_view, 2> parts;
+    if (!split_value(value, /* out */ parts))
     {
         return;
     }
 
-    is_music_enabled = (parts[0] == "TRUE");
-
-    try
-    {
-        music_bitmask = std::stoi(parts[1]);
-    }
-    catch (const std::logic_error& err)
-    {
-        std::cerr << "Failed to parse music setting: " << err.what() << '\n';
-    }
+    is_music_enabled = parse_bool(parts[0]);
+    parse_int(parts[1], music_bitmask);
 }
 
-void GameDatFile::parse_volume_setting(const std::string& line)
+void GameDatFile::parse_volume_setting(std::string_view value)
 {
-    std::vector<std::string> parts;
-    if (!extract_multipart_value(line, /* out */ parts, 3))
+    std::array<std::string_view, 3> parts;
+    if (!split_value(value, /* out */ parts))
     {
         return;
     }
 
-    try
-    {
-        music_volume = std::stoi(parts[0]);
-        sound_volume = std::stoi(parts[1]);
+    parse_int(parts[0], music_volume);
+    parse_int(parts[1], sound_volume);
 
-        // For some reason this is grouped with the volume settings
-        main_game_progress = std::stoi(parts[2]);
-    }
-    catch (const std::logic_error& err)
-    {
-        std::cerr << "Failed to parse music setting: " << err.what() << '\n';
-    }
+    // For some reason this is grouped with the volume settings
+    parse_int(parts[2], main_game_progress);
 }
 
-void GameDatFile::parse_disabled_music_track(const std::string& line)
+void GameDatFile::parse_disabled_music_track(std::string_view value)
 {
-    std::vector<std::string> parts;
-    if (!extract_multipart_value(line, /* out */ parts, 2))
+    std::array<std::string_view, 2> parts;
+    if (!split_value(value, /* out */ parts))
     {
         return;
     }
 
-    try
+    int track_index = 0;
+    if (parse_int(parts[0], track_index))
     {
-        int track_index = std::stoi(parts[0]);
         disabled_music_tracks.push_back(track_index);
     }
-    catch (const std::logic_error& err)
-    {
-        std::cerr << "Failed to parse disabled music track: " << err.what() << '\n';
-    }
 }
 
-void GameDatFile::parse_disabled_speech(const std::string& line)
+void GameDatFile::parse_disabled_speech(std::string_view value)
 {
-    std::vector<std::string> parts;
-    if (!extract_multipart_value(line, /* out */ parts, 2))
+    std::array<std::string_view, 2> parts;
+    if (!split_value(value, /* out */ parts))
     {
         return;
     }
 
-    try
+    int index = 0;
+    if (!parse_int(parts[0], index) || index < 0 || index >= num_speech_categories)
     {
-        int index = std::stoi(parts[0]);
-        bool is_disabled = (parts[1] == "TRUE");
-        disabled_speech[index] = is_disabled;
-    }
-    catch (const std::logic_error& err)
-    {
-        std::cerr << "Failed to parse disabled music track: " << err.what() << '\n';
+        Log::err() << "Failed to parse disabled speech: " << value << '\n';
+        return;
     }
+
+    disabled_speech[index] = parse_bool(parts[1]);
 }
 
-void GameDatFile::parse_disabled_video(const std::string& line)
+void GameDatFile::parse_disabled_video(std::string_view value)
 {
-    std::vector<std::string> parts;
-    if (!extract_multipart_value(line, /* out */ parts, 2))
+    std::array<std::string_view, 2> parts;
+    if (!split_value(value, /* out */ parts))
     {
         return;
     }
 
-    try
-    {
-        int index = std::stoi(parts[0]);
-        bool is_disabled = (parts[1] == "TRUE");
-        disabled_videos[index] = is_disabled;
-    }
-    catch (const std::logic_error& err)
+    int index = 0;
+    if (!parse_int(parts[0], index) || index < 0 || index >= num_video_categories)
     {
-        std::cerr << "Failed to parse disabled video: " << err.what() << '\n';
+        Log::err() << "Failed to parse disabled video: " << value << '\n';
+        return;
     }
-}
 
-void GameDatFile::parse_autosave(const std::string& line)
-{
-    last_save_file = extract_value(line);
-    trim_quotes(last_save_file);
+    disabled_videos[index] = parse_bool(parts[1]);
 }
 
-void GameDatFile::parse_campaign_progress(const std::string& line)
+bool GameDatFile::parse_campaign_progress(std::string_view value)
 {
-    std::vector<std::string> parts;
-    if (!extract_multipart_value(line, /* out */ parts, 2))
+    std::array<std::string_view, 2> parts;
+    if (!split_value(value, /* out */ parts))
     {
-        return;
+        return false;
     }
 
-    try
+    int index = 0;
+    int progress = 0;
+    if (!parse_int(parts[0], index) || !parse_int(parts[1], progress))
     {
-        int index = std::stoi(parts[0]);
-        int progress = std::stoi(parts[1]);
-        campaign_progress[index] = progress;
+        return false;
     }
-    catch (const std::logic_error& err)
+
+    if (index < 0 || index >= num_campaign_slots)
     {
-        std::cerr << "Failed to parse campaign progress: " << err.what() << '\n';
+        Log::err() << "Found progress for invalid campaign index: " << index << '\n';
+        return false;
     }
+
+    campaign_progress[index] = progress;
+    has_progress_entry.set(index);
+    return true;
 }
 
-void GameDatFile::parse_save_slots(const std::vector<std::string>& lines, int& i)
+void GameDatFile::parse_save_slot(std::string_view line)
 {
-    // Skip over the "Objekt" line
-    ++i;
-
-    // Parse the section line-by-line
-    for (; i < lines.size(); ++i)
+    // e.g. `Name:      0, "My Game", 1`
+    const size_t split_pos = line.find(':');
+    const size_t first_comma_pos = line.find(',');
+    const size_t last_comma_pos = line.rfind(',');
+    if (split_pos == std::string_view::npos || first_comma_pos == last_comma_pos || first_comma_pos < split_pos)
     {
-        const std::string line = boost::trim_copy(lines[i]);
-
-        if (line.empty())
-        {
-            continue;
-        }
-
-        if (line == "EndObj;")
-        {
-            // End of section
-            break;
-        }
-
-        std::vector<std::string> parts;
-        if (!extract_multipart_value(line, /* out */ parts, 3))
-        {
-            continue;
-        }
+        Log::err() << "Failed to parse save slot: " << line << '\n';
+        return;
+    }
 
-        try
-        {
-            int index = std::stoi(parts[0]);
-            std::string name = parts[1];
-            trim_quotes(name);
-            int num_players = std::stoi(parts[2]);
+    // The name may itself contain commas, so we split on the first and last comma only
+    int index = 0;
+    int num_players = 0;
+    const std::string_view index_str = trim(line.substr(split_pos + 1, first_comma_pos - split_pos - 1));
+    const std::string_view name = line.substr(first_comma_pos + 1, last_comma_pos - first_comma_pos - 1);
+    const std::string_view num_players_str = trim(line.substr(last_comma_pos + 1));
 
-            save_slots[index] = { name, num_players };
-        }
-        catch (const std::logic_error& err)
-        {
-            std::cerr << "Failed to parse campaign progress: " << err.what() << '\n';
-        }
+    if (!parse_int(index_str, index) || !parse_int(num_players_str, num_players) || index < 0
+            || index >= num_savegames)
+    {
+        Log::err() << "Failed to parse save slot: " << line << '\n';
+        return;
     }
+
+    save_slots[index] = { std::string(trim_quotes(trim(name))), num_players };
 }
 
 void GameDatFile::save_overwrite()
@@ -346,68 +351,91 @@ void GameDatFile::save_overwrite()
     save_to_path(src_path);
 }
 
-/* clang-format off */
+void GameDatFile::stage_overwrite(FileTransaction& transaction) const
+{
+    const std::string text = serialize();
+    transaction.stage_file(src_path, text);
+}
+
 void GameDatFile::save_to_path(const std::filesystem::path& path)
 {
-    std::stringstream ss;
+    FileUtils::write_text_file(path, serialize());
+}
+
+/* clang-format off */
+std::string GameDatFile::serialize() const
+{
+    Trace::Span span("parse", "GameDatFile::serialize");
+
+    // Generous estimate, so that the buffer only needs to be allocated once
+    std::string text;
+    text.reserve(1024 + 32 * has_progress_entry.count() + 16 * disabled_music_tracks.size());
+    auto out = std::back_inserter(text);
 
     // General settings
-    ss << '\n'
-       << std::format("  Musik:     {}, {}\n", bool_as_str(is_music_enabled), music_bitmask)
-       << std::format("  Samples:   {}\n", bool_as_str(is_sound_enabled))
-       << std::format("  Random:    {}\n", bool_as_str(is_music_shuffle_enabled))
-       << std::format("  Volume:    {}, {}, {}\n", music_volume, sound_volume, main_game_progress)
-       << std::format("  VideoQual: {}\n\n", bool_as_str(video_quality_flag));
- 
+    std::format_to(out, "\n");
+    std::format_to(out, "  Musik:     {}, {}\n", bool_as_str(is_music_enabled), music_bitmask);
+    std::format_to(out, "  Samples:   {}\n", bool_as_str(is_sound_enabled));
+    std::format_to(out, "  Random:    {}\n", bool_as_str(is_music_shuffle_enabled));
+    std::format_to(out, "  Volume:    {}, {}, {}\n", music_volume, sound_volume, main_game_progress);
+    std::format_to(out, "  VideoQual: {}\n\n", bool_as_str(video_quality_flag));
+
     // Disabled music tracks
     for (int track_id : disabled_music_tracks)
     {
-        ss << std::format("  Song:     {}, FALSE\n", track_id);
+        std::format_to(out, "  Song:     {}, FALSE\n", track_id);
     }
-    ss << "  \n";
- 
+    text += "  \n";
+
     // Disabled speech
     for (int i = 0; i < num_speech_categories; i++)
     {
-        ss << std::format("  Speach:    {}, {}\n", i, bool_as_str(disabled_speech[i]));
+        std::format_to(out, "  Speach:    {}, {}\n", i, bool_as_str(disabled_speech[i]));
     }
-    ss << "  \n";
+    text += "  \n";
 
     // Disabled videos
     for (int i = 0; i < num_video_categories; i++)
     {
-        ss << std::format("  Video:     {}, {}\n", i, bool_as_str(disabled_videos[i]));
+        std::format_to(out, "  Video:     {}, {}\n", i, bool_as_str(disabled_videos[i]));
     }
-    ss << "  \n";
+    text += "  \n";
 
     // Autosave file location
-    ss << std::format("  Lastfile: \"{}\"\n\n", last_save_file);
+    std::format_to(out, "  Lastfile: \"{}\"\n\n", last_save_file);
 
     // Continuous Play / Tutorial selection
-    ss << std::format("  Endlosnr: {}\n", continuous_play_selection)
-       << std::format("  Tutornr:  {}\n\n", tutorial_selection);
+    std::format_to(out, "  Endlosnr: {}\n", continuous_play_selection);
+    std::format_to(out, "  Tutornr:  {}\n\n", tutorial_selection);
 
     // Campaign progress
-    for (const auto& [campaign_index, progress] : campaign_progress)
+    for (int campaign_index = 0; campaign_index < num_campaign_slots; ++campaign_index)
+    {
+        if (has_progress_entry.test(campaign_index))
+        {
+            std::format_to(out, "  Kampagne: {}, {}\n", campaign_index, campaign_progress[campaign_index]);
+        }
+    }
+    for (const auto& value : unrecognized_campaign_progress)
     {
-        ss << std::format("  Kampagne: {}, {}\n", campaign_index, progress);
+        std::format_to(out, "  Kampagne: {}\n", value);
     }
-    ss << "  \n";
+    text += "  \n";
 
     // Save game names (not present in the History Edition)
     if (game_version == GameVersion::Original)
     {
-        ss << "  Objekt:   SPIELNAME\n\n";
+        text += "  Objekt:   SPIELNAME\n\n";
         for (int i = 0; i < num_savegames; i++)
         {
             const auto& save_slot = save_slots[i];
             // `:>7` is used to add padding dynamically, since the number of spaces is not fixed
-            ss << std::format("    Name:{:>7}, \"{}\", {}\n", i, save_slot.name, save_slot.num_players);
+            std::format_to(out, "    Name:{:>7}, \"{}\", {}\n", i, save_slot.name, save_slot.num_players);
         }
-        ss << "  \n  EndObj;\n\n";
+        text += "  \n  EndObj;\n\n";
     }
 
-    FileUtils::write_text_file(path, ss.str());
+    return text;
 }
 /* clang-format on */
 
@@ -416,19 +444,81 @@ void GameDatFile::set_main_game_progress(int progress)
     main_game_progress = std::clamp(progress, new_game_progress, completed_game_progress);
 }
 
+bool GameDatFile::has_campaign_progress(int campaign_index) const
+{
+    return campaign_index >= 0 && campaign_index < num_campaign_slots && has_progress_entry.test(campaign_index);
+}
+
 int GameDatFile::get_campaign_progress(int campaign_index) const
 {
-    const auto it = campaign_progress.find(campaign_index);
-    if (it == campaign_progress.cend())
+    return has_campaign_progress(campaign_index) ? campaign_progress[campaign_index] : 0;
+}
+
+void GameDatFile::get_campaign_progress(std::span<const int> campaign_indices, std::span<int> progress) const
+{
+    if (progress.size() < campaign_indices.size())
+    {
+        throw std::invalid_argument("Not enough room for campaign progress");
+    }
+
+    for (size_t i = 0; i < campaign_indices.size(); ++i)
     {
-        return 0;
+        progress[i] = get_campaign_progress(campaign_indices[i]);
     }
-    return it->second;
 }
 
 void GameDatFile::set_campaign_progress(int campaign_index, int progress)
 {
+    if (campaign_index < 0 || campaign_index >= num_campaign_slots)
+    {
+        throw std::out_of_range("Invalid campaign index: " + std::to_string(campaign_index));
+    }
+
     campaign_progress[campaign_index] = progress;
+    has_progress_entry.set(campaign_index);
+}
+
+void GameDatFile::set_campaign_progress(std::span<const int> campaign_indices, std::span<const int> progress)
+{
+    if (progress.size() != campaign_indices.size())
+    {
+        throw std::invalid_argument("Campaign indices and progress differ in size");
+    }
+
+    for (size_t i = 0; i < campaign_indices.size(); ++i)
+    {
+        set_campaign_progress(campaign_indices[i], progress[i]);
+    }
+}
+
+void GameDatFile::remap_campaign_progress(std::span<const int> new_campaign_indices)
+{
+    std::array<int, num_campaign_slots> new_campaign_progress {};
+    std::bitset<num_campaign_slots> new_has_progress_entry;
+
+    for (int i = 0; i < num_campaign_slots; ++i)
+    {
+        if (!has_progress_entry.test(i))
+        {
+            continue;
+        }
+
+        const int new_index = static_cast<size_t>(i) < new_campaign_indices.size() ? new_campaign_indices[i] : i;
+        if (new_index < 0)
+        {
+            continue;
+        }
+        if (new_index >= num_campaign_slots)
+        {
+            throw std::out_of_range("Invalid campaign index: " + std::to_string(new_index));
+        }
+
+        new_campaign_progress[new_index] = campaign_progress[i];
+        new_has_progress_entry.set(new_index);
+    }
+
+    campaign_progress = new_campaign_progress;
+    has_progress_entry = new_has_progress_entry;
 }
 
 }  // namespace Anno
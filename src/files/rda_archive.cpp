@@ -0,0 +1,469 @@
+#include "files/rda_archive.h"
+
+#include <zlib.h>
+
+#include <algorithm>  // min
+#include <array>
+#include <cctype>  // tolower
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>  // move
+
+#include "util/buffer_utils.h"
+#include "util/text_encoding.h"
+#include "util/trace.h"
+
+namespace Anno {
+
+/*
+ * Helper methods
+ */
+
+// Size of the pieces that entries are unpacked in
+static constexpr size_t unpack_buffer_size = 64 * 1024;
+
+// The magic string is stored as UTF-16 in version 2.0, but as plain ASCII in version 2.2
+static constexpr std::string_view magic_2_2 = "Resource File V2.2";
+static constexpr std::string_view magic_2_0 = "Resource File V2.0";
+
+static constexpr size_t header_size_2_0 = magic_2_0.size() * 2 + 1008 + sizeof(std::uint32_t);
+static constexpr size_t header_size_2_2 = magic_2_2.size() + 766 + sizeof(std::uint64_t);
+
+// Each directory entry starts with a null-padded UTF-16 path
+static constexpr size_t max_path_length = 260;
+
+// Seeds for the encryption key stream
+static constexpr std::uint32_t encryption_seed_2_0 = 0xA2C2A;
+static constexpr std::uint32_t encryption_seed_2_2 = 0x71C71C71;
+
+// Reads a 32-bit value in version 2.0, or a 64-bit value in version 2.2
+static std::uint64_t read_size(std::span<const char> data, size_t& offset, bool is_version_2_2)
+{
+    return is_version_2_2 ? BufferUtils::read<std::uint64_t>(data, offset)
+                          : BufferUtils::read<std::uint32_t>(data, offset);
+}
+
+static std::span<const char> get_range(std::span<const char> data, std::uint64_t offset, std::uint64_t size)
+{
+    if (offset > data.size() || size > data.size() - offset)
+    {
+        throw std::runtime_error("Archive data extends beyond the end of the file");
+    }
+    return data.subspan(static_cast<size_t>(offset), static_cast<size_t>(size));
+}
+
+static std::string utf16_to_utf8(std::span<const char> data)
+{
+    std::string text;
+    for (size_t i = 0; i + 1 < data.size(); i += 2)
+    {
+        std::uint32_t code_point = static_cast<unsigned char>(data[i]) | (static_cast<unsigned char>(data[i + 1]) << 8);
+        if (code_point == 0)
+        {
+            break;
+        }
+
+        // Combine surrogate pairs
+        if (code_point >= 0xD800 && code_point < 0xDC00 && i + 3 < data.size())
+        {
+            const std::uint32_t low = static_cast<unsigned char>(data[i + 2])
+                    | (static_cast<unsigned char>(data[i + 3]) << 8);
+            if (low >= 0xDC00 && low < 0xE000)
+            {
+                code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                i += 2;
+            }
+        }
+
+        TextEncoding::append_utf8(text, code_point);
+    }
+    return text;
+}
+
+namespace {
+
+// Undoes the encryption, which XORs each 16-bit word with the next value from a linear congruential generator.
+// Data can be decrypted a piece at a time, as long as every piece but the last has an even length.
+class Decryptor
+{
+public:
+    explicit Decryptor(std::uint32_t seed)
+        : key(seed)
+    {
+    }
+
+    void decrypt(std::span<char> data)
+    {
+        // Any trailing odd byte is not encrypted
+        for (size_t i = 0; i + 1 < data.size(); i += 2)
+        {
+            key = key * 214013 + 2531011;
+            const auto mask = static_cast<std::uint16_t>((key >> 16) & 0x7FFF);
+            data[i] = static_cast<char>(data[i] ^ (mask & 0xFF));
+            data[i + 1] = static_cast<char>(data[i + 1] ^ (mask >> 8));
+        }
+    }
+
+private:
+    std::uint32_t key;
+};
+
+// Inflates a zlib stream a piece at a time
+class Inflater
+{
+public:
+    Inflater()
+    {
+        if (inflateInit(&stream) != Z_OK)
+        {
+            throw std::runtime_error("Failed to initialize decompression");
+        }
+    }
+
+    ~Inflater()
+    {
+        inflateEnd(&stream);
+    }
+
+    Inflater(const Inflater&) = delete;
+    Inflater& operator=(const Inflater&) = delete;
+
+    // Returns true once the end of the stream has been reached
+    bool inflate(std::span<const char> input, const std::function<void(std::span<const char>)>& sink)
+    {
+        std::array<char, unpack_buffer_size> output;
+
+        // zlib does not modify its input, but its API predates const
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        stream.avail_in = static_cast<uInt>(input.size());
+        do
+        {
+            stream.next_out = reinterpret_cast<Bytef*>(output.data());
+            stream.avail_out = static_cast<uInt>(output.size());
+            const uInt avail_in_before = stream.avail_in;
+            const int result = ::inflate(&stream, Z_NO_FLUSH);
+            if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+            {
+                throw std::runtime_error("Failed to decompress archive data");
+            }
+
+            const size_t num_bytes_out = output.size() - stream.avail_out;
+            if (num_bytes_out > 0)
+            {
+                sink(std::span<const char>(output.data(), num_bytes_out));
+            }
+
+            if (result == Z_STREAM_END)
+            {
+                return true;
+            }
+
+            // Z_BUF_ERROR just means that no progress was possible, which is only expected once the input runs out;
+            // anything else would have us calling `inflate` forever
+            if (num_bytes_out == 0 && stream.avail_in == avail_in_before)
+            {
+                if (stream.avail_in == 0)
+                {
+                    break;
+                }
+                throw std::runtime_error("Failed to decompress archive data");
+            }
+        } while (stream.avail_in > 0 || stream.avail_out == 0);
+
+        return false;
+    }
+
+private:
+    z_stream stream {};
+};
+
+}  // namespace
+
+/*
+ * RdaArchive class
+ */
+
+RdaArchive::RdaArchive(const std::filesystem::path& path)
+    : file(path, FileUtils::AccessHint::Random)
+{
+    Trace::Span span("io", "RdaArchive::open");
+    span.set_path(path);
+
+    read_blocks();
+
+    span.set_bytes(file.get_bytes().size());
+}
+
+std::string RdaArchive::normalize_path(std::string_view path)
+{
+    std::string normalized;
+    normalized.reserve(path.size());
+    for (char c : path)
+    {
+        normalized.push_back(c == '\\' ? '/' : static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+    }
+    return normalized;
+}
+
+void RdaArchive::read_blocks()
+{
+    const std::span<const char> data = file.get_bytes();
+
+    // Determine the version from the magic string
+    std::uint64_t block_offset = 0;
+    if (data.size() >= header_size_2_2 && std::string_view(data.data(), magic_2_2.size()) == magic_2_2)
+    {
+        is_version_2_2 = true;
+        size_t offset = header_size_2_2 - sizeof(std::uint64_t);
+        block_offset = BufferUtils::read<std::uint64_t>(data, offset);
+    }
+    else if (data.size() >= header_size_2_0 && utf16_to_utf8(data.subspan(0, magic_2_0.size() * 2)) == magic_2_0)
+    {
+        size_t offset = header_size_2_0 - sizeof(std::uint32_t);
+        block_offset = BufferUtils::read<std::uint32_t>(data, offset);
+    }
+    else
+    {
+        throw std::runtime_error("Not a supported RDA archive");
+    }
+
+    // Follow the chain of blocks until it points to the end of the file
+    while (block_offset < data.size())
+    {
+        if (blocks.size() >= data.size())
+        {
+            // Every block takes up some space, so there can't be this many
+            throw std::runtime_error("Archive contains a loop");
+        }
+
+        size_t offset = static_cast<size_t>(block_offset);
+        Block& block = blocks.emplace_back();
+        block.flags = BufferUtils::read<std::uint32_t>(data, offset);
+        const auto num_files = BufferUtils::read<std::uint32_t>(data, offset);
+        const std::uint64_t directory_stored_size = read_size(data, offset, is_version_2_2);
+        const std::uint64_t directory_size = read_size(data, offset, is_version_2_2);
+        const std::uint64_t next_block_offset = read_size(data, offset, is_version_2_2);
+
+        const size_t entry_size = max_path_length * 2 + 5 * (is_version_2_2 ? 8 : 4);
+        if (directory_size != static_cast<std::uint64_t>(num_files) * entry_size
+                || directory_stored_size > block_offset)
+        {
+            throw std::runtime_error("Invalid directory in archive");
+        }
+        const std::uint64_t directory_offset = block_offset - directory_stored_size;
+
+        // The blob of a memory-resident block comes just before the directory, followed by its sizes
+        if (block.flags & flag_memory_resident)
+        {
+            const size_t sizes_size = is_version_2_2 ? 16 : 8;
+            if (directory_offset < sizes_size)
+            {
+                throw std::runtime_error("Invalid memory-resident block in archive");
+            }
+            size_t sizes_offset = static_cast<size_t>(directory_offset - sizes_size);
+            block.blob_stored_size = read_size(data, sizes_offset, is_version_2_2);
+            block.blob_size = read_size(data, sizes_offset, is_version_2_2);
+            if (block.blob_stored_size > directory_offset - sizes_size)
+            {
+                throw std::runtime_error("Invalid memory-resident block in archive");
+            }
+            block.blob_offset = directory_offset - sizes_size - block.blob_stored_size;
+        }
+
+        if (!(block.flags & flag_deleted) && num_files > 0)
+        {
+            // The directory is packed in the same way as the files
+            std::vector<char> directory_data;
+            directory_data.reserve(static_cast<size_t>(directory_size));
+            unpack(get_range(data, directory_offset, directory_stored_size),
+                    block.flags,
+                    directory_size,
+                    [&](std::span<const char> piece) {
+                        directory_data.insert(directory_data.end(), piece.begin(), piece.end());
+                    });
+            read_directory(directory_data, blocks.size() - 1);
+        }
+
+        if (next_block_offset <= block_offset)
+        {
+            // Blocks are stored in order, so anything else must be the end (or corrupt)
+            break;
+        }
+        block_offset = next_block_offset;
+    }
+
+    if (block_offset > data.size())
+    {
+        throw std::runtime_error("Archive is truncated");
+    }
+}
+
+void RdaArchive::read_directory(std::span<const char> directory_data, size_t block_index)
+{
+    const Block& block = blocks[block_index];
+
+    size_t offset = 0;
+    while (offset < directory_data.size())
+    {
+        Entry entry;
+        entry.path = utf16_to_utf8(BufferUtils::read_bytes(directory_data, offset, max_path_length * 2));
+        entry.offset = read_size(directory_data, offset, is_version_2_2);
+        entry.stored_size = read_size(directory_data, offset, is_version_2_2);
+        entry.size = read_size(directory_data, offset, is_version_2_2);
+        entry.timestamp = read_size(directory_data, offset, is_version_2_2);
+        read_size(directory_data, offset, is_version_2_2);  // unknown
+        entry.block_index = block_index;
+
+        std::replace(entry.path.begin(), entry.path.end(), '\\', '/');
+
+        // Check the location up front, so that reading the entry can't go out of bounds
+        const std::uint64_t container_size =
+                (block.flags & flag_memory_resident) ? block.blob_size : file.get_bytes().size();
+        if (entry.offset > container_size || entry.stored_size > container_size - entry.offset)
+        {
+            throw std::runtime_error("Archive entry extends beyond the end of the file: " + entry.path);
+        }
+
+        entry_indices.insert_or_assign(normalize_path(entry.path), entries.size());
+        entries.push_back(std::move(entry));
+    }
+}
+
+const RdaArchive::Entry* RdaArchive::find_entry(std::string_view path) const
+{
+    const auto it = entry_indices.find(normalize_path(path));
+    return it != entry_indices.end() ? &entries[it->second] : nullptr;
+}
+
+void RdaArchive::stream_entry(const Entry& entry, const std::function<void(std::span<const char>)>& sink) const
+{
+    Trace::Span span("io", "RdaArchive::stream_entry");
+    span.set_bytes(entry.size);
+
+    const Block& block = blocks[entry.block_index];
+    if (block.flags & flag_memory_resident)
+    {
+        // Files within the blob are stored as-is
+        const std::vector<char>& blob = get_blob(entry.block_index);
+        sink(get_range(blob, entry.offset, entry.size));
+        return;
+    }
+
+    unpack(get_range(file.get_bytes(), entry.offset, entry.stored_size), block.flags, entry.size, sink);
+}
+
+void RdaArchive::read_entry(const Entry& entry, std::span<char> buffer) const
+{
+    if (buffer.size() != entry.size)
+    {
+        throw std::invalid_argument("Buffer size does not match entry: " + entry.path);
+    }
+
+    size_t num_bytes_read = 0;
+    stream_entry(entry, [&](std::span<const char> piece) {
+        if (piece.size() > buffer.size() - num_bytes_read)
+        {
+            throw std::runtime_error("Archive entry is larger than expected: " + entry.path);
+        }
+        std::copy(piece.begin(), piece.end(), buffer.begin() + num_bytes_read);
+        num_bytes_read += piece.size();
+    });
+
+    if (num_bytes_read != buffer.size())
+    {
+        throw std::runtime_error("Archive entry is smaller than expected: " + entry.path);
+    }
+}
+
+std::vector<char> RdaArchive::read_entry(const Entry& entry) const
+{
+    if (entry.size > std::numeric_limits<size_t>::max())
+    {
+        throw std::runtime_error("Archive entry is too large: " + entry.path);
+    }
+
+    std::vector<char> buffer(static_cast<size_t>(entry.size));
+    read_entry(entry, buffer);
+    return buffer;
+}
+
+void RdaArchive::unpack(std::span<const char> stored_data,
+        std::uint32_t flags,
+        std::uint64_t size,
+        const std::function<void(std::span<const char>)>& sink) const
+{
+    const bool is_compressed = (flags & flag_compressed) != 0;
+    const bool is_encrypted = (flags & flag_encrypted) != 0;
+
+    if (!is_compressed && !is_encrypted)
+    {
+        // Stored as-is
+        sink(stored_data.subspan(0, static_cast<size_t>(std::min<std::uint64_t>(size, stored_data.size()))));
+        return;
+    }
+
+    std::optional<Inflater> inflater;
+    if (is_compressed)
+    {
+        inflater.emplace();
+    }
+    std::optional<Decryptor> decryptor;
+    if (is_encrypted)
+    {
+        decryptor.emplace(is_version_2_2 ? encryption_seed_2_2 : encryption_seed_2_0);
+    }
+
+    // Work through the stored data a piece at a time (keeping pieces an even length, for the decryptor)
+    std::array<char, unpack_buffer_size> decrypted;
+    for (size_t offset = 0; offset < stored_data.size(); offset += unpack_buffer_size)
+    {
+        const size_t piece_size = std::min(unpack_buffer_size, stored_data.size() - offset);
+        std::span<const char> piece = stored_data.subspan(offset, piece_size);
+        if (decryptor.has_value())
+        {
+            std::copy(piece.begin(), piece.end(), decrypted.begin());
+            decryptor->decrypt(std::span<char>(decrypted.data(), piece.size()));
+            piece = std::span<const char>(decrypted.data(), piece.size());
+        }
+
+        if (!inflater.has_value())
+        {
+            sink(piece);
+        }
+        else if (inflater->inflate(piece, sink))
+        {
+            return;
+        }
+    }
+
+    if (inflater.has_value())
+    {
+        throw std::runtime_error("Compressed archive data ends unexpectedly");
+    }
+}
+
+const std::vector<char>& RdaArchive::get_blob(size_t block_index) const
+{
+    std::scoped_lock lock(blobs_mutex);
+
+    auto& blob = blobs[block_index];
+    if (!blob)
+    {
+        Trace::Span span("io", "RdaArchive::unpack_blob");
+
+        const Block& block = blocks[block_index];
+        auto new_blob = std::make_unique<std::vector<char>>();
+        new_blob->reserve(static_cast<size_t>(block.blob_size));
+        unpack(get_range(file.get_bytes(), block.blob_offset, block.blob_stored_size),
+                block.flags,
+                block.blob_size,
+                [&](std::span<const char> piece) { new_blob->insert(new_blob->end(), piece.begin(), piece.end()); });
+        span.set_bytes(new_blob->size());
+        blob = std::move(new_blob);
+    }
+
+    return *blob;
+}
+
+}  // namespace Anno
@@ -1,6 +1,8 @@
 #include "files/scenario_file.h"
 
 #include <cstdint>
+#include <cstring>  // memcpy
+#include <utility>  // move
 
 #include "files/file_utils.h"
 #include "util/buffer_utils.h"
@@ -8,8 +10,14 @@
 namespace Anno {
 
 ScenarioFile::ScenarioFile(const std::filesystem::path& path)
-    : file_data(FileUtils::read_binary_file(path))
-    , src_path(path)
+    : src_path(path)
+{
+    read_header();
+}
+
+ScenarioFile::ScenarioFile(const std::filesystem::path& path, std::vector<char> header_data)
+    : src_path(path)
+    , header_data(std::move(header_data))
 {
     parse_scenario_data();
 }
@@ -19,17 +27,25 @@ std::string ScenarioFile::get_filename() const
     return src_path.stem().string();
 }
 
+void ScenarioFile::read_header()
+{
+    header_data = FileUtils::read_binary_file_prefix(src_path, campaign_chunk_size);
+    parse_scenario_data();
+}
+
 void ScenarioFile::parse_scenario_data()
 {
     // Fortunately the campaign chunk is right at the start (if present), so we don't have to parse the whole file.
     // If we ever did want to parse the whole file, it would be best to do this separately on request, because it's
-    // useful to be able to read the scenario "header" very quickly.
+    // useful to be able to read the scenario "header" very quickly. For this reason, only the header is read when
+    // the ScenarioFile is created.
     // Note that values are stored as little-endian, so big-endian architectures would need to flip the bytes after
     // reading any values.
-    if (is_campaign_chunk_present(file_data))
+    campaign_index = -1;
+    if (header_data.size() >= campaign_chunk_size && is_campaign_chunk_present(header_data))
     {
         // Read the value directly after the chunk header
-        std::memcpy(&campaign_index, &file_data[chunk_header_size], sizeof(int32_t));
+        std::memcpy(&campaign_index, &header_data[chunk_header_size], sizeof(int32_t));
     }
 }
 
@@ -39,6 +55,22 @@ bool ScenarioFile::is_campaign_chunk_present(const std::vector<char>& data) cons
     return view.substr(0, campaign_chunk_header.length()) == campaign_chunk_header;
 }
 
+const ChunkIndex& ScenarioFile::get_chunk_index()
+{
+    if (!chunk_index.has_value())
+    {
+        mapped_file.emplace(src_path, FileUtils::AccessHint::Random);
+        chunk_index.emplace(mapped_file->get_bytes());
+    }
+    return *chunk_index;
+}
+
+void ScenarioFile::discard_full_data()
+{
+    chunk_index.reset();
+    mapped_file.reset();
+}
+
 void ScenarioFile::set_campaign_index(int new_campaign_index)
 {
     if (campaign_index == new_campaign_index)
@@ -51,58 +83,112 @@ void ScenarioFile::set_campaign_index(int new_campaign_index)
     is_dirty = true;
 }
 
+void ScenarioFile::discard_changes()
+{
+    // The header is only re-read once a change has been saved, so it still holds the original campaign index
+    parse_scenario_data();
+    is_dirty = false;
+}
+
 void ScenarioFile::save_overwrite()
 {
+    if (!is_dirty)
+    {
+        // File on disk is already up to date
+        return;
+    }
+
+    const bool wants_campaign_chunk = (campaign_index >= 0);
+    const bool has_campaign_chunk = is_campaign_chunk_present(header_data);
+
+    if (wants_campaign_chunk && has_campaign_chunk)
+    {
+        // Modify the existing campaign header in place.
+        // Any mapping must be released first, since some platforms do not allow writing to a mapped file.
+        discard_full_data();
+        const int32_t new_index = static_cast<int32_t>(campaign_index);
+        FileUtils::write_binary_file_at(src_path,
+                chunk_header_size,
+                std::span<const char>(reinterpret_cast<const char*>(&new_index), sizeof(int32_t)));
+        std::memcpy(&header_data[chunk_header_size], &new_index, sizeof(int32_t));
+        is_dirty = false;
+        return;
+    }
+
+    // The campaign header needs to be added or removed, which shifts the rest of the file
     save_to_path(src_path);
 }
 
-void ScenarioFile::save_to_path(const std::filesystem::path& path)
+void ScenarioFile::stage_overwrite(FileTransaction& transaction)
 {
-    if (is_dirty)
+    if (!is_dirty)
     {
-        update_data();
-        is_dirty = false;
+        // File on disk is already up to date
+        return;
+    }
+
+    // Any mapping must be released before the transaction modifies the file
+    discard_full_data();
+
+    const bool wants_campaign_chunk = (campaign_index >= 0);
+    const bool has_campaign_chunk = is_campaign_chunk_present(header_data);
+
+    if (wants_campaign_chunk && has_campaign_chunk)
+    {
+        // Only the campaign index itself needs to change
+        const int32_t new_index = static_cast<int32_t>(campaign_index);
+        transaction.stage_patch(src_path,
+                chunk_header_size,
+                std::span<const char>(reinterpret_cast<const char*>(&new_index), sizeof(int32_t)));
+    }
+    else
+    {
+        // The campaign header needs to be added or removed, which shifts the rest of the file
+        const std::vector<char> new_header = wants_campaign_chunk ? make_campaign_chunk() : std::vector<char>();
+        const size_t num_bytes_to_skip = has_campaign_chunk ? campaign_chunk_size : 0;
+        transaction.stage_file_with_prefix(src_path, num_bytes_to_skip, new_header);
     }
 
-    FileUtils::write_binary_file(path, file_data);
+    transaction.on_commit([this]() {
+        // The source file has changed, so our header is out of date
+        read_header();
+        is_dirty = false;
+    });
 }
 
-void ScenarioFile::update_data()
+void ScenarioFile::save_to_path(const std::filesystem::path& path)
 {
     const bool wants_campaign_chunk = (campaign_index >= 0);
-    const bool has_campaign_chunk = is_campaign_chunk_present(file_data);
+    const bool has_campaign_chunk = is_campaign_chunk_present(header_data);
 
-    if (wants_campaign_chunk)
+    // Stream the scenario to its destination, replacing the existing campaign header (if any) with the new one
+    const std::vector<char> new_header = wants_campaign_chunk ? make_campaign_chunk() : std::vector<char>();
+    const size_t num_bytes_to_skip = has_campaign_chunk ? campaign_chunk_size : 0;
+    if (path == src_path)
     {
-        if (has_campaign_chunk)
-        {
-            // Modify the existing campaign header
-            std::memcpy(&file_data[chunk_header_size], &campaign_index, sizeof(int32_t));
-        }
-        else
-        {
-            // Add the campaign header
-            file_data = prepend_campaign_chunk(file_data);
-        }
+        // The source file is about to be replaced, so any mapping of it must be released
+        discard_full_data();
     }
-    else if (has_campaign_chunk)
+    FileUtils::write_binary_file_with_prefix(src_path, path, num_bytes_to_skip, new_header);
+
+    if (path == src_path)
     {
-        // Remove the campaign header entirely
-        file_data.erase(file_data.begin(), file_data.begin() + campaign_chunk_size);
+        // The source file has changed, so our header is out of date
+        read_header();
+        is_dirty = false;
     }
 }
 
-std::vector<char> ScenarioFile::prepend_campaign_chunk(const std::vector<char>& data) const
+std::vector<char> ScenarioFile::make_campaign_chunk() const
 {
-    std::vector<char> new_data;
-    new_data.reserve(data.size() + campaign_chunk_size);
+    std::vector<char> chunk;
+    chunk.reserve(campaign_chunk_size);
 
-    BufferUtils::append(new_data, campaign_chunk_header);
-    BufferUtils::append(new_data, int32_t { static_cast<std::int32_t>(/* chunk size (bytes) */ 4) });
-    BufferUtils::append(new_data, int32_t { static_cast<std::int32_t>(campaign_index) });
-    BufferUtils::append(new_data, data);
+    chunk.insert(chunk.end(), campaign_chunk_header.begin(), campaign_chunk_header.end());
+    BufferUtils::append(chunk, int32_t { static_cast<std::int32_t>(/* chunk size (bytes) */ 4) });
+    BufferUtils::append(chunk, int32_t { static_cast<std::int32_t>(campaign_index) });
 
-    return new_data;
+    return chunk;
 }
 
 }  // namespace Anno
@@ -0,0 +1,165 @@
+#include "files/snapshot_file.h"
+
+#include <stdexcept>
+#include <system_error>
+
+#include "files/file_utils.h"
+#include "util/buffer_utils.h"
+
+namespace Anno {
+
+/*
+ * Helper methods
+ */
+
+static void append_string(std::vector<char>& buf, std::string_view text)
+{
+    BufferUtils::append(buf, static_cast<std::uint32_t>(text.size()));
+    buf.insert(buf.end(), text.begin(), text.end());
+}
+
+static std::string read_string(std::span<const char> buf, size_t& offset)
+{
+    const auto length = BufferUtils::read<std::uint32_t>(buf, offset);
+    const std::span<const char> bytes = BufferUtils::read_bytes(buf, offset, length);
+    return std::string(bytes.begin(), bytes.end());
+}
+
+static void append_stamp(std::vector<char>& buf, const SnapshotFile::FileStamp& stamp)
+{
+    BufferUtils::append(buf, stamp.size);
+    BufferUtils::append(buf, stamp.modified_time);
+}
+
+static SnapshotFile::FileStamp read_stamp(std::span<const char> buf, size_t& offset)
+{
+    SnapshotFile::FileStamp stamp;
+    stamp.size = BufferUtils::read<std::uint64_t>(buf, offset);
+    stamp.modified_time = BufferUtils::read<std::int64_t>(buf, offset);
+    return stamp;
+}
+
+/*
+ * SnapshotFile class
+ */
+
+std::optional<SnapshotFile::FileStamp> SnapshotFile::get_file_stamp(const std::filesystem::path& path)
+{
+    return get_file_stamp(std::filesystem::directory_entry(path));
+}
+
+std::optional<SnapshotFile::FileStamp> SnapshotFile::get_file_stamp(const std::filesystem::directory_entry& entry)
+{
+    std::error_code ec;
+    const std::uintmax_t size = entry.file_size(ec);
+    if (ec)
+    {
+        return std::nullopt;
+    }
+    const std::filesystem::file_time_type modified_time = entry.last_write_time(ec);
+    if (ec)
+    {
+        return std::nullopt;
+    }
+
+    return FileStamp { static_cast<std::uint64_t>(size),
+        static_cast<std::int64_t>(modified_time.time_since_epoch().count()) };
+}
+
+SnapshotFile::SnapshotFile(const std::filesystem::path& path)
+{
+    const std::vector<char> data = FileUtils::read_binary_file(path);
+    size_t offset = 0;
+
+    // Header
+    const std::span<const char> file_magic = BufferUtils::read_bytes(data, offset, magic.size());
+    if (std::string_view(file_magic.data(), file_magic.size()) != magic)
+    {
+        throw std::runtime_error("Not a snapshot file");
+    }
+    if (BufferUtils::read<std::uint32_t>(data, offset) != format_version)
+    {
+        throw std::runtime_error("Unsupported snapshot version");
+    }
+    anno_dir = FileUtils::path_from_utf8(read_string(data, offset));
+    text_cod_stamp = read_stamp(data, offset);
+    game_dat_stamp = read_stamp(data, offset);
+
+    // text.cod
+    const auto num_lines = BufferUtils::read<std::uint32_t>(data, offset);
+    campaign_section_lines.reserve(num_lines);
+    for (std::uint32_t i = 0; i < num_lines; ++i)
+    {
+        campaign_section_lines.push_back(read_string(data, offset));
+    }
+
+    // Game.dat
+    main_game_progress = BufferUtils::read<std::int32_t>(data, offset);
+    const auto num_progress_entries = BufferUtils::read<std::uint32_t>(data, offset);
+    campaign_progress.reserve(num_progress_entries);
+    for (std::uint32_t i = 0; i < num_progress_entries; ++i)
+    {
+        campaign_progress.push_back(BufferUtils::read<std::int32_t>(data, offset));
+    }
+
+    // Scenarios
+    const auto num_scenarios = BufferUtils::read<std::uint32_t>(data, offset);
+    scenarios.reserve(num_scenarios);
+    for (std::uint32_t i = 0; i < num_scenarios; ++i)
+    {
+        ScenarioEntry& scenario = scenarios.emplace_back();
+        scenario.filename = read_string(data, offset);
+        scenario.stamp = read_stamp(data, offset);
+        const auto header_size = BufferUtils::read<std::uint32_t>(data, offset);
+        const std::span<const char> header_data = BufferUtils::read_bytes(data, offset, header_size);
+        scenario.header_data.assign(header_data.begin(), header_data.end());
+    }
+
+    if (offset != data.size())
+    {
+        throw std::runtime_error("Unexpected data at end of snapshot");
+    }
+}
+
+void SnapshotFile::save_to_path(const std::filesystem::path& path) const
+{
+    std::vector<char> data;
+    data.reserve(1024 + scenarios.size() * 64);
+
+    // Header
+    data.insert(data.end(), magic.begin(), magic.end());
+    BufferUtils::append(data, format_version);
+    append_string(data, FileUtils::path_to_utf8(anno_dir));
+    append_stamp(data, text_cod_stamp);
+    append_stamp(data, game_dat_stamp);
+
+    // text.cod
+    BufferUtils::append(data, static_cast<std::uint32_t>(campaign_section_lines.size()));
+    for (const auto& line : campaign_section_lines)
+    {
+        append_string(data, line);
+    }
+
+    // Game.dat
+    BufferUtils::append(data, static_cast<std::int32_t>(main_game_progress));
+    BufferUtils::append(data, static_cast<std::uint32_t>(campaign_progress.size()));
+    for (int progress : campaign_progress)
+    {
+        BufferUtils::append(data, static_cast<std::int32_t>(progress));
+    }
+
+    // Scenarios
+    BufferUtils::append(data, static_cast<std::uint32_t>(scenarios.size()));
+    for (const auto& scenario : scenarios)
+    {
+        append_string(data, scenario.filename);
+        append_stamp(data, scenario.stamp);
+        BufferUtils::append(data, static_cast<std::uint32_t>(scenario.header_data.size()));
+        BufferUtils::append(data, scenario.header_data);
+    }
+
+    // Never leave a partial snapshot behind, even if several processes are saving at once
+    FileUtils::replace_binary_file(path, data);
+}
+
+}  // namespace Anno
@@ -1,10 +1,14 @@
 #include "files/text_cod_file.h"
 
+#include <cstring>  // memchr
 #include <fstream>
-#include <sstream>
+#include <span>
 #include <stdexcept>
+#include <utility>  // move
 
+#include "files/cod_codec.h"
 #include "files/file_utils.h"
+#include "util/trace.h"
 
 namespace Anno {
 
@@ -12,102 +16,239 @@ namespace Anno {
  * Helper methods
  */
 
-// Used to transform from encoded `.cod` format to readable ANSI (and vice versa)
-// See: https://github.com/Green-Sky/anno16_docs/blob/master/file_formats/encryption.md
-static void transform_chars(std::vector<char>& buffer)
+static constexpr std::string_view line_break = "\r\n";
+static constexpr std::string_view section_end = "[END]\r\n";
+static constexpr std::string_view separator = "--------------------------------------------------\r\n";
+
+// Encodes a single character, so that we can search the encoded file without decoding it first
+static constexpr char encode_char(char c)
 {
-    for (int i = 0; i < buffer.size(); ++i)
+    return static_cast<char>(-static_cast<unsigned char>(c));
+}
+
+static bool is_encoded_text(std::string_view encoded_text, std::string_view plain_text)
+{
+    if (encoded_text.size() != plain_text.size())
     {
-        buffer[i] = -buffer[i] & 0xff;
+        return false;
+    }
+
+    for (size_t i = 0; i < encoded_text.size(); ++i)
+    {
+        if (encoded_text[i] != encode_char(plain_text[i]))
+        {
+            return false;
+        }
     }
+
+    return true;
 }
 
-static bool is_section_name(const std::string& line)
+static bool is_encoded_section_name(std::string_view encoded_line)
 {
-    return line.starts_with('[') && line.ends_with(']');
+    return encoded_line.size() >= 2  //
+            && encoded_line.front() == encode_char('[')
+            && encoded_line.back() == encode_char(']');
 }
 
-static std::string strip_enclosing_brackets(const std::string& line)
+// Finds the next line break (`cr` followed by `lf`) in the range [start, end), or returns `end` if there is none
+static size_t find_line_break(const char* data, size_t start, size_t end, char cr, char lf)
 {
-    return line.substr(1, line.size() - 2);
+    while (start + 1 < end)
+    {
+        // memchr is typically vectorised, so this is much faster than checking each byte ourselves
+        const void* found = std::memchr(data + start, cr, end - start - 1);
+        if (!found)
+        {
+            break;
+        }
+
+        const size_t pos = static_cast<const char*>(found) - data;
+        if (data[pos + 1] == lf)
+        {
+            return pos;
+        }
+        start = pos + 1;
+    }
+    return end;
 }
 
 /*
  * TextCodFile class
  */
 
-TextCodFile::TextCodFile(const std::filesystem::path& path)
+TextCodFile::TextCodFile(const std::filesystem::path& path, LoadMode load_mode)
     : src_path(path)
 {
     read_cod_file(path);
+
+    if (load_mode == LoadMode::Full)
+    {
+        for (auto& section : sections)
+        {
+            load_section_lines(section);
+        }
+    }
 }
 
 void TextCodFile::read_cod_file(const std::filesystem::path& path)
 {
-    // Read and decode the file
-    std::vector<char> buffer = FileUtils::read_binary_file(path);
-    transform_chars(buffer);
+    const FileUtils::MappedFile file(path, FileUtils::AccessHint::Sequential);
+    parse_cod_data(file.get_bytes());
+}
 
-    // Split the file based on line breaks
-    size_t start = 0;
+void TextCodFile::parse_cod_data(std::span<const char> encoded_data)
+{
+    Trace::Span span("parse", "TextCodFile::parse");
+    span.set_bytes(encoded_data.size());
+
+    // Copy the file into the arena, still encoded
+    arena.assign(encoded_data.begin(), encoded_data.end());
+    source_size = arena.size();
+
+    // Find the sections, without decoding anything other than the section names.
+    // NOTE: The arena must not grow during this loop, since we hold a pointer into it.
+    char* data = arena.data();
+    const size_t size = arena.size();
     int current_section_index = -1;
-    for (size_t i = 0; i < buffer.size() - 1; ++i)
+    size_t start = 0;
+    while (true)
     {
-        // Search for a line break
-        const bool is_eol = (buffer[i] == '\r' && buffer[i + 1] == '\n');
-        if (!is_eol)
+        const size_t eol = find_line_break(data, start, size, encode_char('\r'), encode_char('\n'));
+        if (eol == size)
         {
-            continue;
+            // NOTE: If start < size then it means the buffer ended with a non-terminated line which we did not
+            // process. We ignore this for now as it doesn't matter in practice.
+            if (current_section_index >= 0)
+            {
+                // Section was never closed, so it extends up to the last line we processed
+                auto& section = sections[current_section_index];
+                section.source_range->length = start - section.source_range->offset;
+                section.source_body.length = start - section.source_body.offset;
+            }
+            break;
         }
 
         // We have found a line!
-        // We subtract 1 from the length here to exclude the '\n' character.
-        const size_t num_chars = i - start;
-        std::string line(buffer.data() + start, num_chars);
+        const std::string_view encoded_line(data + start, eol - start);
+        const size_t next_line_start = eol + line_break.length();
 
         // Are we inside a section?
         if (current_section_index >= 0)
         {
-            if (line == "[END]")
+            if (is_encoded_text(encoded_line, "[END]"))
             {
                 // End of section
-                current_section_index = -1;
-            }
-            else
-            {
-                // Line found inside a section.
-                // NOTE: Lines outside of a section are skipped (these are typically separators).
                 auto& section = sections[current_section_index];
-                section.lines.push_back(line);
+                section.source_range->length = next_line_start - section.source_range->offset;
+                section.source_body.length = next_line_start - section.source_body.offset;
+                current_section_index = -1;
             }
+            // NOTE: Lines inside a section are split when the section is loaded.
         }
-        else if (is_section_name(line))
+        else if (is_encoded_section_name(encoded_line))
         {
-            std::string section_name = strip_enclosing_brackets(line);
-            current_section_index = add_new_section(section_name);
+            // Decode the section name line (including its line break) and strip the enclosing brackets
+            CodCodec::transform_in_place({ data + start, next_line_start - start });
+            current_section_index = add_new_section({ start + 1, encoded_line.size() - 2 });
+
+            auto& section = sections[current_section_index];
+            section.source_range = TextRange { start, 0 };
+            section.source_body = TextRange { next_line_start, 0 };
         }
+        // NOTE: Lines outside of a section are skipped (these are typically separators).
 
         // Skip past the EOL characters to the next line
-        start = i + 2;
+        start = next_line_start;
     }
+}
+
+void TextCodFile::load_section_lines(TextCodSection& section)
+{
+    if (section.are_lines_loaded)
+    {
+        return;
+    }
+
+    section.are_lines_loaded = true;
+    section.first_line = lines.size();
+    section.num_lines = 0;
+
+    if (!section.source_range.has_value())
+    {
+        // New section; nothing to read
+        return;
+    }
+
+    // Decode the section in place
+    const TextRange& body = section.source_body;
+    Trace::Span span("parse", "TextCodFile::load_section_lines");
+    span.set_bytes(body.length);
+    if (!section.is_body_decoded)
+    {
+        CodCodec::transform_in_place({ arena.data() + body.offset, body.length });
+        section.is_body_decoded = true;
+    }
+
+    // Split the section based on line breaks
+    const char* data = arena.data();
+    const size_t end = body.offset + body.length;
+    size_t start = body.offset;
+    while (true)
+    {
+        const size_t eol = find_line_break(data, start, end, '\r', '\n');
+        if (eol == end)
+        {
+            break;
+        }
+
+        const TextRange line_range { start, eol - start };
+        if (get_text(line_range) == "[END]")
+        {
+            break;
+        }
+
+        lines.push_back(line_range);
+        ++section.num_lines;
 
-    // NOTE: If start < buffer.size() then it means the buffer ended with a non-terminated line which we did not
-    // process. We ignore this for now as it doesn't matter in practice.
+        // Skip past the EOL characters to the next line
+        start = eol + line_break.length();
+    }
 }
 
-int TextCodFile::add_new_section(std::string_view section_name)
+int TextCodFile::add_new_section(TextRange section_name)
 {
-    sections.emplace_back(std::string(section_name));
+    // New sections always start at the end of the line list
+    TextCodSection& section = sections.emplace_back();
+    section.name = section_name;
+    section.first_line = lines.size();
     int section_index = static_cast<int>(sections.size()) - 1;
-    section_map.emplace(std::string(section_name), section_index);
+    section_map.emplace(std::string(get_text(section_name)), section_index);
     return section_index;
 }
 
+TextCodFile::TextRange TextCodFile::append_to_arena(std::string_view text)
+{
+    const TextRange range { arena.size(), text.size() };
+    arena.insert(arena.end(), text.begin(), text.end());
+    return range;
+}
+
+std::string_view TextCodFile::get_text(TextRange range) const
+{
+    return { arena.data() + range.offset, range.length };
+}
+
 void TextCodFile::save_overwrite()
 {
     save_encoded(src_path);
 }
 
+void TextCodFile::stage_overwrite(FileTransaction& transaction) const
+{
+    transaction.stage_file(src_path, make_buffer(true));
+}
+
 void TextCodFile::save_plain_text(const std::filesystem::path& path)
 {
     std::vector<char> data = make_buffer(false);
@@ -120,37 +261,126 @@ void TextCodFile::save_encoded(const std::filesystem::path& path)
     FileUtils::write_binary_file(path, data);
 }
 
+size_t TextCodFile::get_serialized_size(const TextCodSection& section) const
+{
+    // "[NAME]\r\n"
+    size_t size = section.name.length + 2 + line_break.length();
+
+    for (size_t i = 0; i < section.num_lines; ++i)
+    {
+        size += lines[section.first_line + i].length + line_break.length();
+    }
+
+    return size + section_end.length();
+}
+
 std::vector<char> TextCodFile::make_buffer(bool should_encode_chars) const
 {
-    std::ostringstream oss;
+    Trace::Span span("parse", "TextCodFile::make_buffer");
+
+    // Unchanged parts of the original file are reused as-is, so the sizes of these are already known.
+    // Everything else is measured up front, so that the output can be allocated exactly once.
+    size_t total_size = source_size;
+    if (source_size == 0)
+    {
+        total_size += separator.length();
+    }
+    for (const auto& section : sections)
+    {
+        if (!section.source_range.has_value())
+        {
+            // New section, plus the separator that follows it
+            total_size += get_serialized_size(section) + separator.length();
+        }
+        else if (section.is_dirty)
+        {
+            total_size += get_serialized_size(section) - section.source_range->length;
+        }
+    }
+
+    std::vector<char> data(total_size);
+    size_t write_pos = 0;
 
-    oss << "--------------------------------------------------\r\n";
+    // Copies text into the output, encoding or decoding it on the way if required
+    auto emit = [&](std::string_view text, bool is_text_encoded = false) {
+        const std::span<char> dst(data.data() + write_pos, text.size());
+        if (should_encode_chars != is_text_encoded)
+        {
+            CodCodec::transform(text, dst);
+        }
+        else
+        {
+            std::memcpy(dst.data(), text.data(), text.size());
+        }
+        write_pos += text.size();
+    };
+
+    auto emit_section = [&](const TextCodSection& section) {
+        emit("[");
+        emit(get_text(section.name));
+        emit("]");
+        emit(line_break);
+        for (size_t i = 0; i < section.num_lines; ++i)
+        {
+            emit(get_text(lines[section.first_line + i]));
+            emit(line_break);
+        }
+        emit(section_end);
+    };
 
+    // Splice the modified sections in between the untouched spans of the original file.
+    // Anything outside of a section was never decoded.
+    size_t read_pos = 0;
     for (const auto& section : sections)
     {
-        oss << "[" << section.name << "]\r\n";
+        if (!section.source_range.has_value())
+        {
+            continue;
+        }
 
-        for (const auto& line : section.lines)
+        const TextRange& source_range = *section.source_range;
+        emit(get_text({ read_pos, source_range.offset - read_pos }), /* is_text_encoded */ true);
+
+        if (section.is_dirty)
+        {
+            emit_section(section);
+        }
+        else
         {
-            oss << line << "\r\n";
+            // The section name was decoded when the file was read, but the body might not have been
+            const TextRange& body = section.source_body;
+            emit(get_text({ source_range.offset, body.offset - source_range.offset }));
+            emit(get_text(body), !section.is_body_decoded);
         }
 
-        oss << "[END]\r\n"
-               "--------------------------------------------------\r\n";
+        read_pos = source_range.offset + source_range.length;
     }
+    emit(get_text({ read_pos, source_size - read_pos }), /* is_text_encoded */ true);
 
-    std::string temp = oss.str();
-    std::vector<char> data(temp.begin(), temp.end());
-
-    if (should_encode_chars)
+    // Append any new sections
+    if (source_size == 0)
     {
-        transform_chars(data);
+        emit(separator);
+    }
+    for (const auto& section : sections)
+    {
+        if (!section.source_range.has_value())
+        {
+            emit_section(section);
+            emit(separator);
+        }
     }
 
     return data;
 }
 
-std::vector<std::string> TextCodFile::get_section_contents(std::string_view section_name) const
+std::vector<std::string> TextCodFile::get_section_contents(std::string_view section_name)
+{
+    const std::vector<std::string_view> section_lines = get_section_lines(section_name);
+    return { section_lines.begin(), section_lines.end() };
+}
+
+std::vector<std::string_view> TextCodFile::get_section_lines(std::string_view section_name)
 {
     const auto it = section_map.find(section_name);
     if (it == section_map.cend())
@@ -159,11 +389,19 @@ std::vector<std::string> TextCodFile::get_section_contents(std::string_view sect
         return {};
     }
 
-    int section_index = it->second;
-    return sections[section_index].lines;
+    auto& section = sections[it->second];
+    load_section_lines(section);
+
+    std::vector<std::string_view> section_lines;
+    section_lines.reserve(section.num_lines);
+    for (size_t i = 0; i < section.num_lines; ++i)
+    {
+        section_lines.push_back(get_text(lines[section.first_line + i]));
+    }
+    return section_lines;
 }
 
-void TextCodFile::set_section_contents(std::string_view section_name, std::vector<std::string> lines)
+void TextCodFile::set_section_contents(std::string_view section_name, std::vector<std::string> new_lines)
 {
     int section_index = -1;
 
@@ -171,14 +409,91 @@ void TextCodFile::set_section_contents(std::string_view section_name, std::vecto
     if (it == section_map.cend())
     {
         // Section not found
-        section_index = add_new_section(section_name);
+        section_index = add_new_section(append_to_arena(section_name));
     }
     else
     {
         section_index = it->second;
     }
 
-    sections[section_index].lines = lines;
+    // The old lines are abandoned, and the new lines are appended to the end of the arena and line list
+    auto& section = sections[section_index];
+    abandon_section_lines(section);
+    if (num_abandoned_bytes > arena.size() - source_size - num_abandoned_bytes
+            || num_abandoned_lines > lines.size() - num_abandoned_lines)
+    {
+        // Most of what we have appended is garbage by now; this keeps the arena from growing forever when the same
+        // sections are modified over and over (e.g. in a long-lived process)
+        compact_arena();
+    }
+
+    section.first_line = lines.size();
+    section.num_lines = new_lines.size();
+    section.are_lines_loaded = true;
+    section.is_dirty = true;
+    for (const auto& line : new_lines)
+    {
+        lines.push_back(append_to_arena(line));
+    }
+}
+
+void TextCodFile::abandon_section_lines(TextCodSection& section)
+{
+    if (!section.are_lines_loaded)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < section.num_lines; ++i)
+    {
+        const TextRange& line = lines[section.first_line + i];
+        if (line.offset >= source_size)
+        {
+            // Lines within the original file are part of the arena either way
+            num_abandoned_bytes += line.length;
+        }
+    }
+    num_abandoned_lines += section.num_lines;
+    section.num_lines = 0;
+}
+
+void TextCodFile::compact_arena()
+{
+    Trace::Span span("parse", "TextCodFile::compact_arena");
+
+    // The original file stays where it is, since the section bodies still refer to it; anything appended since is
+    // kept only if it is still in use
+    std::vector<char> appended;
+    std::vector<TextRange> new_lines;
+    const auto keep = [&](TextRange range) -> TextRange {
+        if (range.offset < source_size)
+        {
+            return range;
+        }
+        const TextRange new_range { source_size + appended.size(), range.length };
+        const std::string_view text = get_text(range);
+        appended.insert(appended.end(), text.begin(), text.end());
+        return new_range;
+    };
+
+    for (auto& section : sections)
+    {
+        section.name = keep(section.name);
+
+        const size_t first_line = section.first_line;
+        section.first_line = new_lines.size();
+        for (size_t i = 0; i < section.num_lines; ++i)
+        {
+            new_lines.push_back(keep(lines[first_line + i]));
+        }
+    }
+
+    span.set_bytes(arena.size() - source_size);
+    arena.resize(source_size);
+    arena.insert(arena.end(), appended.begin(), appended.end());
+    lines = std::move(new_lines);
+    num_abandoned_bytes = 0;
+    num_abandoned_lines = 0;
 }
 
 }  // namespace Anno
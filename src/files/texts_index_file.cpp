@@ -0,0 +1,178 @@
+#include "files/texts_index_file.h"
+
+#include <algorithm>  // max
+#include <bit>  // bit_ceil, has_single_bit
+#include <cstring>  // memcpy
+#include <limits>
+#include <stdexcept>
+
+#include "util/buffer_utils.h"
+
+namespace Anno {
+
+/*
+ * TextsIndexFile class
+ */
+
+TextsIndexFile::TextsIndexFile(const std::filesystem::path& path)
+    : file(std::in_place, path, FileUtils::AccessHint::Random)
+    , data(file->get_bytes())
+{
+    read_header();
+}
+
+TextsIndexFile::TextsIndexFile(const SnapshotFile::FileStamp& source_stamp,
+        const std::vector<std::pair<std::uint32_t, std::string>>& texts)
+{
+    // Keep the table at most half full, so that probe sequences stay short
+    const size_t new_num_slots = std::bit_ceil(std::max<size_t>(texts.size() * 2, 16));
+
+    size_t new_strings_size = 0;
+    for (const auto& [id, text] : texts)
+    {
+        new_strings_size += text.size();
+    }
+    if (new_strings_size > std::numeric_limits<std::uint32_t>::max())
+    {
+        throw std::runtime_error("Too much text to index");
+    }
+
+    // Header
+    built_data.reserve(magic.size() + 64 + new_num_slots * slot_size + new_strings_size);
+    built_data.insert(built_data.end(), magic.begin(), magic.end());
+    BufferUtils::append(built_data, format_version);
+    BufferUtils::append(built_data, source_stamp.size);
+    BufferUtils::append(built_data, source_stamp.modified_time);
+    BufferUtils::append(built_data, static_cast<std::uint64_t>(new_num_slots));
+    const size_t num_texts_offset = built_data.size();
+    BufferUtils::append(built_data, static_cast<std::uint64_t>(0));  // filled in below
+    BufferUtils::append(built_data, static_cast<std::uint64_t>(new_strings_size));
+
+    // Slots
+    const size_t new_slots_offset = built_data.size();
+    for (size_t i = 0; i < new_num_slots; ++i)
+    {
+        BufferUtils::append(built_data, static_cast<std::uint32_t>(0));
+        BufferUtils::append(built_data, static_cast<std::uint32_t>(0));
+        BufferUtils::append(built_data, empty_slot_length);
+    }
+
+    // Strings
+    const size_t new_strings_offset = built_data.size();
+    std::uint64_t new_num_texts = 0;
+    for (const auto& [id, text] : texts)
+    {
+        const auto string_offset = static_cast<std::uint32_t>(built_data.size() - new_strings_offset);
+        built_data.insert(built_data.end(), text.begin(), text.end());
+
+        // Linear probing; an existing slot for the same key is simply replaced
+        const size_t slot_mask = new_num_slots - 1;
+        for (size_t slot_index = get_slot_index(id, new_num_slots);; slot_index = (slot_index + 1) & slot_mask)
+        {
+            char* slot = built_data.data() + new_slots_offset + slot_index * slot_size;
+            std::uint32_t slot_values[3];
+            std::memcpy(slot_values, slot, slot_size);
+            if (slot_values[2] != empty_slot_length && slot_values[0] != id)
+            {
+                continue;
+            }
+
+            if (slot_values[2] == empty_slot_length)
+            {
+                ++new_num_texts;
+            }
+            slot_values[0] = id;
+            slot_values[1] = string_offset;
+            slot_values[2] = static_cast<std::uint32_t>(text.size());
+            std::memcpy(slot, slot_values, slot_size);
+            break;
+        }
+    }
+    std::memcpy(built_data.data() + num_texts_offset, &new_num_texts, sizeof(new_num_texts));
+
+    data = built_data;
+    read_header();
+}
+
+size_t TextsIndexFile::get_slot_index(std::uint32_t id, size_t num_slots)
+{
+    // Keys tend to be consecutive, so mix the bits before picking a slot
+    std::uint32_t hash = id * 0x9E3779B1u;
+    hash ^= hash >> 16;
+    return hash & (num_slots - 1);
+}
+
+void TextsIndexFile::read_header()
+{
+    size_t offset = 0;
+
+    const std::span<const char> file_magic = BufferUtils::read_bytes(data, offset, magic.size());
+    if (std::string_view(file_magic.data(), file_magic.size()) != magic)
+    {
+        throw std::runtime_error("Not a localization index");
+    }
+    if (BufferUtils::read<std::uint32_t>(data, offset) != format_version)
+    {
+        throw std::runtime_error("Unsupported localization index version");
+    }
+    source_stamp.size = BufferUtils::read<std::uint64_t>(data, offset);
+    source_stamp.modified_time = BufferUtils::read<std::int64_t>(data, offset);
+    const auto file_num_slots = BufferUtils::read<std::uint64_t>(data, offset);
+    const auto file_num_texts = BufferUtils::read<std::uint64_t>(data, offset);
+    const auto file_strings_size = BufferUtils::read<std::uint64_t>(data, offset);
+
+    // Check the size up front, so that lookups can't go out of bounds
+    if (file_num_slots == 0 || !std::has_single_bit(file_num_slots) || file_num_texts >= file_num_slots
+            || file_num_slots > (data.size() - offset) / slot_size
+            || file_strings_size != data.size() - offset - file_num_slots * slot_size)
+    {
+        throw std::runtime_error("Localization index is corrupted");
+    }
+
+    num_slots = static_cast<size_t>(file_num_slots);
+    num_texts = static_cast<size_t>(file_num_texts);
+    slots_offset = offset;
+    strings_offset = offset + num_slots * slot_size;
+    strings_size = static_cast<size_t>(file_strings_size);
+}
+
+void TextsIndexFile::save_to_path(const std::filesystem::path& path) const
+{
+    // A reader must never see a partial index, since the file is trusted once its header checks out
+    FileUtils::replace_binary_file(path, data);
+}
+
+std::optional<std::string_view> TextsIndexFile::find_text(std::uint32_t id) const
+{
+    if (num_slots == 0)
+    {
+        return std::nullopt;
+    }
+
+    // A valid index always has an empty slot to stop at, but a corrupted one might not, so never go round twice
+    size_t slot_index = get_slot_index(id, num_slots);
+    for (size_t num_probes = 0; num_probes < num_slots; ++num_probes, slot_index = (slot_index + 1) & (num_slots - 1))
+    {
+        std::uint32_t slot_values[3];
+        std::memcpy(slot_values, data.data() + slots_offset + slot_index * slot_size, slot_size);
+        if (slot_values[2] == empty_slot_length)
+        {
+            return std::nullopt;
+        }
+        if (slot_values[0] != id)
+        {
+            continue;
+        }
+
+        if (slot_values[1] > strings_size || slot_values[2] > strings_size - slot_values[1])
+        {
+            // Corrupted; treat it as missing rather than reading out of bounds
+            return std::nullopt;
+        }
+        return std::string_view(data.data() + strings_offset + slot_values[1], slot_values[2]);
+    }
+
+    return std::nullopt;
+}
+
+}  // namespace Anno
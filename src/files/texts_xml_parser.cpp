@@ -0,0 +1,395 @@
+#include "files/texts_xml_parser.h"
+
+#include <algorithm>  // equal, find_if
+#include <cctype>  // isspace, tolower
+#include <charconv>  // from_chars
+#include <stdexcept>
+#include <utility>  // move, pair
+
+#include "util/text_encoding.h"
+
+namespace Anno {
+
+/*
+ * Helper methods
+ */
+
+static constexpr std::string_view utf8_bom = "\xEF\xBB\xBF";
+
+static bool is_space(char c)
+{
+    return std::isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+static std::string_view trim(std::string_view text)
+{
+    while (!text.empty() && is_space(text.front()))
+    {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && is_space(text.back()))
+    {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+static bool equals_ignore_case(std::string_view a, std::string_view b)
+{
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) {
+        return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+    });
+}
+
+static bool is_id_name(std::string_view name)
+{
+    return equals_ignore_case(name, "GUID") || equals_ignore_case(name, "LineId") || equals_ignore_case(name, "Id");
+}
+
+static bool is_text_name(std::string_view name)
+{
+    return equals_ignore_case(name, "Text") || equals_ignore_case(name, "Value");
+}
+
+static std::optional<std::uint32_t> parse_id(std::string_view text)
+{
+    text = trim(text);
+    std::uint32_t id = 0;
+    const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), id);
+    if (ec != std::errc() || end != text.data() + text.size() || text.empty())
+    {
+        return std::nullopt;
+    }
+    return id;
+}
+
+// Appends character data to `out`, replacing any entity references
+static void append_character_data(std::string& out, std::string_view text)
+{
+    while (!text.empty())
+    {
+        const size_t amp_pos = text.find('&');
+        out.append(text.substr(0, amp_pos));
+        if (amp_pos == std::string_view::npos)
+        {
+            return;
+        }
+        text.remove_prefix(amp_pos);
+
+        const size_t semicolon_pos = text.find(';');
+        const std::string_view name =
+                (semicolon_pos == std::string_view::npos) ? std::string_view() : text.substr(1, semicolon_pos - 1);
+
+        std::optional<std::uint32_t> code_point;
+        if (name == "lt")
+        {
+            code_point = '<';
+        }
+        else if (name == "gt")
+        {
+            code_point = '>';
+        }
+        else if (name == "amp")
+        {
+            code_point = '&';
+        }
+        else if (name == "quot")
+        {
+            code_point = '"';
+        }
+        else if (name == "apos")
+        {
+            code_point = '\'';
+        }
+        else if (name.size() > 1 && name[0] == '#')
+        {
+            const bool is_hex = (name[1] == 'x' || name[1] == 'X');
+            const std::string_view digits = name.substr(is_hex ? 2 : 1);
+            std::uint32_t value = 0;
+            const int base = is_hex ? 16 : 10;
+            const auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), value, base);
+            if (ec == std::errc() && end == digits.data() + digits.size() && !digits.empty() && value <= 0x10FFFF)
+            {
+                code_point = value;
+            }
+        }
+
+        if (!code_point.has_value())
+        {
+            // Not something we understand, so leave it as it is
+            out.push_back('&');
+            text.remove_prefix(1);
+            continue;
+        }
+
+        TextEncoding::append_utf8(out, *code_point);
+        text.remove_prefix(semicolon_pos + 1);
+    }
+}
+
+// Finds the end of the markup starting at `start` (just past the closing '>'), or npos if it is incomplete
+static size_t find_markup_end(std::string_view data, size_t start)
+{
+    const std::string_view markup = data.substr(start);
+
+    // Make sure there is enough data to tell what kind of markup this is
+    static constexpr std::string_view cdata_start = "<![CDATA[";
+    if (markup.size() < cdata_start.size() && markup.starts_with("<!"))
+    {
+        return std::string_view::npos;
+    }
+
+    std::string_view terminator;
+    if (markup.starts_with("<!--"))
+    {
+        terminator = "-->";
+    }
+    else if (markup.starts_with(cdata_start))
+    {
+        terminator = "]]>";
+    }
+    else if (markup.starts_with("<?"))
+    {
+        terminator = "?>";
+    }
+
+    if (!terminator.empty())
+    {
+        const size_t terminator_pos = markup.find(terminator, 2);
+        return (terminator_pos == std::string_view::npos) ? terminator_pos
+                                                           : start + terminator_pos + terminator.size();
+    }
+
+    // A tag ends at the first '>' that is not part of an attribute value
+    char quote = '\0';
+    for (size_t i = 1; i < markup.size(); ++i)
+    {
+        const char c = markup[i];
+        if (quote != '\0')
+        {
+            if (c == quote)
+            {
+                quote = '\0';
+            }
+        }
+        else if (c == '"' || c == '\'')
+        {
+            quote = c;
+        }
+        else if (c == '>')
+        {
+            return start + i + 1;
+        }
+    }
+    return std::string_view::npos;
+}
+
+// Finds the key given by an attribute of a start tag, if any
+static std::optional<std::uint32_t> find_attribute_id(std::string_view attributes)
+{
+    while (true)
+    {
+        attributes = trim(attributes);
+        const size_t equals_pos = attributes.find('=');
+        if (equals_pos == std::string_view::npos)
+        {
+            return std::nullopt;
+        }
+        const std::string_view name = trim(attributes.substr(0, equals_pos));
+        attributes = trim(attributes.substr(equals_pos + 1));
+
+        if (attributes.empty() || (attributes[0] != '"' && attributes[0] != '\''))
+        {
+            throw std::runtime_error("Malformed attribute in texts.xml");
+        }
+        const size_t value_end = attributes.find(attributes[0], 1);
+        if (value_end == std::string_view::npos)
+        {
+            throw std::runtime_error("Malformed attribute in texts.xml");
+        }
+        const std::string_view value = attributes.substr(1, value_end - 1);
+        attributes.remove_prefix(value_end + 1);
+
+        if (is_id_name(name))
+        {
+            return parse_id(value);
+        }
+    }
+}
+
+// Splits the contents of a tag into its name and attributes
+static std::pair<std::string_view, std::string_view> split_tag(std::string_view tag)
+{
+    const auto name_end = std::find_if(tag.begin(), tag.end(), is_space);
+    const size_t name_length = name_end - tag.begin();
+    return { tag.substr(0, name_length), tag.substr(name_length) };
+}
+
+/*
+ * TextsXmlParser class
+ */
+
+TextsXmlParser::TextsXmlParser(TextHandler on_text)
+    : on_text(std::move(on_text))
+{
+}
+
+void TextsXmlParser::parse(std::span<const char> data)
+{
+    pending.append(data.begin(), data.end());
+
+    if (is_start)
+    {
+        // Wait until we can see the byte order mark (if any)
+        if (pending.size() < utf8_bom.size())
+        {
+            return;
+        }
+        if (pending.starts_with("\xFF\xFE") || pending.starts_with("\xFE\xFF"))
+        {
+            throw std::runtime_error("texts.xml must be encoded as UTF-8");
+        }
+        if (pending.starts_with(utf8_bom))
+        {
+            pending.erase(0, utf8_bom.size());
+        }
+        is_start = false;
+    }
+
+    size_t pos = 0;
+    while (true)
+    {
+        // Character data can only be handled once we know where it ends
+        const size_t markup_start = pending.find('<', pos);
+        if (markup_start == std::string::npos)
+        {
+            break;
+        }
+        append_character_data(current_text, std::string_view(pending).substr(pos, markup_start - pos));
+        pos = markup_start;
+
+        const size_t markup_end = find_markup_end(pending, markup_start);
+        if (markup_end == std::string::npos)
+        {
+            break;
+        }
+        parse_markup(std::string_view(pending).substr(markup_start, markup_end - markup_start));
+        pos = markup_end;
+    }
+
+    pending.erase(0, pos);
+}
+
+void TextsXmlParser::finish()
+{
+    if (is_start)
+    {
+        // Document was too short to have a byte order mark
+        is_start = false;
+        parse({});
+    }
+
+    if (!trim(pending).empty() || depth != 0)
+    {
+        throw std::runtime_error("texts.xml ends unexpectedly");
+    }
+}
+
+void TextsXmlParser::parse_markup(std::string_view markup)
+{
+    if (markup.starts_with("<![CDATA["))
+    {
+        current_text.append(markup.substr(9, markup.size() - 12));
+        return;
+    }
+
+    if (markup.starts_with("<!") || markup.starts_with("<?"))
+    {
+        // Comments, declarations and processing instructions
+        return;
+    }
+
+    if (markup.starts_with("</"))
+    {
+        end_element(trim(markup.substr(2, markup.size() - 3)));
+        return;
+    }
+
+    if (markup.ends_with("/>"))
+    {
+        const std::string_view tag = markup.substr(1, markup.size() - 3);
+        start_element(tag);
+        end_element(split_tag(tag).first);
+        return;
+    }
+
+    start_element(markup.substr(1, markup.size() - 2));
+}
+
+void TextsXmlParser::start_element(std::string_view tag)
+{
+    const auto [name, attributes] = split_tag(tag);
+    if (name.empty())
+    {
+        throw std::runtime_error("Malformed tag in texts.xml");
+    }
+
+    ++depth;
+    current_text.clear();
+    current_has_children = false;
+    current_attribute_id = find_attribute_id(attributes);
+    if (current_attribute_id.has_value())
+    {
+        record_id = current_attribute_id;
+    }
+}
+
+void TextsXmlParser::end_element(std::string_view name)
+{
+    if (depth == 0)
+    {
+        throw std::runtime_error("Unexpected end tag in texts.xml");
+    }
+    --depth;
+
+    if (!current_has_children)
+    {
+        // Leaf elements hold the parts of a record
+        if (is_id_name(name))
+        {
+            record_id = parse_id(current_text);
+        }
+        else if (is_text_name(name))
+        {
+            record_text = std::move(current_text);
+
+            // An element with the key as an attribute is a complete record by itself
+            if (current_attribute_id.has_value())
+            {
+                emit_record();
+            }
+        }
+    }
+    else
+    {
+        // The end of any other element is the end of a record
+        emit_record();
+    }
+
+    // Whatever comes next, the parent element now has children
+    current_text.clear();
+    current_has_children = true;
+    current_attribute_id.reset();
+}
+
+void TextsXmlParser::emit_record()
+{
+    if (record_id.has_value() && record_text.has_value())
+    {
+        on_text(*record_id, *record_text);
+    }
+    record_id.reset();
+    record_text.reset();
+}
+
+}  // namespace Anno
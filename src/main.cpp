@@ -1,13 +1,20 @@
 #include <boost/optional.hpp>
 #include <boost/program_options.hpp>
 
+#include <algorithm>  // all_of
 #include <filesystem>
 #include <iostream>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include "files/file_utils.h"
 #include "tool/config.h"
+#include "tool/fleet.h"
+#include "tool/server.h"
 #include "tool/tool.h"
+#include "tool/watcher.h"
+#include "util/trace.h"
 
 namespace po = boost::program_options;
 
@@ -23,24 +30,15 @@ static bool check_anno_installation(Config& cfg, boost::optional<std::string> an
         return false;
     }
 
-    std::filesystem::path anno_dir_path = std::filesystem::path(*anno_dir);
-
-    // Check for the original game
-    if (std::filesystem::exists(anno_dir_path / "1602.exe"))
-    {
-        std::cout << "Found Anno 1602 installation\n\n";
-        cfg.anno_dir = *anno_dir;
-        cfg.user_dir = *anno_dir;
-        return true;
-    }
-
-    // Check for the History Edition
-    if (std::filesystem::exists(anno_dir_path / "Anno1602.exe"))
+    const std::filesystem::path anno_dir_path = std::filesystem::path(*anno_dir);
+    const auto version = detect_game_version(anno_dir_path);
+    if (version.has_value())
     {
-        std::cout << "Found Anno 1602 History Edition installation\n\n";
-        cfg.anno_dir = *anno_dir;
-        cfg.user_dir = FileUtils::get_documents_folder() / "Anno 1602 History Edition";
-        cfg.version = GameVersion::HistoryEdition;
+        std::cout << (*version == GameVersion::Original ? "Found Anno 1602 installation\n\n"
+                                                        : "Found Anno 1602 History Edition installation\n\n");
+        cfg.anno_dir = anno_dir_path;
+        cfg.user_dir = get_default_user_dir(anno_dir_path, *version);
+        cfg.version = *version;
         return true;
     }
 
@@ -53,17 +51,16 @@ static void list_installed_campaigns(const Tool& tool)
 {
     std::cout << "Installed campaigns:\n\n";
 
-    const auto installed_campaigns = tool.get_installed_campaigns();
+    const auto installed_campaigns = tool.list_campaigns();
     if (installed_campaigns.empty())
     {
         std::cout << "None\n";
         return;
     }
 
-    for (int i = 0; i < installed_campaigns.size(); ++i)
+    for (const auto& [index, campaign, progress] : installed_campaigns)
     {
-        const auto& campaign = installed_campaigns[i];
-        std::cout << "  " << campaign.name << " (Progress = " << tool.get_campaign_progress(i) << ")\n";
+        std::cout << "  " << campaign.name << " (Progress = " << progress << ")\n";
         for (const auto& level_name : campaign.level_names)
         {
             std::cout << "    " << level_name << '\n';
@@ -92,47 +89,233 @@ static Campaign read_campaign_definition(const std::filesystem::path& path)
     return campaign;
 }
 
-static void install_campaign(Tool& tool, const po::variables_map& vm)
+static std::vector<std::filesystem::path> read_campaign_manifest(const std::filesystem::path& path)
+{
+    std::vector<std::filesystem::path> campaign_paths;
+
+    std::vector<std::string> lines = FileUtils::read_text_file(path);
+    for (const auto& line : lines)
+    {
+        if (line.empty())
+        {
+            // Ignore blank lines
+            continue;
+        }
+
+        // Relative paths are relative to the manifest itself
+        campaign_paths.push_back(path.parent_path() / line);
+    }
+
+    return campaign_paths;
+}
+
+static std::vector<Campaign> read_requested_campaigns(const po::variables_map& vm)
+{
+    std::vector<std::filesystem::path> campaign_paths;
+    if (vm.count("input-file"))
+    {
+        for (const auto& input_filename : vm["input-file"].as<std::vector<std::string>>())
+        {
+            campaign_paths.emplace_back(input_filename);
+        }
+    }
+    if (vm.count("manifest"))
+    {
+        const auto manifest_paths = read_campaign_manifest(vm["manifest"].as<std::string>());
+        campaign_paths.insert(campaign_paths.end(), manifest_paths.begin(), manifest_paths.end());
+    }
+
+    std::vector<Campaign> campaigns;
+    for (const auto& campaign_path : campaign_paths)
+    {
+        campaigns.push_back(read_campaign_definition(campaign_path));
+    }
+
+    return campaigns;
+}
+
+static bool install_campaigns(Tool& tool, const po::variables_map& vm)
+{
+    return tool.install_campaigns(read_requested_campaigns(vm));
+}
+
+static std::vector<Campaign> read_campaign_names(const po::variables_map& vm)
+{
+    std::vector<Campaign> campaigns;
+    for (const auto& campaign_name : vm["input-file"].as<std::vector<std::string>>())
+    {
+        campaigns.emplace_back(campaign_name);
+    }
+    return campaigns;
+}
+
+static bool uninstall_campaigns(Tool& tool, const po::variables_map& vm)
+{
+    return tool.uninstall_campaigns(read_campaign_names(vm));
+}
+
+static void set_progress(Tool& tool, const po::variables_map& vm)
 {
-    std::string input_filename = vm["input-file"].as<std::string>();
-    std::filesystem::path campaign_path = std::filesystem::path(input_filename);
-    Campaign campaign = read_campaign_definition(campaign_path);
+    const int progress = vm["set-progress"].as<int>();
+    if (vm.count("campaign"))
+    {
+        tool.set_campaign_progress(vm["campaign"].as<int>(), progress);
+    }
+    else
+    {
+        tool.set_main_game_progress(progress);
+    }
+    tool.save_player_data();
 
-    tool.install_campaign(campaign);
+    std::cout << "Progress saved\n";
+}
+
+static void watch_for_changes(Tool& tool, const Config& cfg)
+{
+    Watcher watcher(tool, cfg);
+    std::cout << "Watching for changes...\n" << std::flush;
+    watcher.run(std::cout);
+}
+
+static void serve_requests(Tool& tool, const po::variables_map& vm, std::ostream& response_stream)
+{
+    Server server(tool);
+
+    if (vm.count("socket"))
+    {
+        const std::filesystem::path socket_path = vm["socket"].as<std::string>();
+        std::cout << "Listening on " << socket_path.string() << "...\n" << std::flush;
+        server.serve_socket(socket_path);
+        return;
+    }
+
+    server.serve_stream(std::cin, response_stream);
+}
+
+static void print_fleet_results(const std::vector<FleetResult>& results, bool list_campaigns)
+{
+    size_t num_failures = 0;
+
+    std::cout << "Fleet results:\n\n";
+    for (const auto& result : results)
+    {
+        std::cout << "  " << result.anno_dir.string() << ": ";
+        if (result.success)
+        {
+            std::cout << "OK (" << result.installed_campaigns.size() << " campaigns, " << result.duration.count()
+                      << " ms)\n";
+        }
+        else
+        {
+            std::cout << "FAILED (" << result.error << ")\n";
+            ++num_failures;
+        }
+
+        if (list_campaigns)
+        {
+            for (const auto& [index, campaign, progress] : result.installed_campaigns)
+            {
+                std::cout << "    " << campaign.name << " (Progress = " << progress << ")\n";
+            }
+        }
+    }
+
+    std::cout << '\n' << (results.size() - num_failures) << " succeeded, " << num_failures << " failed\n";
+}
+
+static bool run_fleet(const po::variables_map& vm, int num_jobs)
+{
+    const auto installs = Fleet::read_manifest(vm["fleet"].as<std::string>());
+
+    FleetOperation operation;
+    if (vm.count("install-campaign"))
+    {
+        operation.type = FleetOperation::Type::InstallCampaigns;
+        operation.campaigns = read_requested_campaigns(vm);
+    }
+    else if (vm.count("uninstall-campaign"))
+    {
+        operation.type = FleetOperation::Type::UninstallCampaigns;
+        operation.campaigns = read_campaign_names(vm);
+    }
+    else if (vm.count("compact-campaigns"))
+    {
+        operation.type = FleetOperation::Type::CompactCampaigns;
+    }
+    else if (vm.count("set-progress"))
+    {
+        operation.type = FleetOperation::Type::SetProgress;
+        operation.progress = vm["set-progress"].as<int>();
+        operation.campaign_index = vm.count("campaign") ? vm["campaign"].as<int>() : -1;
+    }
+
+    std::cout << "Running on " << installs.size() << " installations...\n" << std::flush;
+
+    // Messages from each installation would be interleaved beyond recognition, so only errors are shown until the
+    // summary
+    std::streambuf* const stdout_buffer = std::cout.rdbuf(nullptr);
+    const std::vector<FleetResult> results = Fleet(installs, num_jobs).run(operation);
+    std::cout.rdbuf(stdout_buffer);
+    std::cout.clear();
+
+    print_fleet_results(results, vm.count("list-campaigns") > 0);
+
+    return std::all_of(results.begin(), results.end(), [](const FleetResult& result) { return result.success; });
 }
 
 int main(int argc, char* argv[])
 {
     boost::optional<std::string> anno_dir;
+    int num_jobs = 0;
 
     // General options (always allowed)
     po::options_description general_options("General options");
-    general_options.add_options()                                      //
-            ("help", "produce help message")                           //
-            ("anno-dir", po::value(&anno_dir), "Anno 1602 directory")  //
+    general_options.add_options()                                                                                 //
+            ("help", "produce help message")                                                                      //
+            ("anno-dir", po::value(&anno_dir), "Anno 1602 directory")                                             //
+            ("jobs", po::value(&num_jobs), "number of threads used to scan scenarios (default: all cores)")       //
+            ("manifest", po::value<std::string>(), "file listing campaign definition files, one per line")        //
+            ("socket", po::value<std::string>(), "Unix socket to serve requests on (default: stdin/stdout)")      //
+            ("trace", po::value<std::string>(), "write a Chrome trace of this run to the given file")             //
+            ("fleet", po::value<std::string>(), "file listing Anno directories to work on, one per line")         //
+            ("max-open-files", po::value<unsigned>(), "maximum number of files to have open at once")             //
+            ("campaign", po::value<int>(), "campaign index for set-progress (default: main game)")                //
             ;
 
     // Instructions (one allowed)
     po::options_description instructions("Instructions");
     instructions.add_options()                                                             //
             ("list-campaigns", "list all installed campaigns")                             //
-            ("install-campaign", "install a campaign using the supplied definition file")  //
+            ("install-campaign", "install campaigns using the supplied definition files")  //
+            ("uninstall-campaign", "uninstall the named campaigns")                        //
+            ("compact-campaigns", "renumber campaigns to remove any gaps between them")    //
+            ("set-progress", po::value<int>(), "set the player's progress")                //
+            ("watch", "keep running and report changes to the game files as they happen")  //
+            ("serve", "keep running and serve JSON requests (one per line)")               //
+            ;
+
+    // Hidden options (only supplied positionally)
+    po::options_description hidden_options("Hidden options");
+    hidden_options.add_options()                                                    //
+            ("input-file", po::value<std::vector<std::string>>(), "input file(s)")  //
             ;
 
     // All accepted options combined
     po::options_description all_options("Allowed options");
     all_options.add(general_options).add(instructions);
+    po::options_description cmdline_options;
+    cmdline_options.add(all_options).add(hidden_options);
 
     // Define positional program options
     po::positional_options_description positional_options;
-    positional_options.add("input-file", 1);
+    positional_options.add("input-file", -1);
 
     // Parse command-line arguments
     po::variables_map vm;
     try
     {
         po::store(po::command_line_parser(argc, argv)      //
-                          .options(all_options)            //
+                          .options(cmdline_options)        //
                           .positional(positional_options)  //
                           .run(),
                 vm);
@@ -152,7 +335,9 @@ int main(int argc, char* argv[])
     }
 
     // Sanity checking
-    size_t num_functions_requested = vm.count("install-campaign") + vm.count("list-campaigns");
+    size_t num_functions_requested = vm.count("install-campaign") + vm.count("list-campaigns") + vm.count("watch")
+            + vm.count("serve") + vm.count("set-progress") + vm.count("uninstall-campaign")
+            + vm.count("compact-campaigns");
     if (num_functions_requested == 0)
     {
         std::cerr << "Please specify an instruction.\n\n" << instructions << '\n';
@@ -163,11 +348,54 @@ int main(int argc, char* argv[])
         std::cerr << "Only 1 instruction can be provided.\n\n" << instructions << '\n';
         return 1;
     }
-    if (vm.count("install-campaign") && !vm.count("input-file"))
+    if (vm.count("install-campaign") && !vm.count("input-file") && !vm.count("manifest"))
     {
         std::cerr << "No campaign file provided!\n";
         return 1;
     }
+    if (vm.count("uninstall-campaign") && !vm.count("input-file"))
+    {
+        std::cerr << "No campaign name provided!\n";
+        return 1;
+    }
+    if (vm.count("fleet") && (vm.count("watch") || vm.count("serve")))
+    {
+        std::cerr << "Watching and serving requests cannot be used with a fleet.\n";
+        return 1;
+    }
+
+    if (vm.count("max-open-files"))
+    {
+        FileUtils::set_max_open_files(vm["max-open-files"].as<unsigned>());
+    }
+
+    // Record where the time goes, if requested
+    std::optional<Trace::Session> trace_session;
+    if (vm.count("trace"))
+    {
+        trace_session.emplace(vm["trace"].as<std::string>());
+    }
+
+    if (vm.count("fleet"))
+    {
+        try
+        {
+            return run_fleet(vm, num_jobs) ? 0 : 1;
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << "Fatal error: " << e.what() << '\n';
+            return 1;
+        }
+    }
+
+    // When serving requests over stdin/stdout, stdout is reserved for responses, so anything else that would normally
+    // be printed there is sent to stderr instead
+    std::ostream stdout_stream(std::cout.rdbuf());
+    if (vm.count("serve") && !vm.count("socket"))
+    {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
 
     // Find Anno directory
     Config cfg;
@@ -175,6 +403,10 @@ int main(int argc, char* argv[])
     {
         return 1;
     }
+    cfg.num_jobs = num_jobs;
+
+    // Cleared if the requested change could not be made (the reason has already been logged)
+    bool success = true;
 
     try
     {
@@ -188,7 +420,27 @@ int main(int argc, char* argv[])
         }
         else if (vm.count("install-campaign"))
         {
-            install_campaign(tool, vm);
+            success = install_campaigns(tool, vm);
+        }
+        else if (vm.count("uninstall-campaign"))
+        {
+            success = uninstall_campaigns(tool, vm);
+        }
+        else if (vm.count("compact-campaigns"))
+        {
+            success = tool.compact_campaigns();
+        }
+        else if (vm.count("set-progress"))
+        {
+            set_progress(tool, vm);
+        }
+        else if (vm.count("watch"))
+        {
+            watch_for_changes(tool, cfg);
+        }
+        else if (vm.count("serve"))
+        {
+            serve_requests(tool, vm, stdout_stream);
         }
     }
     catch (const std::exception& e)
@@ -197,5 +449,5 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    return 0;
+    return success ? 0 : 1;
 }
@@ -0,0 +1,31 @@
+#include "tool/config.h"
+
+#include "files/file_utils.h"
+
+namespace Anno {
+
+std::optional<GameVersion> detect_game_version(const std::filesystem::path& anno_dir)
+{
+    if (std::filesystem::exists(anno_dir / "1602.exe"))
+    {
+        return GameVersion::Original;
+    }
+
+    if (std::filesystem::exists(anno_dir / "Anno1602.exe"))
+    {
+        return GameVersion::HistoryEdition;
+    }
+
+    return std::nullopt;
+}
+
+std::filesystem::path get_default_user_dir(const std::filesystem::path& anno_dir, GameVersion version)
+{
+    if (version == GameVersion::HistoryEdition)
+    {
+        return FileUtils::get_documents_folder() / "Anno 1602 History Edition";
+    }
+    return anno_dir;
+}
+
+}  // namespace Anno
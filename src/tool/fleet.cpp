@@ -0,0 +1,156 @@
+#include "tool/fleet.h"
+
+#include <algorithm>  // max, min
+#include <exception>
+#include <stdexcept>
+#include <utility>  // move
+
+#include "files/file_utils.h"
+#include "util/parallel_utils.h"
+#include "util/trace.h"
+
+namespace Anno {
+
+/*
+ * Fleet class
+ */
+
+Fleet::Fleet(std::vector<FleetInstall> installs, int num_jobs)
+    : installs(std::move(installs))
+    , num_jobs(num_jobs)
+{
+}
+
+std::vector<FleetInstall> Fleet::read_manifest(const std::filesystem::path& path)
+{
+    std::vector<FleetInstall> installs;
+
+    std::vector<std::string> lines = FileUtils::read_text_file(path);
+    for (const auto& line : lines)
+    {
+        if (line.empty())
+        {
+            // Ignore blank lines
+            continue;
+        }
+
+        // Relative paths are relative to the manifest itself
+        FleetInstall& install = installs.emplace_back();
+        const size_t separator_pos = line.find('\t');
+        install.anno_dir = path.parent_path() / FileUtils::path_from_utf8(line.substr(0, separator_pos));
+        if (separator_pos != std::string::npos)
+        {
+            install.user_dir = path.parent_path() / FileUtils::path_from_utf8(line.substr(separator_pos + 1));
+        }
+    }
+
+    return installs;
+}
+
+std::vector<FleetResult> Fleet::run(const FleetOperation& operation) const
+{
+    Trace::Span span("fleet", "Fleet::run");
+
+    std::vector<FleetResult> results(installs.size());
+    if (installs.empty())
+    {
+        return results;
+    }
+
+    // Any cores not needed for one installation each are shared out for scanning scenarios
+    const unsigned total_jobs = ParallelUtils::resolve_num_jobs(num_jobs);
+    const unsigned num_workers = std::min<unsigned>(total_jobs, static_cast<unsigned>(installs.size()));
+    const int num_scan_jobs = static_cast<int>(std::max(total_jobs / num_workers, 1u));
+
+    ParallelUtils::parallel_for(installs.size(), num_workers, [&](size_t i) {
+        results[i] = run_one(installs[i], operation, num_scan_jobs);
+    });
+
+    return results;
+}
+
+FleetResult Fleet::run_one(const FleetInstall& install, const FleetOperation& operation, int num_scan_jobs) const
+{
+    Trace::Span span("fleet", "Fleet::run_one");
+    span.set_path(install.anno_dir);
+
+    const auto start_time = std::chrono::steady_clock::now();
+
+    FleetResult result;
+    result.anno_dir = install.anno_dir;
+
+    // Nothing may escape from here, or the rest of the fleet would be abandoned
+    try
+    {
+        const auto version = detect_game_version(install.anno_dir);
+        if (!version.has_value())
+        {
+            throw std::runtime_error("Invalid Anno directory");
+        }
+
+        Config cfg;
+        cfg.anno_dir = install.anno_dir;
+        cfg.user_dir = install.user_dir.empty() ? get_default_user_dir(install.anno_dir, *version) : install.user_dir;
+        cfg.version = *version;
+        cfg.num_jobs = num_scan_jobs;
+
+        Tool tool(cfg);
+
+        switch (operation.type)
+        {
+        case FleetOperation::Type::ListCampaigns:
+            break;
+
+        case FleetOperation::Type::InstallCampaigns:
+            if (!tool.install_campaigns(operation.campaigns))
+            {
+                // Details have already been logged
+                throw std::runtime_error("Failed to install campaigns");
+            }
+            break;
+
+        case FleetOperation::Type::UninstallCampaigns:
+            if (!tool.uninstall_campaigns(operation.campaigns))
+            {
+                // Details have already been logged
+                throw std::runtime_error("Failed to uninstall campaigns");
+            }
+            break;
+
+        case FleetOperation::Type::CompactCampaigns:
+            if (!tool.compact_campaigns())
+            {
+                // Details have already been logged
+                throw std::runtime_error("Failed to compact campaigns");
+            }
+            break;
+
+        case FleetOperation::Type::SetProgress:
+            if (operation.campaign_index < 0)
+            {
+                tool.set_main_game_progress(operation.progress);
+            }
+            else
+            {
+                tool.set_campaign_progress(operation.campaign_index, operation.progress);
+            }
+            tool.save_player_data();
+            break;
+        }
+
+        // Report the resulting state, so that callers can confirm that the operation had the intended effect
+        result.installed_campaigns = tool.list_campaigns();
+
+        result.success = true;
+    }
+    catch (const std::exception& e)
+    {
+        result.error = e.what();
+    }
+
+    result.duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start_time);
+    return result;
+}
+
+}  // namespace Anno
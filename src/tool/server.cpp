@@ -0,0 +1,475 @@
+#include "tool/server.h"
+
+#include <cerrno>
+#include <cstring>  // memcpy, strerror
+#include <exception>
+#include <istream>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <unordered_set>
+#include <utility>  // move
+#include <vector>
+
+#include "util/log.h"
+#include "util/text_encoding.h"
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace Anno {
+
+/*
+ * Helper methods
+ */
+
+static int get_int_param(const Json::Value& params, std::string_view key)
+{
+    const std::int64_t value = params.at(key).as_int();
+    if (value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max())
+    {
+        throw Json::Error("Value out of range: " + std::string(key));
+    }
+    return static_cast<int>(value);
+}
+
+static Json::Value make_error_response(const Json::Value& id, const std::string& message)
+{
+    Json::Value response;
+    response.set("id", id);
+    response.set("ok", false);
+    response.set("error", message);
+    return response;
+}
+
+/*
+ * Server class
+ */
+
+Server::Server(Tool& tool)
+    : tool(tool)
+{
+}
+
+std::string Server::handle_request(std::string_view request_text)
+{
+    Json::Value id;
+    Json::Value response;
+
+    try
+    {
+        const Json::Value request = Json::parse(request_text);
+        if (const Json::Value* request_id = request.find("id"))
+        {
+            id = *request_id;
+        }
+
+        const Json::Value* params = request.find("params");
+        const Json::Value no_params = Json::Value(std::vector<Json::Member>());
+        if (params == nullptr)
+        {
+            params = &no_params;
+        }
+
+        const std::string& method = request.at("method").as_string();
+
+        // Other programs (e.g. the game saving progress) may have changed the files since the last request, and we
+        // must never act on (or overwrite) an out-of-date view of them
+        {
+            std::unique_lock lock(tool_mutex);
+            std::vector<StateChange> changes;
+            tool.refresh_if_changed(changes);
+        }
+
+        Json::Value result;
+        if (method == "list_campaigns")
+        {
+            std::shared_lock lock(tool_mutex);
+            result = list_campaigns();
+        }
+        else if (method == "get_progress")
+        {
+            std::shared_lock lock(tool_mutex);
+            result = get_progress(*params);
+        }
+        else if (method == "set_progress")
+        {
+            std::unique_lock lock(tool_mutex);
+            result = set_progress(*params);
+        }
+        else if (method == "install_campaigns")
+        {
+            std::unique_lock lock(tool_mutex);
+            result = install_campaigns(*params);
+        }
+        else if (method == "uninstall_campaigns")
+        {
+            std::unique_lock lock(tool_mutex);
+            result = uninstall_campaigns(*params);
+        }
+        else if (method == "compact_campaigns")
+        {
+            std::unique_lock lock(tool_mutex);
+            result = compact_campaigns();
+        }
+        else
+        {
+            throw Json::Error("Unknown method: " + method);
+        }
+
+        response.set("id", id);
+        response.set("ok", true);
+        response.set("result", std::move(result));
+    }
+    catch (const std::exception& e)
+    {
+        response = make_error_response(id, e.what());
+    }
+
+    return response.to_string();
+}
+
+Json::Value Server::list_campaigns() const
+{
+    Json::Value result;
+    result.set("campaigns", describe_campaigns(tool.list_campaigns()));
+    return result;
+}
+
+Json::Value Server::describe_campaigns(const std::vector<InstalledCampaign>& installed_campaigns)
+{
+    std::vector<Json::Value> campaigns;
+    campaigns.reserve(installed_campaigns.size());
+    for (const auto& installed_campaign : installed_campaigns)
+    {
+        // The game's own text is Windows-1252, but JSON is always UTF-8
+        const Campaign& campaign = installed_campaign.campaign;
+        std::vector<Json::Value> level_names;
+        level_names.reserve(campaign.level_names.size());
+        for (const auto& level_name : campaign.level_names)
+        {
+            level_names.emplace_back(TextEncoding::windows1252_to_utf8(level_name));
+        }
+
+        Json::Value entry;
+        entry.set("index", installed_campaign.index);
+        entry.set("name", TextEncoding::windows1252_to_utf8(campaign.name));
+        entry.set("levels", std::move(level_names));
+        entry.set("progress", installed_campaign.progress);
+        campaigns.push_back(std::move(entry));
+    }
+    return Json::Value(std::move(campaigns));
+}
+
+Json::Value Server::get_progress(const Json::Value& params) const
+{
+    Json::Value result;
+    if (params.find("campaign") != nullptr)
+    {
+        const int campaign_index = get_int_param(params, "campaign");
+        if (campaign_index < 0 || campaign_index > max_campaign_index)
+        {
+            throw std::out_of_range("Invalid campaign index: " + std::to_string(campaign_index));
+        }
+        result.set("progress", tool.get_campaign_progress(campaign_index));
+    }
+    else
+    {
+        result.set("progress", tool.get_main_game_progress());
+    }
+    return result;
+}
+
+Json::Value Server::set_progress(const Json::Value& params)
+{
+    const int progress = get_int_param(params, "progress");
+    if (params.find("campaign") != nullptr)
+    {
+        tool.set_campaign_progress(get_int_param(params, "campaign"), progress);
+    }
+    else
+    {
+        tool.set_main_game_progress(progress);
+    }
+
+    // The client is told that nothing changed if saving fails, so our state must agree
+    try
+    {
+        tool.save_player_data();
+    }
+    catch (const std::exception&)
+    {
+        tool.discard_player_data_changes();
+        throw;
+    }
+
+    return Json::Value(std::vector<Json::Member>());
+}
+
+Json::Value Server::install_campaigns(const Json::Value& params)
+{
+    std::vector<Campaign> campaigns;
+    for (const auto& campaign_value : params.at("campaigns").as_array())
+    {
+        Campaign& campaign = campaigns.emplace_back();
+        campaign.name = TextEncoding::utf8_to_windows1252(campaign_value.at("name").as_string());
+        for (const auto& level_name : campaign_value.at("levels").as_array())
+        {
+            campaign.level_names.push_back(TextEncoding::utf8_to_windows1252(level_name.as_string()));
+        }
+    }
+
+    if (!tool.install_campaigns(campaigns))
+    {
+        // Details have already been logged
+        throw std::runtime_error("Failed to install campaigns");
+    }
+
+    return Json::Value(std::vector<Json::Member>());
+}
+
+Json::Value Server::uninstall_campaigns(const Json::Value& params)
+{
+    std::vector<Campaign> campaigns;
+    for (const auto& campaign_name : params.at("campaigns").as_array())
+    {
+        campaigns.emplace_back(TextEncoding::utf8_to_windows1252(campaign_name.as_string()));
+    }
+
+    if (!tool.uninstall_campaigns(campaigns))
+    {
+        // Details have already been logged
+        throw std::runtime_error("Failed to uninstall campaigns");
+    }
+
+    return Json::Value(std::vector<Json::Member>());
+}
+
+Json::Value Server::compact_campaigns()
+{
+    if (!tool.compact_campaigns())
+    {
+        // Details have already been logged
+        throw std::runtime_error("Failed to compact campaigns");
+    }
+
+    return Json::Value(std::vector<Json::Member>());
+}
+
+void Server::serve_stream(std::istream& in, std::ostream& out)
+{
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line == "\r")
+        {
+            continue;
+        }
+        out << handle_request(line) << '\n' << std::flush;
+    }
+}
+
+#ifdef _WIN32
+
+void Server::serve_socket(const std::filesystem::path&)
+{
+    throw std::runtime_error("Serving on a socket is not supported on this platform");
+}
+
+void Server::serve_connection(int) {}
+
+#else
+
+void Server::serve_socket(const std::filesystem::path& socket_path)
+{
+    // A client that disconnects early should not bring down the server
+    std::signal(SIGPIPE, SIG_IGN);
+
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    const std::string socket_path_str = socket_path.string();
+    if (socket_path_str.size() >= sizeof(address.sun_path))
+    {
+        throw std::runtime_error("Socket path is too long: " + socket_path_str);
+    }
+    std::memcpy(address.sun_path, socket_path_str.c_str(), socket_path_str.size() + 1);
+
+    // Remove any socket left behind by a previous run, but never anything else
+    struct stat existing {};
+    if (lstat(socket_path_str.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode))
+    {
+        unlink(socket_path_str.c_str());
+    }
+
+    const int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+    {
+        throw std::runtime_error("Failed to create socket: " + std::string(std::strerror(errno)));
+    }
+    if (bind(listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+            || listen(listen_fd, SOMAXCONN) != 0)
+    {
+        const std::string error = std::strerror(errno);
+        close(listen_fd);
+        throw std::runtime_error("Failed to listen on socket: " + socket_path_str + " (" + error + ")");
+    }
+
+    std::mutex state_mutex;
+    std::unordered_set<int> connection_fds;
+    std::string error;
+
+    // Stops every worker: shutting down the listening socket interrupts `accept`, and shutting down each open
+    // connection interrupts `read`
+    const auto stop = [&](const std::string& reason) {
+        std::scoped_lock lock(state_mutex);
+        if (error.empty())
+        {
+            error = reason;
+        }
+        shutdown(listen_fd, SHUT_RDWR);
+        for (int fd : connection_fds)
+        {
+            shutdown(fd, SHUT_RDWR);
+        }
+    };
+
+    const auto run_worker = [&]() {
+        while (true)
+        {
+            const int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED)
+                {
+                    continue;
+                }
+                stop("Failed to accept connection: " + std::string(std::strerror(errno)));
+                return;
+            }
+
+            {
+                std::scoped_lock lock(state_mutex);
+                if (!error.empty())
+                {
+                    close(fd);
+                    return;
+                }
+                connection_fds.insert(fd);
+            }
+
+            serve_connection(fd);
+
+            // Only close the connection once `stop` can no longer see it, since the descriptor may be reused
+            std::scoped_lock lock(state_mutex);
+            connection_fds.erase(fd);
+            close(fd);
+        }
+    };
+
+    // A fixed pool of workers takes turns to accept connections, so a flood of clients can't exhaust our threads;
+    // any other clients wait in the listen backlog until a worker is free
+    std::vector<std::thread> workers;
+    workers.reserve(max_connections);
+    for (unsigned i = 0; i < max_connections; ++i)
+    {
+        try
+        {
+            workers.emplace_back(run_worker);
+        }
+        catch (const std::system_error& e)
+        {
+            if (workers.empty())
+            {
+                close(listen_fd);
+                throw std::runtime_error("Failed to start serving: " + std::string(e.what()));
+            }
+            Log::err() << "Serving with only " << workers.size() << " workers: " << e.what() << '\n';
+            break;
+        }
+    }
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    close(listen_fd);
+    throw std::runtime_error(error);
+}
+
+void Server::serve_connection(int fd)
+{
+    std::string pending;
+    std::vector<char> buffer(64 * 1024);
+
+    auto send_all = [fd](const std::string& data) {
+        size_t num_sent = 0;
+        while (num_sent < data.size())
+        {
+            const ssize_t result = write(fd, data.data() + num_sent, data.size() - num_sent);
+            if (result < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (result <= 0)
+            {
+                return false;
+            }
+            num_sent += static_cast<size_t>(result);
+        }
+        return true;
+    };
+
+    while (true)
+    {
+        const ssize_t num_read = read(fd, buffer.data(), buffer.size());
+        if (num_read < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (num_read <= 0)
+        {
+            break;
+        }
+        pending.append(buffer.data(), static_cast<size_t>(num_read));
+
+        // Handle every complete request received so far
+        bool is_connected = true;
+        size_t line_start = 0;
+        size_t line_end;
+        while (is_connected && (line_end = pending.find('\n', line_start)) != std::string::npos)
+        {
+            std::string_view line(pending.data() + line_start, line_end - line_start);
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.remove_suffix(1);
+            }
+            if (!line.empty())
+            {
+                is_connected = send_all(handle_request(line) + '\n');
+            }
+            line_start = line_end + 1;
+        }
+        pending.erase(0, line_start);
+
+        if (!is_connected)
+        {
+            break;
+        }
+        if (pending.size() > max_request_size)
+        {
+            send_all(make_error_response(Json::Value(), "Request too large").to_string() + '\n');
+            break;
+        }
+    }
+}
+
+#endif
+
+}  // namespace Anno
@@ -1,7 +1,26 @@
 #include "tool/tool.h"
 
+#include <algorithm>  // find_if, lower_bound, sort
+#include <cctype>  // tolower
+#include <charconv>  // from_chars
+#include <exception>
 #include <ios>
-#include <iostream>
+#include <map>
+#include <numeric>  // iota
+#include <optional>
+#include <set>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "files/file_transaction.h"
+#include "files/file_utils.h"
+#include "files/rda_archive.h"
+#include "files/texts_xml_parser.h"
+#include "util/log.h"
+#include "util/parallel_utils.h"
+#include "util/text_encoding.h"
+#include "util/trace.h"
 
 namespace Anno {
 
@@ -9,6 +28,12 @@ namespace Anno {
  * Helper methods
  */
 
+static bool has_scenario_extension(const std::filesystem::path& path)
+{
+    const std::filesystem::path extension = path.extension();
+    return extension == ".szs" || extension == ".szm";
+}
+
 static bool is_scenario_file(const std::filesystem::directory_entry& entry)
 {
     if (!entry.is_regular_file())
@@ -17,244 +42,1492 @@ static bool is_scenario_file(const std::filesystem::directory_entry& entry)
         return false;
     }
 
-    const std::filesystem::path extension = entry.path().extension();
-    return extension == ".szs" || extension == ".szm";
+    return has_scenario_extension(entry.path());
 }
 
-static std::string get_campaign_name(const std::string& scenario_filename)
+// Result of probing a single entry of the "Szenes" directory
+struct ScenarioScanResult
 {
-    // Just remove the last character, which is the index of the scenario within the campaign
-    return scenario_filename.substr(0, scenario_filename.length() - 1);
-}
+    std::optional<ScenarioFile> scenario;
+    std::optional<SnapshotFile::FileStamp> stamp;
+    bool is_from_snapshot = false;
+    std::string error;
+};
 
-/*
- * Tool class
- */
+static std::filesystem::path get_journal_path(const Config& cfg)
+{
+    return cfg.anno_dir / "AnnoTool.journal";
+}
 
-Tool::Tool(const Config& cfg)
-    : cfg(cfg)
-    , game_dat_file(cfg.user_dir / "Game.dat", cfg.version)
-    , text_cod(cfg.anno_dir / "text.cod")
+static const Config& recover_interrupted_changes(const Config& cfg)
 {
-    read_installed_scenarios();
-    parse_campaign_level_names();
+    Trace::Span span("tool", "Tool::recover_interrupted_changes");
+
+    // This must happen before any game files are read
+    FileTransaction::recover(get_journal_path(cfg));
+    return cfg;
 }
 
-void Tool::read_installed_scenarios()
+static std::filesystem::path get_snapshot_path(const Config& cfg)
 {
-    std::map<int, std::string> campaign_names;
+    return cfg.user_dir / "AnnoTool.snapshot";
+}
 
-    // Read all scenarios in "Szenes" directory
-    for (const auto& entry : std::filesystem::directory_iterator(cfg.anno_dir / "Szenes"))
-    {
-        if (!is_scenario_file(entry))
-        {
-            continue;
-        }
+static std::filesystem::path get_texts_index_path(const Config& cfg)
+{
+    return cfg.user_dir / "AnnoTool.texts";
+}
 
-        try
-        {
-            // Create and store a ScenarioFile
-            std::string scenario_filename = entry.path().stem().string();
-            auto [it, was_inserted] = installed_scenarios.emplace(scenario_filename, entry.path());
-            ScenarioFile& scenario = it->second;
+static std::filesystem::path get_rda_path(const Config& cfg)
+{
+    return cfg.anno_dir / "data" / "a1he0.rda";
+}
 
-            const int campaign_index = scenario.get_campaign_index();
-            if (campaign_index > max_campaign_index)
-            {
-                // Ignore excessive campaign numbers, this this is a sign of a corrupted file
-                std::cerr << "Scenario file is corrupted: " << entry.path() << ")\n";
-            }
-            else if (campaign_index >= 0)
-            {
-                // Scenario belongs to a campaign
-                campaign_names.try_emplace(campaign_index, get_campaign_name(scenario_filename));
-            }
-        }
-        catch (const std::ios_base::failure& error)
-        {
-            std::cerr << "Failed to read scenario file: " << entry.path() << "\nError: " << error.what() << '\n';
-        }
+// Gets the key from a localization key such as "[[103]]", or nothing if the text is not a key
+static std::optional<std::uint32_t> parse_localization_key(std::string_view text)
+{
+    if (text.size() < 5 || !text.starts_with("[[") || !text.ends_with("]]"))
+    {
+        return std::nullopt;
     }
 
-    // If no campaigns found, nothing to do
-    if (campaign_names.empty())
+    const std::string_view digits = text.substr(2, text.size() - 4);
+    std::uint32_t id = 0;
+    const auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), id);
+    if (ec != std::errc() || end != digits.data() + digits.size())
     {
-        return;
+        return std::nullopt;
     }
+    return id;
+}
 
-    // Create campaign entries
-    const int max_campaign_index_found = campaign_names.rbegin()->first;
-    installed_campaigns.resize(max_campaign_index_found + 1);
-
-    // Save the campaign names
-    for (int i = 0; i <= max_campaign_index_found; ++i)
+// Finds the localized strings within the History Edition's archive, preferring English if there is a choice
+static const RdaArchive::Entry* find_texts_xml(const RdaArchive& archive)
+{
+    const RdaArchive::Entry* texts_xml = nullptr;
+    for (const auto& entry : archive.get_entries())
     {
-        const auto it = campaign_names.find(i);
-        if (it == campaign_names.cend())
+        std::string path = entry.path;
+        std::transform(path.begin(), path.end(), path.begin(), [](unsigned char c) { return std::tolower(c); });
+        if (path != "texts.xml" && !path.ends_with("/texts.xml"))
         {
-            // For what it's worth, the game DOES allow non-consecutive campaign numbers,
-            // but this is normally a sign that something has gone wrong.
-            std::cerr << "Campaign " << i << " is missing!\n";
+            continue;
         }
-        else
+
+        if (path.find("eng") != std::string::npos)
+        {
+            return &entry;
+        }
+        if (!texts_xml)
         {
-            installed_campaigns[i].name = it->second;
+            texts_xml = &entry;
         }
     }
+    return texts_xml;
+}
+
+static std::string get_campaign_name(const std::string& scenario_filename)
+{
+    // Just remove the last character, which is the index of the scenario within the campaign
+    return scenario_filename.substr(0, scenario_filename.length() - 1);
 }
 
-void Tool::parse_campaign_level_names()
+// Stands in for the level names of a campaign that is not installed, so that later campaigns keep their place
+static constexpr std::string_view unused_campaign_placeholder = "(Unused)";
+
+// Rewrites the campaign section of `text.cod` (see `Tool::parse_campaign_level_names`), replacing the level names of
+// the given campaigns. Replacing a campaign with no level names removes it, which moves every later campaign down.
+// Campaigns beyond the end of the section are appended, with placeholders for any campaigns in between.
+static std::vector<std::string> rewrite_campaign_section(
+        const std::vector<std::string>& lines, const std::map<int, std::vector<std::string>>& new_level_names)
 {
-    const auto campaign_data = text_cod.get_section_contents(TextCodFile::section_campaign);
+    std::vector<std::string> new_lines;
+    new_lines.reserve(lines.size());
 
     int campaign_index = 0;
     int last_campaign_index = -1;
-
-    for (const auto& line : campaign_data)
+    for (size_t i = 0; i < lines.size(); ++i)
     {
-        // Skip blank lines
+        const std::string& line = lines[i];
         if (line.empty())
         {
             campaign_index = last_campaign_index + 1;
+            new_lines.push_back(line);
             continue;
         }
+        last_campaign_index = campaign_index;
 
-        if (installed_campaigns.size() <= campaign_index)
+        const auto it = new_level_names.find(campaign_index);
+        if (it == new_level_names.end())
         {
-            std::cerr << "Found level names for non-existant campaign: " << campaign_index << '\n';
-            installed_campaigns.emplace_back("[Missing Campaign]");
+            new_lines.push_back(line);
+        }
+        else if (i == 0 || lines[i - 1].empty())
+        {
+            // First line of a replaced campaign; the remaining lines are skipped
+            new_lines.insert(new_lines.end(), it->second.begin(), it->second.end());
         }
+    }
 
-        // Add level to campaign
-        installed_campaigns[campaign_index].level_names.push_back(line);
-        last_campaign_index = campaign_index;
+    // Add new campaigns at the end
+    const int num_campaigns_found = last_campaign_index + 1;
+    const auto first_new_it = new_level_names.lower_bound(num_campaigns_found);
+    if (first_new_it != new_level_names.end())
+    {
+        const int last_new_index = new_level_names.rbegin()->first;
+        for (int i = num_campaigns_found; i <= last_new_index; ++i)
+        {
+            const auto it = new_level_names.find(i);
+            new_lines.push_back("");  // blank line
+            if (it == new_level_names.end() || it->second.empty())
+            {
+                new_lines.emplace_back(unused_campaign_placeholder);
+            }
+            else
+            {
+                new_lines.insert(new_lines.end(), it->second.begin(), it->second.end());
+            }
+            new_lines.push_back("");
+        }
     }
+
+    return new_lines;
 }
 
-std::vector<Campaign> Tool::get_installed_campaigns() const
+/*
+ * Tool class
+ */
+
+Tool::Tool(const Config& cfg)
+    : cfg(recover_interrupted_changes(cfg))
 {
-    return installed_campaigns;
+    Trace::Span span("tool", "Tool::Tool");
+
+    // Anything that has not changed since the last run can be taken from the snapshot
+    const bool has_snapshot = load_snapshot();
+    bool is_snapshot_stale = !has_snapshot;
+
+    if (!has_snapshot || SnapshotFile::get_file_stamp(cfg.user_dir / "Game.dat") != snapshot.game_dat_stamp)
+    {
+        get_game_dat_file();
+        is_snapshot_stale = true;
+    }
+
+    if (read_installed_scenarios())
+    {
+        is_snapshot_stale = true;
+    }
+
+    if (!has_snapshot || SnapshotFile::get_file_stamp(cfg.anno_dir / "text.cod") != snapshot.text_cod_stamp)
+    {
+        const auto campaign_data = get_text_cod().get_section_lines(TextCodFile::section_campaign);
+        snapshot.campaign_section_lines.assign(campaign_data.begin(), campaign_data.end());
+        is_snapshot_stale = true;
+    }
+
+    rebuild_installed_campaigns();
+
+    if (is_snapshot_stale)
+    {
+        save_snapshot();
+    }
 }
 
-// TODO: Failure inside this method could leave the program / game files in a weird state
-bool Tool::install_campaign(const Campaign& campaign)
+bool Tool::load_snapshot()
 {
-    /*
-     * 0. Sanity check
-     */
+    Trace::Span span("tool", "Tool::load_snapshot");
+
+    const std::filesystem::path snapshot_path = get_snapshot_path(cfg);
+    if (!std::filesystem::exists(snapshot_path))
+    {
+        return false;
+    }
 
-    if (campaign.name.empty() || campaign.level_names.empty())
+    try
+    {
+        snapshot = SnapshotFile(snapshot_path);
+    }
+    catch (const std::exception&)
     {
-        std::cerr << "Invalid campaign data!\n";
+        // Unreadable or from a different version; it will be replaced
+        snapshot = SnapshotFile();
         return false;
     }
 
-    if (campaign.level_names.size() > Campaign::max_levels)
+    if (snapshot.anno_dir != cfg.anno_dir)
     {
-        std::cerr << "Too many levels in campaign!\n";
+        // Snapshot describes a different installation
+        snapshot = SnapshotFile();
         return false;
     }
 
-    int campaign_index = static_cast<int>(installed_campaigns.size());
+    return true;
+}
 
-    /*
-     * 1. Add level names to `text.cod`
-     */
+void Tool::save_snapshot()
+{
+    Trace::Span span("tool", "Tool::save_snapshot");
+
+    const auto text_cod_stamp = SnapshotFile::get_file_stamp(cfg.anno_dir / "text.cod");
+    const auto game_dat_stamp = SnapshotFile::get_file_stamp(cfg.user_dir / "Game.dat");
+    if (!text_cod_stamp.has_value() || !game_dat_stamp.has_value())
+    {
+        return;
+    }
+
+    snapshot.anno_dir = cfg.anno_dir;
+    snapshot.text_cod_stamp = *text_cod_stamp;
+    snapshot.game_dat_stamp = *game_dat_stamp;
+
+    if (text_cod.has_value())
+    {
+        const auto campaign_data = text_cod->get_section_lines(TextCodFile::section_campaign);
+        snapshot.campaign_section_lines.assign(campaign_data.begin(), campaign_data.end());
+    }
 
-    std::cout << "Adding level names to text.cod...\n";
-    auto campaign_data = text_cod.get_section_contents(TextCodFile::section_campaign);
-    campaign_data.push_back("");  // blank line
-    for (const auto& level_name : campaign.level_names)
+    if (game_dat_file.has_value())
     {
-        campaign_data.push_back(level_name);
+        snapshot.main_game_progress = game_dat_file->get_main_game_progress();
+        snapshot.campaign_progress.clear();
+        for (int i = 0; i <= max_campaign_index; ++i)
+        {
+            if (game_dat_file->has_campaign_progress(i))
+            {
+                snapshot.campaign_progress.resize(i + 1, 0);
+                snapshot.campaign_progress[i] = game_dat_file->get_campaign_progress(i);
+            }
+        }
     }
-    campaign_data.push_back("");
-    text_cod.set_section_contents(TextCodFile::section_campaign, campaign_data);
+
     try
     {
-        text_cod.save_overwrite();
+        snapshot.save_to_path(get_snapshot_path(cfg));
     }
-    catch (const std::ios_base::failure& e)
+    catch (const std::exception& e)
     {
-        std::cerr << "Failed to write to text.cod: " << e.what() << '\n';
-        return false;
+        // Not fatal, the next run will just be slower
+        Log::err() << "Failed to save snapshot: " << e.what() << '\n';
+    }
+}
+
+void Tool::update_snapshot_entry(const std::filesystem::path& path, const ScenarioFile* scenario)
+{
+    const std::string filename = FileUtils::path_to_utf8(path.filename());
+    auto it = std::lower_bound(snapshot.scenarios.begin(),
+            snapshot.scenarios.end(),
+            filename,
+            [](const SnapshotFile::ScenarioEntry& entry, const std::string& name) { return entry.filename < name; });
+    const bool has_entry = (it != snapshot.scenarios.end() && it->filename == filename);
+
+    const auto stamp = SnapshotFile::get_file_stamp(path);
+    if (scenario == nullptr || !stamp.has_value())
+    {
+        // Scenario is gone, or can't be validated any more
+        if (has_entry)
+        {
+            snapshot.scenarios.erase(it);
+        }
+        return;
     }
 
-    /*
-     * 2. Modify scenario files
-     */
+    if (!has_entry)
+    {
+        it = snapshot.scenarios.insert(it, { filename, *stamp, {} });
+    }
+    it->stamp = *stamp;
+    it->header_data = scenario->get_header_data();
+}
+
+GameDatFile& Tool::get_game_dat_file()
+{
+    if (!game_dat_file.has_value())
+    {
+        Trace::Span span("tool", "Tool::load_game_dat");
+        game_dat_file.emplace(cfg.user_dir / "Game.dat", cfg.version);
+    }
+    return *game_dat_file;
+}
+
+TextCodFile& Tool::get_text_cod()
+{
+    if (!text_cod.has_value())
+    {
+        Trace::Span span("tool", "Tool::load_text_cod");
+        text_cod.emplace(cfg.anno_dir / "text.cod", TextCodFile::LoadMode::Lazy);
+    }
+    return *text_cod;
+}
 
-    std::cout << "Linking scenarios to campaign...\n";
-    for (int i = 0; i < campaign.level_names.size(); ++i)
+bool Tool::read_installed_scenarios()
+{
+    Trace::Span span("tool", "Tool::read_installed_scenarios");
+
+    // List the "Szenes" directory up front, sorted so that results do not depend on the directory order
+    std::vector<std::filesystem::directory_entry> entries;
+    for (const auto& entry : std::filesystem::directory_iterator(cfg.anno_dir / "Szenes"))
+    {
+        entries.push_back(entry);
+    }
+    std::sort(entries.begin(), entries.end());
+
+    // Index the headers from the snapshot, if any
+    std::unordered_map<std::string_view, const SnapshotFile::ScenarioEntry*> cached_scenarios;
+    cached_scenarios.reserve(snapshot.scenarios.size());
+    for (const auto& cached_scenario : snapshot.scenarios)
     {
-        std::string scenario_name = campaign.name + std::to_string(i);
-        auto it = installed_scenarios.find(scenario_name);
-        if (it == installed_scenarios.cend())
+        cached_scenarios.emplace(cached_scenario.filename, &cached_scenario);
+    }
+
+    // Read all scenario headers in parallel, since this is dominated by I/O latency.
+    // Headers are only read from disk if the file has changed since the snapshot was taken.
+    std::vector<ScenarioScanResult> results(entries.size());
+    ParallelUtils::parallel_for(entries.size(), ParallelUtils::resolve_num_jobs(cfg.num_jobs), [&](size_t i) {
+        const auto& entry = entries[i];
+        if (!is_scenario_file(entry))
         {
-            std::cerr << "Did not find expected scenario file: " << scenario_name << '\n';
-            return false;
+            return;
+        }
+
+        auto& result = results[i];
+        result.stamp = SnapshotFile::get_file_stamp(entry);
+        if (result.stamp.has_value())
+        {
+            const auto it = cached_scenarios.find(FileUtils::path_to_utf8(entry.path().filename()));
+            if (it != cached_scenarios.end() && it->second->stamp == *result.stamp)
+            {
+                result.scenario.emplace(entry.path(), it->second->header_data);
+                result.is_from_snapshot = true;
+                return;
+            }
         }
 
-        ScenarioFile& scenario_file = it->second;
-        scenario_file.set_campaign_index(campaign_index);
         try
         {
-            scenario_file.save_overwrite();
+            result.scenario.emplace(entry.path());
+        }
+        catch (const std::ios_base::failure& error)
+        {
+            result.error = error.what();
         }
-        catch (const std::ios_base::failure& e)
+    });
+
+    // Merge the results in order
+    std::vector<SnapshotFile::ScenarioEntry> scenario_entries;
+    size_t num_scenarios_from_snapshot = 0;
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        const auto& entry = entries[i];
+        auto& result = results[i];
+
+        if (!result.error.empty())
         {
-            std::cerr << "Failed to write to " << scenario_file.get_filename() << ": " << e.what() << '\n';
-            return false;
+            Log::err() << "Failed to read scenario file: " << entry.path() << "\nError: " << result.error << '\n';
+            continue;
+        }
+
+        if (!result.scenario.has_value())
+        {
+            // Not a scenario file
+            continue;
+        }
+
+        // Store the ScenarioFile
+        std::string scenario_filename = entry.path().stem().string();
+        auto [it, was_inserted] = installed_scenarios.emplace(scenario_filename, std::move(*result.scenario));
+        ScenarioFile& scenario = it->second;
+
+        // Remember its header for next time
+        if (was_inserted && result.stamp.has_value())
+        {
+            scenario_entries.push_back({ FileUtils::path_to_utf8(entry.path().filename()),
+                    *result.stamp,
+                    scenario.get_header_data() });
+            if (result.is_from_snapshot)
+            {
+                ++num_scenarios_from_snapshot;
+            }
+        }
+
+        const int campaign_index = scenario.get_campaign_index();
+        if (campaign_index > max_campaign_index)
+        {
+            // Ignore excessive campaign numbers, this this is a sign of a corrupted file
+            Log::err() << "Scenario file is corrupted: " << entry.path() << ")\n";
+        }
+        else if (campaign_index >= 0)
+        {
+            // Scenario belongs to a campaign
+            campaign_scenarios[campaign_index].insert(scenario_filename);
         }
     }
 
-    /*
-     * 3. Add entry to Game.dat
-     */
+    // The snapshot is stale if any scenario was added, changed or removed
+    const bool has_changes = (num_scenarios_from_snapshot != snapshot.scenarios.size()
+            || num_scenarios_from_snapshot != scenario_entries.size());
+    snapshot.scenarios = std::move(scenario_entries);
 
-    std::cout << "Adding entry to Game.dat...\n";
-    game_dat_file.set_campaign_progress(campaign_index, 0);
-    try
+    return has_changes;
+}
+
+void Tool::refresh_scenario(const std::filesystem::path& path, std::vector<StateChange>& changes)
+{
+    const std::string scenario_filename = path.stem().string();
+    auto it = installed_scenarios.find(scenario_filename);
+    if (it != installed_scenarios.end() && it->second.get_path() != path)
     {
-        game_dat_file.save_overwrite();
+        // Another file with the same name (but a different extension) takes precedence
+        return;
     }
-    catch (const std::ios_base::failure& e)
+
+    std::optional<ScenarioFile> scenario;
+    std::error_code ec;
+    if (std::filesystem::is_regular_file(path, ec))
     {
-        std::cerr << "Failed to write to Game.dat: " << e.what() << '\n';
-        return false;
+        try
+        {
+            scenario.emplace(path);
+        }
+        catch (const std::ios_base::failure& error)
+        {
+            Log::err() << "Failed to read scenario file: " << path << "\nError: " << error.what() << '\n';
+        }
     }
 
-    std::cout << "Success!\n";
-    return true;
-}
+    const int old_campaign_index = (it != installed_scenarios.end()) ? it->second.get_campaign_index() : -1;
+    const int new_campaign_index = scenario.has_value() ? scenario->get_campaign_index() : -1;
+    if (new_campaign_index > max_campaign_index)
+    {
+        Log::err() << "Scenario file is corrupted: " << path << ")\n";
+    }
 
-void Tool::uninstall_campaign(const Campaign&)
-{
-    // TODO: remove entries from text.cod
-    // TODO: remove entry from Game.dat
-    // TODO: adjust indices of all subsequent campaign progress entries in Game.dat and scenario files (?)
-    std::cout << "Not implemented yet!\n";
-}
+    if (scenario.has_value())
+    {
+        // Scenarios are rewritten all the time (e.g. whenever the game saves), but we only care about the header
+        if (it == installed_scenarios.end())
+        {
+            changes.push_back({ StateChange::Type::ScenarioAdded, scenario_filename, new_campaign_index });
+        }
+        else if (scenario->get_header_data() != it->second.get_header_data())
+        {
+            changes.push_back({ StateChange::Type::ScenarioChanged, scenario_filename, new_campaign_index });
+        }
+        installed_scenarios.insert_or_assign(scenario_filename, std::move(*scenario));
+        update_snapshot_entry(path, &installed_scenarios.at(scenario_filename));
+    }
+    else if (it != installed_scenarios.end())
+    {
+        changes.push_back({ StateChange::Type::ScenarioRemoved, scenario_filename, old_campaign_index });
+        installed_scenarios.erase(it);
+        update_snapshot_entry(path, nullptr);
+    }
+    else
+    {
+        // Never knew about it
+        return;
+    }
 
-int Tool::get_main_game_progress() const
-{
-    return game_dat_file.get_main_game_progress();
+    move_scenario_to_campaign(scenario_filename, old_campaign_index, new_campaign_index);
 }
 
-void Tool::set_main_game_progress(int progress)
+void Tool::move_scenario_to_campaign(const std::string& scenario_name, int old_campaign_index, int new_campaign_index)
 {
-    game_dat_file.set_main_game_progress(progress);
+    if (old_campaign_index == new_campaign_index)
+    {
+        return;
+    }
+
+    const auto it = campaign_scenarios.find(old_campaign_index);
+    if (it != campaign_scenarios.end())
+    {
+        it->second.erase(scenario_name);
+        if (it->second.empty())
+        {
+            campaign_scenarios.erase(it);
+        }
+    }
+
+    if (new_campaign_index >= 0 && new_campaign_index <= max_campaign_index)
+    {
+        campaign_scenarios[new_campaign_index].insert(scenario_name);
+    }
 }
 
-int Tool::get_campaign_progress(int campaign_index) const
+void Tool::rebuild_installed_campaigns()
 {
-    return game_dat_file.get_campaign_progress(campaign_index);
+    Trace::Span span("tool", "Tool::rebuild_installed_campaigns");
+
+    installed_campaigns.clear();
+
+    if (!campaign_scenarios.empty())
+    {
+        // Create campaign entries
+        const int max_campaign_index_found = campaign_scenarios.rbegin()->first;
+        installed_campaigns.resize(max_campaign_index_found + 1);
+
+        // Save the campaign names
+        for (int i = 0; i <= max_campaign_index_found; ++i)
+        {
+            const auto it = campaign_scenarios.find(i);
+            if (it == campaign_scenarios.cend())
+            {
+                // For what it's worth, the game DOES allow non-consecutive campaign numbers,
+                // but this is normally a sign that something has gone wrong.
+                // We rebuild often (e.g. in watch mode), so only mention each gap once.
+                if (reported_missing_campaign_indices.insert(i).second)
+                {
+                    Log::err() << "Campaign " << i << " is missing!\n";
+                }
+            }
+            else
+            {
+                installed_campaigns[i].name = get_campaign_name(*it->second.begin());
+                reported_missing_campaign_indices.erase(i);
+            }
+        }
+    }
+
+    const std::vector<std::string_view> campaign_data(
+            snapshot.campaign_section_lines.begin(), snapshot.campaign_section_lines.end());
+    parse_campaign_level_names(campaign_data);
+
+    // Any campaign without scenarios is free to be reused
+    free_campaign_indices.clear();
+    for (int i = 0; i < static_cast<int>(installed_campaigns.size()); ++i)
+    {
+        if (!campaign_scenarios.contains(i))
+        {
+            free_campaign_indices.insert(i);
+        }
+    }
 }
 
-void Tool::set_campaign_progress(int campaign_index, int progress)
+std::vector<int> Tool::allocate_campaign_indices(size_t count) const
 {
-    game_dat_file.set_campaign_progress(campaign_index, progress);
+    // Fill in any gaps first, so that the campaign indices don't grow without limit
+    std::vector<int> campaign_indices;
+    campaign_indices.reserve(count);
+    for (auto it = free_campaign_indices.begin(); it != free_campaign_indices.end() && campaign_indices.size() < count;
+            ++it)
+    {
+        campaign_indices.push_back(*it);
+    }
+
+    int next_campaign_index = static_cast<int>(installed_campaigns.size());
+    while (campaign_indices.size() < count)
+    {
+        campaign_indices.push_back(next_campaign_index++);
+    }
+
+    return campaign_indices;
+}
+
+void Tool::parse_campaign_level_names(const std::vector<std::string_view>& campaign_data)
+{
+    int campaign_index = 0;
+    int last_campaign_index = -1;
+
+    for (const auto& line : campaign_data)
+    {
+        // Skip blank lines
+        if (line.empty())
+        {
+            campaign_index = last_campaign_index + 1;
+            continue;
+        }
+
+        if (installed_campaigns.size() <= campaign_index)
+        {
+            Log::err() << "Found level names for non-existant campaign: " << campaign_index << '\n';
+            installed_campaigns.emplace_back("[Missing Campaign]");
+        }
+
+        // Add level to campaign
+        installed_campaigns[campaign_index].level_names.push_back(localize(line));
+        last_campaign_index = campaign_index;
+    }
+}
+
+std::string Tool::localize(std::string_view text)
+{
+    // The History Edition uses localization keys in place of some level names
+    const auto id = parse_localization_key(text);
+    if (!id.has_value())
+    {
+        return std::string(text);
+    }
+
+    if (!is_texts_index_loaded)
+    {
+        load_texts_index();
+    }
+
+    if (texts_index.has_value())
+    {
+        // `texts.xml` is UTF-8, but level names are kept in the game's own encoding like everything else
+        const auto localized_text = texts_index->find_text(*id);
+        if (localized_text.has_value())
+        {
+            return TextEncoding::utf8_to_windows1252(*localized_text);
+        }
+    }
+
+    // Better to show the key than nothing at all
+    return std::string(text);
+}
+
+void Tool::load_texts_index()
+{
+    Trace::Span span("tool", "Tool::load_texts_index");
+
+    is_texts_index_loaded = true;
+    if (cfg.version != GameVersion::HistoryEdition)
+    {
+        return;
+    }
+
+    const std::filesystem::path rda_path = get_rda_path(cfg);
+    const auto rda_stamp = SnapshotFile::get_file_stamp(rda_path);
+    if (!rda_stamp.has_value())
+    {
+        Log::err() << "Localized strings not found: " << rda_path << '\n';
+        return;
+    }
+
+    // Use the saved index, unless the archive has changed since it was built
+    const std::filesystem::path index_path = get_texts_index_path(cfg);
+    if (std::filesystem::exists(index_path))
+    {
+        try
+        {
+            TextsIndexFile saved_index(index_path);
+            if (saved_index.get_source_stamp() == *rda_stamp)
+            {
+                texts_index = std::move(saved_index);
+                return;
+            }
+        }
+        catch (const std::exception&)
+        {
+            // Unreadable or from a different version; it will be replaced
+        }
+    }
+
+    try
+    {
+        RdaArchive archive(rda_path);
+        const RdaArchive::Entry* texts_xml = find_texts_xml(archive);
+        if (!texts_xml)
+        {
+            Log::err() << "Localized strings not found in archive: " << rda_path << '\n';
+            return;
+        }
+
+        // Parse the texts as they are decompressed, so the XML itself is never held in memory; only the texts are
+        // kept, until the index has been built from them
+        std::vector<std::pair<std::uint32_t, std::string>> texts;
+        TextsXmlParser parser(
+                [&](std::uint32_t id, std::string_view text) { texts.emplace_back(id, std::string(text)); });
+        archive.stream_entry(*texts_xml, [&](std::span<const char> piece) { parser.parse(piece); });
+        parser.finish();
+
+        texts_index.emplace(*rda_stamp, texts);
+    }
+    catch (const std::exception& e)
+    {
+        Log::err() << "Failed to read localized strings: " << e.what() << '\n';
+        return;
+    }
+
+    try
+    {
+        texts_index->save_to_path(index_path);
+    }
+    catch (const std::exception& e)
+    {
+        // Not fatal, the index is still used; it will just be built again next time
+        Log::err() << "Failed to save localization index: " << e.what() << '\n';
+    }
+}
+
+std::vector<Campaign> Tool::get_installed_campaigns() const
+{
+    return installed_campaigns;
+}
+
+std::vector<InstalledCampaign> Tool::list_campaigns() const
+{
+    std::vector<InstalledCampaign> campaigns;
+    std::vector<int> campaign_indices;
+    campaigns.reserve(installed_campaigns.size());
+    campaign_indices.reserve(installed_campaigns.size());
+    for (int i = 0; i < static_cast<int>(installed_campaigns.size()); ++i)
+    {
+        // Gaps have no scenarios (and no name), so there is nothing to report
+        if (!free_campaign_indices.contains(i))
+        {
+            campaigns.push_back({ i, installed_campaigns[i], 0 });
+            campaign_indices.push_back(i);
+        }
+    }
+
+    // Look up the progress for all campaigns at once
+    std::vector<int> campaign_progress(campaign_indices.size());
+    get_campaign_progress(campaign_indices, campaign_progress);
+    for (size_t i = 0; i < campaigns.size(); ++i)
+    {
+        campaigns[i].progress = campaign_progress[i];
+    }
+
+    return campaigns;
+}
+
+bool Tool::install_campaign(const Campaign& campaign)
+{
+    return install_campaigns({ campaign });
+}
+
+bool Tool::install_campaigns(const std::vector<Campaign>& campaigns)
+{
+    Trace::Span span("install", "Tool::install_campaigns");
+    std::optional<Trace::Span> step_span;  // replaced at the start of each step
+
+    /*
+     * 0. Sanity check
+     */
+
+    step_span.emplace("install", "Sanity check");
+
+    if (!reload_if_needed())
+    {
+        return false;
+    }
+
+    if (campaigns.empty())
+    {
+        Log::err() << "No campaigns to install!\n";
+        return false;
+    }
+
+    const std::vector<int> campaign_indices = allocate_campaign_indices(campaigns.size());
+    if (campaign_indices.back() > max_campaign_index)
+    {
+        Log::err() << "Too many campaigns installed!\n";
+        return false;
+    }
+
+    // Check everything up front, so that we don't write anything unless all campaigns can be installed
+    std::vector<ScenarioFile*> scenarios_to_link;
+    std::unordered_set<std::string> campaign_names;
+    for (const auto& campaign : campaigns)
+    {
+        if (campaign.name.empty() || campaign.level_names.empty())
+        {
+            Log::err() << "Invalid campaign data!\n";
+            return false;
+        }
+
+        if (!campaign_names.insert(campaign.name).second)
+        {
+            Log::err() << "Campaign listed more than once: " << campaign.name << '\n';
+            return false;
+        }
+
+        if (campaign.level_names.size() > Campaign::max_levels)
+        {
+            Log::err() << "Too many levels in campaign: " << campaign.name << '\n';
+            return false;
+        }
+
+        for (size_t i = 0; i < campaign.level_names.size(); ++i)
+        {
+            std::string scenario_name = campaign.name + std::to_string(i);
+            auto it = installed_scenarios.find(scenario_name);
+            if (it == installed_scenarios.end())
+            {
+                Log::err() << "Did not find expected scenario file: " << scenario_name << '\n';
+                return false;
+            }
+            scenarios_to_link.push_back(&it->second);
+        }
+    }
+
+    // All changes are made as a single transaction, so that the game files are never left half-modified
+    std::optional<FileTransaction> transaction;
+    try
+    {
+        transaction.emplace(get_journal_path(cfg), ParallelUtils::resolve_num_jobs(cfg.num_jobs));
+    }
+    catch (const std::exception& e)
+    {
+        Log::err() << "Failed to start installation: " << e.what() << '\n';
+        return false;
+    }
+
+    /*
+     * 1. Add level names to `text.cod`
+     */
+
+    step_span.emplace("install", "Add level names to text.cod");
+
+    // Changes are made to copies of `text.cod` and `Game.dat`, which only replace our own state once the transaction
+    // has been committed; if anything goes wrong, our state must still match the files on disk
+    Log::out() << "Adding level names to text.cod...\n";
+    TextCodFile new_text_cod = get_text_cod();
+    std::map<int, std::vector<std::string>> new_level_names;
+    for (size_t i = 0; i < campaigns.size(); ++i)
+    {
+        new_level_names.emplace(campaign_indices[i], campaigns[i].level_names);
+    }
+    new_text_cod.set_section_contents(TextCodFile::section_campaign,
+            rewrite_campaign_section(
+                    new_text_cod.get_section_contents(TextCodFile::section_campaign), new_level_names));
+    try
+    {
+        new_text_cod.stage_overwrite(*transaction);
+    }
+    catch (const std::exception& e)
+    {
+        Log::err() << "Failed to write to text.cod: " << e.what() << '\n';
+        return false;
+    }
+
+    /*
+     * 2. Modify scenario files
+     */
+
+    step_span.emplace("install", "Modify scenario files");
+
+    // Scenarios can't be copied, so any changes to them are reverted instead if we fail
+    const auto discard_scenario_changes = [&]() {
+        for (ScenarioFile* scenario_file : scenarios_to_link)
+        {
+            scenario_file->discard_changes();
+        }
+    };
+
+    Log::out() << "Linking scenarios to campaigns...\n";
+    std::vector<int> previous_campaign_indices;
+    previous_campaign_indices.reserve(scenarios_to_link.size());
+    size_t scenario_index = 0;
+    for (size_t i = 0; i < campaigns.size(); ++i)
+    {
+        const int campaign_index = campaign_indices[i];
+        for (size_t level = 0; level < campaigns[i].level_names.size(); ++level)
+        {
+            ScenarioFile& scenario_file = *scenarios_to_link[scenario_index++];
+            previous_campaign_indices.push_back(scenario_file.get_campaign_index());
+            scenario_file.set_campaign_index(campaign_index);
+            try
+            {
+                scenario_file.stage_overwrite(*transaction);
+            }
+            catch (const std::exception& e)
+            {
+                Log::err() << "Failed to write to " << scenario_file.get_filename() << ": " << e.what() << '\n';
+                discard_scenario_changes();
+                return false;
+            }
+        }
+    }
+
+    /*
+     * 3. Add entries to Game.dat
+     */
+
+    step_span.emplace("install", "Add entries to Game.dat");
+
+    Log::out() << "Adding entries to Game.dat...\n";
+    GameDatFile new_game_dat_file = get_game_dat_file();
+    new_game_dat_file.set_campaign_progress(campaign_indices, std::vector<int>(campaigns.size(), 0));
+    try
+    {
+        new_game_dat_file.stage_overwrite(*transaction);
+    }
+    catch (const std::exception& e)
+    {
+        Log::err() << "Failed to write to Game.dat: " << e.what() << '\n';
+        discard_scenario_changes();
+        return false;
+    }
+
+    /*
+     * 4. Apply all changes at once
+     */
+
+    step_span.emplace("install", "Apply all changes");
+
+    try
+    {
+        transaction->commit();
+    }
+    catch (const std::exception& e)
+    {
+        Log::err() << "Failed to save changes: " << e.what() << '\n';
+        discard_scenario_changes();
+        if (transaction->was_committed())
+        {
+            // Some of the changes may already have reached the disk, so our state can no longer be trusted. The
+            // transaction must let go of the journal before it can be recovered.
+            transaction.reset();
+            needs_reload = true;
+            reload_if_needed();
+        }
+        return false;
+    }
+
+    // Keep our own state up to date, in case anything else is installed later
+    step_span.emplace("install", "Update state");
+    text_cod = std::move(new_text_cod);
+    game_dat_file = std::move(new_game_dat_file);
+    for (size_t i = 0; i < scenarios_to_link.size(); ++i)
+    {
+        const ScenarioFile& scenario_file = *scenarios_to_link[i];
+        update_snapshot_entry(scenario_file.get_path(), &scenario_file);
+        move_scenario_to_campaign(
+                scenario_file.get_filename(), previous_campaign_indices[i], scenario_file.get_campaign_index());
+    }
+    save_snapshot();
+    rebuild_installed_campaigns();
+
+    Log::out() << "Success!\n";
+    return true;
+}
+
+bool Tool::uninstall_campaign(const Campaign& campaign)
+{
+    return uninstall_campaigns({ campaign });
+}
+
+bool Tool::uninstall_campaigns(const std::vector<Campaign>& campaigns)
+{
+    Trace::Span span("tool", "Tool::uninstall_campaigns");
+
+    if (!reload_if_needed())
+    {
+        return false;
+    }
+
+    if (campaigns.empty())
+    {
+        Log::err() << "No campaigns to uninstall!\n";
+        return false;
+    }
+
+    std::set<int> removed_campaign_indices;
+    for (const auto& campaign : campaigns)
+    {
+        const auto it = std::find_if(installed_campaigns.begin(),
+                installed_campaigns.end(),
+                [&](const Campaign& installed_campaign) { return installed_campaign.name == campaign.name; });
+        if (campaign.name.empty() || it == installed_campaigns.end())
+        {
+            Log::err() << "Campaign is not installed: " << campaign.name << '\n';
+            return false;
+        }
+
+        if (!removed_campaign_indices.insert(static_cast<int>(it - installed_campaigns.begin())).second)
+        {
+            Log::err() << "Campaign listed more than once: " << campaign.name << '\n';
+            return false;
+        }
+    }
+
+    // Work out where every campaign ends up, once. Nothing before the first removed campaign moves.
+    std::vector<int> new_campaign_indices(max_campaign_index + 1);
+    std::iota(new_campaign_indices.begin(), new_campaign_indices.end(), 0);
+    int num_removed_so_far = 0;
+    for (int i = *removed_campaign_indices.begin(); i <= max_campaign_index; ++i)
+    {
+        if (removed_campaign_indices.contains(i))
+        {
+            new_campaign_indices[i] = -1;
+            ++num_removed_so_far;
+        }
+        else
+        {
+            new_campaign_indices[i] = i - num_removed_so_far;
+        }
+    }
+
+    return renumber_campaigns(new_campaign_indices);
+}
+
+bool Tool::compact_campaigns()
+{
+    Trace::Span span("tool", "Tool::compact_campaigns");
+
+    if (!reload_if_needed())
+    {
+        return false;
+    }
+
+    if (free_campaign_indices.empty())
+    {
+        Log::out() << "Campaigns are already numbered consecutively\n";
+        return true;
+    }
+
+    // Installed campaigns keep their order, while anything else (gaps, and progress or level names for campaigns
+    // that don't exist) is dropped
+    std::vector<int> new_campaign_indices(max_campaign_index + 1, -1);
+    int next_campaign_index = 0;
+    for (const auto& [campaign_index, scenario_names] : campaign_scenarios)
+    {
+        new_campaign_indices[campaign_index] = next_campaign_index++;
+    }
+
+    return renumber_campaigns(new_campaign_indices);
+}
+
+bool Tool::renumber_campaigns(const std::vector<int>& new_campaign_indices)
+{
+    // Campaigns may only be removed (-1), with later campaigns moving down to fill the gaps; this is all that
+    // `rewrite_campaign_section` can express
+    Trace::Span span("tool", "Tool::renumber_campaigns");
+    std::optional<Trace::Span> step_span;  // replaced at the start of each step
+
+    step_span.emplace("renumber", "Plan changes");
+
+    // Everything before the first campaign that moves is left alone
+    int first_affected_index = 0;
+    while (first_affected_index <= max_campaign_index
+            && new_campaign_indices[first_affected_index] == first_affected_index)
+    {
+        ++first_affected_index;
+    }
+
+    // Only scenarios in the affected campaigns need to change
+    std::vector<ScenarioFile*> scenarios_to_update;
+    std::vector<int> previous_campaign_indices;
+    for (auto it = campaign_scenarios.lower_bound(first_affected_index); it != campaign_scenarios.end(); ++it)
+    {
+        for (const auto& scenario_name : it->second)
+        {
+            scenarios_to_update.push_back(&installed_scenarios.at(scenario_name));
+            previous_campaign_indices.push_back(it->first);
+        }
+    }
+
+    // All changes are made as a single transaction, so that the game files are never left half-modified
+    const unsigned num_jobs = ParallelUtils::resolve_num_jobs(cfg.num_jobs);
+    std::optional<FileTransaction> transaction;
+    try
+    {
+        transaction.emplace(get_journal_path(cfg), num_jobs);
+    }
+    catch (const std::exception& e)
+    {
+        Log::err() << "Failed to start making changes: " << e.what() << '\n';
+        return false;
+    }
+
+    /*
+     * 1. Update level names in `text.cod`
+     */
+
+    step_span.emplace("renumber", "Update text.cod");
+
+    // As when installing, changes are made to copies of `text.cod` and `Game.dat` until the transaction is committed
+    Log::out() << "Updating level names in text.cod...\n";
+    TextCodFile new_text_cod = get_text_cod();
+
+    // Removing a campaign's level names is enough to move every later campaign down
+    std::map<int, std::vector<std::string>> removed_level_names;
+    for (int i = first_affected_index; i < static_cast<int>(installed_campaigns.size()); ++i)
+    {
+        if (new_campaign_indices[i] < 0)
+        {
+            removed_level_names.emplace(i, std::vector<std::string>());
+        }
+    }
+    new_text_cod.set_section_contents(TextCodFile::section_campaign,
+            rewrite_campaign_section(
+                    new_text_cod.get_section_contents(TextCodFile::section_campaign), removed_level_names));
+    try
+    {
+        new_text_cod.stage_overwrite(*transaction);
+    }
+    catch (const std::exception& e)
+    {
+        Log::err() << "Failed to write to text.cod: " << e.what() << '\n';
+        return false;
+    }
+
+    /*
+     * 2. Modify scenario files
+     */
+
+    step_span.emplace("renumber", "Modify scenario files");
+
+    const auto discard_scenario_changes = [&]() {
+        for (ScenarioFile* scenario_file : scenarios_to_update)
+        {
+            scenario_file->discard_changes();
+        }
+    };
+
+    Log::out() << "Updating campaign indices in scenarios...\n";
+    for (size_t i = 0; i < scenarios_to_update.size(); ++i)
+    {
+        scenarios_to_update[i]->set_campaign_index(new_campaign_indices[previous_campaign_indices[i]]);
+    }
+    try
+    {
+        // Most of these are just a 4-byte patch, but scenarios leaving a campaign lose their campaign chunk, which
+        // means copying the whole file
+        ParallelUtils::parallel_for(scenarios_to_update.size(), num_jobs, [&](size_t i) {
+            scenarios_to_update[i]->stage_overwrite(*transaction);
+        });
+    }
+    catch (const std::exception& e)
+    {
+        Log::err() << "Failed to write to scenario files: " << e.what() << '\n';
+        discard_scenario_changes();
+        return false;
+    }
+
+    /*
+     * 3. Move entries in Game.dat
+     */
+
+    step_span.emplace("renumber", "Update Game.dat");
+
+    Log::out() << "Updating progress in Game.dat...\n";
+    GameDatFile new_game_dat_file = get_game_dat_file();
+    new_game_dat_file.remap_campaign_progress(new_campaign_indices);
+    try
+    {
+        new_game_dat_file.stage_overwrite(*transaction);
+    }
+    catch (const std::exception& e)
+    {
+        Log::err() << "Failed to write to Game.dat: " << e.what() << '\n';
+        discard_scenario_changes();
+        return false;
+    }
+
+    /*
+     * 4. Apply all changes at once
+     */
+
+    step_span.emplace("renumber", "Apply all changes");
+
+    try
+    {
+        transaction->commit();
+    }
+    catch (const std::exception& e)
+    {
+        Log::err() << "Failed to save changes: " << e.what() << '\n';
+        discard_scenario_changes();
+        if (transaction->was_committed())
+        {
+            // Some of the changes may already have reached the disk, so our state can no longer be trusted. The
+            // transaction must let go of the journal before it can be recovered.
+            transaction.reset();
+            needs_reload = true;
+            reload_if_needed();
+        }
+        return false;
+    }
+
+    // Keep our own state up to date, in case anything else is changed later
+    step_span.emplace("renumber", "Update state");
+    text_cod = std::move(new_text_cod);
+    game_dat_file = std::move(new_game_dat_file);
+    for (size_t i = 0; i < scenarios_to_update.size(); ++i)
+    {
+        const ScenarioFile& scenario_file = *scenarios_to_update[i];
+        update_snapshot_entry(scenario_file.get_path(), &scenario_file);
+        move_scenario_to_campaign(
+                scenario_file.get_filename(), previous_campaign_indices[i], scenario_file.get_campaign_index());
+    }
+    save_snapshot();
+    rebuild_installed_campaigns();
+
+    Log::out() << "Success!\n";
+    return true;
+}
+
+int Tool::get_main_game_progress() const
+{
+    if (!game_dat_file.has_value())
+    {
+        return snapshot.main_game_progress;
+    }
+    return game_dat_file->get_main_game_progress();
+}
+
+void Tool::set_main_game_progress(int progress)
+{
+    get_game_dat_file().set_main_game_progress(progress);
+}
+
+int Tool::get_campaign_progress(int campaign_index) const
+{
+    if (!game_dat_file.has_value())
+    {
+        const bool has_entry = campaign_index >= 0
+                && static_cast<size_t>(campaign_index) < snapshot.campaign_progress.size();
+        return has_entry ? snapshot.campaign_progress[campaign_index] : 0;
+    }
+    return game_dat_file->get_campaign_progress(campaign_index);
+}
+
+void Tool::get_campaign_progress(std::span<const int> campaign_indices, std::span<int> progress) const
+{
+    if (!game_dat_file.has_value())
+    {
+        for (size_t i = 0; i < campaign_indices.size(); ++i)
+        {
+            progress[i] = get_campaign_progress(campaign_indices[i]);
+        }
+        return;
+    }
+    game_dat_file->get_campaign_progress(campaign_indices, progress);
+}
+
+void Tool::set_campaign_progress(int campaign_index, int progress)
+{
+    get_game_dat_file().set_campaign_progress(campaign_index, progress);
+}
+
+void Tool::save_player_data()
+{
+    if (!game_dat_file.has_value())
+    {
+        // Never loaded, so nothing can have changed
+        return;
+    }
+
+    FileTransaction transaction(get_journal_path(cfg));
+    game_dat_file->stage_overwrite(transaction);
+    transaction.commit();
+    save_snapshot();
+}
+
+void Tool::discard_player_data_changes()
+{
+    game_dat_file.reset();
+    try
+    {
+        get_game_dat_file();
+    }
+    catch (const std::exception& e)
+    {
+        // We will try again when it is next needed
+        Log::err() << "Failed to reload Game.dat: " << e.what() << '\n';
+    }
+}
+
+void Tool::refresh(const std::vector<std::filesystem::path>& changed_paths, std::vector<StateChange>& changes)
+{
+    // Remember the old state so that we can report what changed
+    const std::vector<Campaign> old_campaigns = installed_campaigns;
+    std::vector<int> campaign_indices(max_campaign_index + 1);
+    std::iota(campaign_indices.begin(), campaign_indices.end(), 0);
+    std::vector<int> old_progress(campaign_indices.size());
+    get_campaign_progress(campaign_indices, old_progress);
+
+    bool has_text_cod_changed = false;
+    bool has_game_dat_changed = false;
+    std::vector<std::filesystem::path> changed_scenario_paths;
+    for (const auto& path : changed_paths)
+    {
+        if (path == cfg.anno_dir / "text.cod")
+        {
+            has_text_cod_changed = true;
+        }
+        else if (path == cfg.user_dir / "Game.dat")
+        {
+            has_game_dat_changed = true;
+        }
+        else if (path.parent_path() == cfg.anno_dir / "Szenes" && has_scenario_extension(path))
+        {
+            changed_scenario_paths.push_back(path);
+        }
+    }
+
+    if (!has_text_cod_changed && !has_game_dat_changed && changed_scenario_paths.empty())
+    {
+        // Nothing we care about (this includes our own snapshot, which must not trigger another save)
+        return;
+    }
+
+    // If we fail part-way (e.g. by catching a file mid-write), anything already refreshed must still be reported,
+    // since the next refresh would see no difference; so the error is only passed on once everything else is done.
+    // A file that failed to load is simply loaded again when it is next needed.
+    std::exception_ptr error;
+    try
+    {
+        for (const auto& path : changed_scenario_paths)
+        {
+            refresh_scenario(path, changes);
+        }
+
+        if (has_text_cod_changed)
+        {
+            text_cod.reset();
+            const auto campaign_data = get_text_cod().get_section_lines(TextCodFile::section_campaign);
+            snapshot.campaign_section_lines.assign(campaign_data.begin(), campaign_data.end());
+        }
+
+        if (has_game_dat_changed)
+        {
+            game_dat_file.reset();
+            get_game_dat_file();
+        }
+    }
+    catch (const std::exception&)
+    {
+        error = std::current_exception();
+    }
+
+    rebuild_installed_campaigns();
+
+    // Report any changes to campaigns
+    const size_t num_campaigns = std::max(old_campaigns.size(), installed_campaigns.size());
+    for (size_t i = 0; i < num_campaigns; ++i)
+    {
+        const int campaign_index = static_cast<int>(i);
+        const bool was_installed = (i < old_campaigns.size() && !old_campaigns[i].name.empty());
+        const bool is_installed = (i < installed_campaigns.size() && !installed_campaigns[i].name.empty());
+        if (!was_installed && is_installed)
+        {
+            changes.push_back({ StateChange::Type::CampaignAdded, installed_campaigns[i].name, campaign_index });
+        }
+        else if (was_installed && !is_installed)
+        {
+            changes.push_back({ StateChange::Type::CampaignRemoved, old_campaigns[i].name, campaign_index });
+        }
+        else if (was_installed && old_campaigns[i] != installed_campaigns[i])
+        {
+            changes.push_back({ StateChange::Type::CampaignChanged, installed_campaigns[i].name, campaign_index });
+        }
+    }
+
+    // Report any changes to progress (if Game.dat failed to load, we still have the old values)
+    if (has_game_dat_changed)
+    {
+        std::vector<int> new_progress(campaign_indices.size());
+        get_campaign_progress(campaign_indices, new_progress);
+        for (size_t i = 0; i < new_progress.size(); ++i)
+        {
+            if (new_progress[i] != old_progress[i])
+            {
+                const std::string& name = (i < installed_campaigns.size()) ? installed_campaigns[i].name : "";
+                changes.push_back({ StateChange::Type::ProgressChanged, name, static_cast<int>(i) });
+            }
+        }
+    }
+
+    if (error)
+    {
+        // Don't save the snapshot, as it would claim to match files that we failed to read
+        std::rethrow_exception(error);
+    }
+
+    save_snapshot();
+}
+
+void Tool::refresh_if_changed(std::vector<StateChange>& changes)
+{
+    Trace::Span span("tool", "Tool::refresh_if_changed");
+
+    // The snapshot always holds the stamps of the files as we last saw them
+    std::vector<std::filesystem::path> changed_paths;
+    const std::filesystem::path text_cod_path = cfg.anno_dir / "text.cod";
+    if (SnapshotFile::get_file_stamp(text_cod_path) != snapshot.text_cod_stamp)
+    {
+        changed_paths.push_back(text_cod_path);
+    }
+    const std::filesystem::path game_dat_path = cfg.user_dir / "Game.dat";
+    if (SnapshotFile::get_file_stamp(game_dat_path) != snapshot.game_dat_stamp)
+    {
+        changed_paths.push_back(game_dat_path);
+    }
+
+    // Scenarios that have been added or changed
+    std::unordered_map<std::string_view, const SnapshotFile::FileStamp*> known_stamps;
+    known_stamps.reserve(snapshot.scenarios.size());
+    for (const auto& entry : snapshot.scenarios)
+    {
+        known_stamps.emplace(entry.filename, &entry.stamp);
+    }
+    std::unordered_set<std::filesystem::path::string_type> found_paths;
+    for (const auto& entry : std::filesystem::directory_iterator(cfg.anno_dir / "Szenes"))
+    {
+        if (!is_scenario_file(entry))
+        {
+            continue;
+        }
+
+        found_paths.insert(entry.path().native());
+        const auto it = known_stamps.find(FileUtils::path_to_utf8(entry.path().filename()));
+        if (it == known_stamps.end() || SnapshotFile::get_file_stamp(entry) != *it->second)
+        {
+            changed_paths.push_back(entry.path());
+        }
+    }
+
+    // Scenarios that have been removed
+    for (const auto& [scenario_name, scenario] : installed_scenarios)
+    {
+        if (!found_paths.contains(scenario.get_path().native()))
+        {
+            changed_paths.push_back(scenario.get_path());
+        }
+    }
+
+    if (!changed_paths.empty())
+    {
+        refresh(changed_paths, changes);
+    }
+}
+
+bool Tool::reload_if_needed()
+{
+    if (!needs_reload)
+    {
+        return true;
+    }
+
+    Log::out() << "Reloading installation...\n";
+    try
+    {
+        // Finish applying whatever the failed transaction left behind, then read back what is on disk
+        FileTransaction::recover(get_journal_path(cfg));
+        std::vector<StateChange> changes;
+        refresh_all(changes);
+    }
+    catch (const std::exception& e)
+    {
+        Log::err() << "Failed to reload installation: " << e.what() << '\n';
+        return false;
+    }
+
+    needs_reload = false;
+    return true;
+}
+
+void Tool::refresh_all(std::vector<StateChange>& changes)
+{
+    // Everything we know about, plus everything that is there now
+    std::vector<std::filesystem::path> paths;
+    paths.push_back(cfg.anno_dir / "text.cod");
+    paths.push_back(cfg.user_dir / "Game.dat");
+    for (const auto& [scenario_name, scenario] : installed_scenarios)
+    {
+        paths.push_back(scenario.get_path());
+    }
+    for (const auto& entry : std::filesystem::directory_iterator(cfg.anno_dir / "Szenes"))
+    {
+        if (is_scenario_file(entry) && !installed_scenarios.contains(entry.path().stem().string()))
+        {
+            paths.push_back(entry.path());
+        }
+    }
+    refresh(paths, changes);
 }
 
 }  // namespace Anno
@@ -0,0 +1,268 @@
+#include "tool/watcher.h"
+
+#include <algorithm>  // find, sort, unique
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>  // memcpy, strerror
+#include <exception>
+#include <ostream>
+#include <stdexcept>
+
+#include "util/log.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace Anno {
+
+/*
+ * Helper methods
+ */
+
+static const char* get_change_type_name(StateChange::Type type)
+{
+    switch (type)
+    {
+    case StateChange::Type::ScenarioAdded:
+        return "Scenario added";
+    case StateChange::Type::ScenarioChanged:
+        return "Scenario changed";
+    case StateChange::Type::ScenarioRemoved:
+        return "Scenario removed";
+    case StateChange::Type::CampaignAdded:
+        return "Campaign added";
+    case StateChange::Type::CampaignChanged:
+        return "Campaign changed";
+    case StateChange::Type::CampaignRemoved:
+        return "Campaign removed";
+    case StateChange::Type::ProgressChanged:
+        return "Progress changed";
+    }
+    return "Unknown change";
+}
+
+/*
+ * Watcher class
+ */
+
+std::string Watcher::describe_change(const StateChange& change)
+{
+    std::string description = get_change_type_name(change.type);
+    description += ": ";
+    description += change.name;
+    if (change.campaign_index >= 0)
+    {
+        description += " (campaign " + std::to_string(change.campaign_index) + ")";
+    }
+    return description;
+}
+
+#ifdef __linux__
+
+Watcher::Watcher(Tool& tool, const Config& cfg)
+    : tool(tool)
+    , inotify_fd(inotify_init1(IN_CLOEXEC))
+{
+    if (inotify_fd < 0)
+    {
+        throw std::runtime_error("Failed to initialise inotify: " + std::string(std::strerror(errno)));
+    }
+
+    try
+    {
+        add_watch(cfg.anno_dir);
+        add_watch(cfg.anno_dir / "Szenes");
+        if (cfg.user_dir != cfg.anno_dir)
+        {
+            add_watch(cfg.user_dir);
+        }
+    }
+    catch (const std::runtime_error&)
+    {
+        close(inotify_fd);
+        throw;
+    }
+}
+
+Watcher::~Watcher()
+{
+    close(inotify_fd);
+}
+
+void Watcher::add_watch(const std::filesystem::path& dir)
+{
+    // We only care about files once they are complete, so creation itself is not interesting
+    constexpr std::uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_DELETE_SELF;
+
+    const int wd = inotify_add_watch(inotify_fd, dir.c_str(), mask);
+    if (wd < 0)
+    {
+        throw std::runtime_error("Failed to watch directory: " + dir.string() + " (" + std::strerror(errno) + ")");
+    }
+    watched_dirs[wd] = dir;
+}
+
+void Watcher::run(std::ostream& out)
+{
+    std::vector<std::filesystem::path> changed_paths;
+    while (true)
+    {
+        changed_paths.clear();
+        const bool is_complete = wait_for_changes(changed_paths);
+
+        std::vector<StateChange> changes;
+        try
+        {
+            if (is_complete)
+            {
+                // Each file only needs to be read once per batch
+                std::sort(changed_paths.begin(), changed_paths.end());
+                changed_paths.erase(std::unique(changed_paths.begin(), changed_paths.end()), changed_paths.end());
+                tool.refresh(changed_paths, changes);
+            }
+            else
+            {
+                // Some events were lost, so we have no choice but to check everything
+                tool.refresh_all(changes);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            // Probably caught a file mid-write; we will get another event once it is finished. Anything that was
+            // refreshed before the error is still reported below.
+            Log::err() << "Failed to process changes: " << e.what() << '\n';
+        }
+
+        for (const auto& change : changes)
+        {
+            out << describe_change(change) << '\n';
+        }
+        out.flush();
+    }
+}
+
+bool Watcher::wait_for_changes(std::vector<std::filesystem::path>& changed_paths)
+{
+    bool is_complete = true;
+
+    // Block until something happens
+    pollfd poll_fd { inotify_fd, POLLIN, 0 };
+    while (changed_paths.empty())
+    {
+        if (poll(&poll_fd, 1, -1) < 0 && errno != EINTR)
+        {
+            throw std::runtime_error("Failed to wait for changes: " + std::string(std::strerror(errno)));
+        }
+        is_complete &= read_events(changed_paths);
+    }
+
+    // Keep collecting events until things go quiet, or the batch has been held for too long
+    const auto batch_start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - batch_start < max_batch_delay)
+    {
+        const int result = poll(&poll_fd, 1, static_cast<int>(quiet_period.count()));
+        if (result == 0)
+        {
+            break;
+        }
+        if (result < 0 && errno != EINTR)
+        {
+            throw std::runtime_error("Failed to wait for changes: " + std::string(std::strerror(errno)));
+        }
+        is_complete &= read_events(changed_paths);
+    }
+
+    return is_complete;
+}
+
+bool Watcher::read_events(std::vector<std::filesystem::path>& changed_paths)
+{
+    alignas(inotify_event) std::array<char, 64 * 1024> buffer;
+    const ssize_t num_bytes = read(inotify_fd, buffer.data(), buffer.size());
+    if (num_bytes < 0)
+    {
+        if (errno == EINTR || errno == EAGAIN)
+        {
+            return true;
+        }
+        throw std::runtime_error("Failed to read changes: " + std::string(std::strerror(errno)));
+    }
+
+    bool is_complete = true;
+    for (ssize_t offset = 0; offset < num_bytes;)
+    {
+        inotify_event event;
+        std::memcpy(&event, buffer.data() + offset, sizeof(inotify_event));
+        const char* name = buffer.data() + offset + sizeof(inotify_event);
+        offset += sizeof(inotify_event) + event.len;
+
+        if (event.mask & IN_Q_OVERFLOW)
+        {
+            is_complete = false;
+            continue;
+        }
+        if (event.mask & IN_DELETE_SELF)
+        {
+            throw std::runtime_error("Watched directory was removed");
+        }
+        if (event.mask & IN_IGNORED)
+        {
+            // The watch is gone (e.g. the filesystem was unmounted), and its descriptor may be reused
+            const auto it = watched_dirs.find(event.wd);
+            if (it != watched_dirs.end())
+            {
+                Log::err() << "No longer watching directory: " << it->second << '\n';
+                watched_dirs.erase(it);
+            }
+            if (watched_dirs.empty())
+            {
+                throw std::runtime_error("No directories left to watch");
+            }
+            is_complete = false;
+            continue;
+        }
+
+        const auto it = watched_dirs.find(event.wd);
+        if (it == watched_dirs.end() || event.len == 0)
+        {
+            continue;
+        }
+
+        // Not all of these paths will be of interest, but the Tool can decide that
+        changed_paths.push_back(it->second / std::string(name));
+    }
+
+    return is_complete;
+}
+
+#else
+
+Watcher::Watcher(Tool& tool, const Config&)
+    : tool(tool)
+{
+    throw std::runtime_error("Watch mode is not supported on this platform");
+}
+
+Watcher::~Watcher() {}
+
+void Watcher::add_watch(const std::filesystem::path&) {}
+
+void Watcher::run(std::ostream&) {}
+
+bool Watcher::wait_for_changes(std::vector<std::filesystem::path>&)
+{
+    return false;
+}
+
+bool Watcher::read_events(std::vector<std::filesystem::path>&)
+{
+    return false;
+}
+
+#endif
+
+}  // namespace Anno
@@ -1,5 +1,7 @@
 #include "util/buffer_utils.h"
 
+#include <string>  // to_string
+
 namespace Anno { namespace BufferUtils {
 
 void append(std::vector<char>& buf, const std::vector<char>& data)
@@ -7,4 +9,16 @@ void append(std::vector<char>& buf, const std::vector<char>& data)
     buf.insert(buf.end(), data.begin(), data.end());
 }
 
+std::span<const char> read_bytes(std::span<const char> buf, size_t& offset, size_t num_bytes)
+{
+    if (offset > buf.size() || buf.size() - offset < num_bytes)
+    {
+        throw std::runtime_error("Unexpected end of buffer at offset " + std::to_string(offset));
+    }
+
+    std::span<const char> bytes = buf.subspan(offset, num_bytes);
+    offset += num_bytes;
+    return bytes;
+}
+
 }}  // namespace Anno::BufferUtils
@@ -0,0 +1,544 @@
+#include "util/json.h"
+
+#include <algorithm>  // min
+#include <charconv>
+#include <utility>  // move
+
+#include "util/text_encoding.h"
+
+namespace Anno { namespace Json {
+
+/*
+ * Helper methods
+ */
+
+// Protects against stack exhaustion from maliciously nested input
+static constexpr int max_depth = 64;
+
+static void write_string(std::string& out, std::string_view text)
+{
+    static constexpr std::string_view hex_digits = "0123456789abcdef";
+
+    out.push_back('"');
+    for (size_t pos = 0; pos < text.size();)
+    {
+        const char c = text[pos];
+        if (static_cast<unsigned char>(c) >= 0x80)
+        {
+            // Output must be valid UTF-8, so anything that isn't becomes a replacement character
+            const size_t start = pos;
+            if (TextEncoding::decode_utf8(text, pos).has_value())
+            {
+                out.append(text.substr(start, pos - start));
+            }
+            else
+            {
+                out += "\\ufffd";
+            }
+            continue;
+        }
+        ++pos;
+
+        switch (c)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                out += "\\u00";
+                out.push_back(hex_digits[(c >> 4) & 0x0f]);
+                out.push_back(hex_digits[c & 0x0f]);
+            }
+            else
+            {
+                out.push_back(c);
+            }
+        }
+    }
+    out.push_back('"');
+}
+
+/*
+ * Parser
+ */
+
+namespace {
+
+class Parser
+{
+public:
+    explicit Parser(std::string_view text)
+        : text(text)
+    {
+    }
+
+    Value parse_document()
+    {
+        Value value = parse_value(0);
+        skip_whitespace();
+        if (pos != text.size())
+        {
+            fail("Unexpected data after value");
+        }
+        return value;
+    }
+
+private:
+    [[noreturn]] void fail(const std::string& message) const
+    {
+        throw Error(message + " at offset " + std::to_string(pos));
+    }
+
+    void skip_whitespace()
+    {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+        {
+            ++pos;
+        }
+    }
+
+    bool consume(char c)
+    {
+        skip_whitespace();
+        if (pos < text.size() && text[pos] == c)
+        {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c)
+    {
+        if (!consume(c))
+        {
+            fail(std::string("Expected '") + c + "'");
+        }
+    }
+
+    bool consume_literal(std::string_view literal)
+    {
+        if (text.substr(pos, literal.size()) == literal)
+        {
+            pos += literal.size();
+            return true;
+        }
+        return false;
+    }
+
+    Value parse_value(int depth)
+    {
+        if (depth > max_depth)
+        {
+            fail("Too deeply nested");
+        }
+
+        skip_whitespace();
+        if (pos >= text.size())
+        {
+            fail("Unexpected end of input");
+        }
+
+        const char c = text[pos];
+        if (c == '{')
+        {
+            return parse_object(depth);
+        }
+        if (c == '[')
+        {
+            return parse_array(depth);
+        }
+        if (c == '"')
+        {
+            return Value(parse_string());
+        }
+        if (c == '-' || (c >= '0' && c <= '9'))
+        {
+            return parse_number();
+        }
+        if (consume_literal("true"))
+        {
+            return Value(true);
+        }
+        if (consume_literal("false"))
+        {
+            return Value(false);
+        }
+        if (consume_literal("null"))
+        {
+            return Value();
+        }
+        fail("Unexpected character");
+    }
+
+    Value parse_object(int depth)
+    {
+        expect('{');
+        std::vector<Member> members;
+        if (consume('}'))
+        {
+            return Value(std::move(members));
+        }
+
+        do
+        {
+            skip_whitespace();
+            if (pos >= text.size() || text[pos] != '"')
+            {
+                fail("Expected object key");
+            }
+            std::string key = parse_string();
+            expect(':');
+            members.push_back({ std::move(key), parse_value(depth + 1) });
+        } while (consume(','));
+
+        expect('}');
+        return Value(std::move(members));
+    }
+
+    Value parse_array(int depth)
+    {
+        expect('[');
+        std::vector<Value> values;
+        if (consume(']'))
+        {
+            return Value(std::move(values));
+        }
+
+        do
+        {
+            values.push_back(parse_value(depth + 1));
+        } while (consume(','));
+
+        expect(']');
+        return Value(std::move(values));
+    }
+
+    Value parse_number()
+    {
+        std::int64_t value = 0;
+        const auto result = std::from_chars(text.data() + pos, text.data() + text.size(), value);
+        if (result.ec != std::errc())
+        {
+            fail("Invalid number");
+        }
+        pos = result.ptr - text.data();
+
+        if (pos < text.size() && (text[pos] == '.' || text[pos] == 'e' || text[pos] == 'E'))
+        {
+            fail("Only integers are supported");
+        }
+        return Value(value);
+    }
+
+    std::uint32_t parse_hex4()
+    {
+        std::uint32_t value = 0;
+        const auto result = std::from_chars(text.data() + pos, text.data() + std::min(pos + 4, text.size()), value, 16);
+        if (result.ec != std::errc() || result.ptr != text.data() + pos + 4)
+        {
+            fail("Invalid unicode escape");
+        }
+        pos += 4;
+        return value;
+    }
+
+    std::string parse_string()
+    {
+        ++pos;  // opening quote
+
+        std::string out;
+        while (true)
+        {
+            if (pos >= text.size())
+            {
+                fail("Unterminated string");
+            }
+
+            const char c = text[pos++];
+            if (c == '"')
+            {
+                return out;
+            }
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                fail("Control character in string");
+            }
+            if (c != '\\')
+            {
+                out.push_back(c);
+                continue;
+            }
+
+            if (pos >= text.size())
+            {
+                fail("Unterminated string");
+            }
+            const char escape = text[pos++];
+            switch (escape)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                out.push_back(escape);
+                break;
+            case 'b':
+                out.push_back('\b');
+                break;
+            case 'f':
+                out.push_back('\f');
+                break;
+            case 'n':
+                out.push_back('\n');
+                break;
+            case 'r':
+                out.push_back('\r');
+                break;
+            case 't':
+                out.push_back('\t');
+                break;
+            case 'u':
+            {
+                std::uint32_t code_point = parse_hex4();
+                if (code_point >= 0xd800 && code_point <= 0xdbff)
+                {
+                    // Surrogate pair
+                    if (!consume_literal("\\u"))
+                    {
+                        fail("Unpaired surrogate");
+                    }
+                    const std::uint32_t low = parse_hex4();
+                    if (low < 0xdc00 || low > 0xdfff)
+                    {
+                        fail("Unpaired surrogate");
+                    }
+                    code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+                }
+                else if (code_point >= 0xdc00 && code_point <= 0xdfff)
+                {
+                    fail("Unpaired surrogate");
+                }
+                TextEncoding::append_utf8(out, code_point);
+                break;
+            }
+            default:
+                fail("Invalid escape sequence");
+            }
+        }
+    }
+
+    std::string_view text;
+    size_t pos = 0;
+};
+
+}  // namespace
+
+/*
+ * Value class
+ */
+
+Value::Value(bool value)
+    : type(Type::Bool)
+    , bool_value(value)
+{
+}
+
+Value::Value(int value)
+    : type(Type::Number)
+    , number_value(value)
+{
+}
+
+Value::Value(std::int64_t value)
+    : type(Type::Number)
+    , number_value(value)
+{
+}
+
+Value::Value(std::string value)
+    : type(Type::String)
+    , string_value(std::move(value))
+{
+}
+
+Value::Value(std::string_view value)
+    : type(Type::String)
+    , string_value(value)
+{
+}
+
+Value::Value(const char* value)
+    : type(Type::String)
+    , string_value(value)
+{
+}
+
+Value::Value(std::vector<Value> values)
+    : type(Type::Array)
+    , array_value(std::move(values))
+{
+}
+
+Value::Value(std::vector<Member> members)
+    : type(Type::Object)
+    , object_value(std::move(members))
+{
+}
+
+bool Value::as_bool() const
+{
+    if (type != Type::Bool)
+    {
+        throw Error("Expected a boolean");
+    }
+    return bool_value;
+}
+
+std::int64_t Value::as_int() const
+{
+    if (type != Type::Number)
+    {
+        throw Error("Expected a number");
+    }
+    return number_value;
+}
+
+const std::string& Value::as_string() const
+{
+    if (type != Type::String)
+    {
+        throw Error("Expected a string");
+    }
+    return string_value;
+}
+
+const std::vector<Value>& Value::as_array() const
+{
+    if (type != Type::Array)
+    {
+        throw Error("Expected an array");
+    }
+    return array_value;
+}
+
+const std::vector<Member>& Value::as_object() const
+{
+    if (type != Type::Object)
+    {
+        throw Error("Expected an object");
+    }
+    return object_value;
+}
+
+const Value* Value::find(std::string_view key) const
+{
+    for (const auto& member : object_value)
+    {
+        if (member.key == key)
+        {
+            return &member.value;
+        }
+    }
+    return nullptr;
+}
+
+const Value& Value::at(std::string_view key) const
+{
+    const Value* value = find(key);
+    if (value == nullptr)
+    {
+        throw Error("Missing field: " + std::string(key));
+    }
+    return *value;
+}
+
+Value& Value::set(std::string key, Value value)
+{
+    if (type == Type::Null)
+    {
+        type = Type::Object;
+    }
+    for (auto& member : object_value)
+    {
+        if (member.key == key)
+        {
+            member.value = std::move(value);
+            return member.value;
+        }
+    }
+    object_value.push_back({ std::move(key), std::move(value) });
+    return object_value.back().value;
+}
+
+void Value::write(std::string& out) const
+{
+    switch (type)
+    {
+    case Type::Null:
+        out += "null";
+        break;
+    case Type::Bool:
+        out += bool_value ? "true" : "false";
+        break;
+    case Type::Number:
+        out += std::to_string(number_value);
+        break;
+    case Type::String:
+        write_string(out, string_value);
+        break;
+    case Type::Array:
+        out.push_back('[');
+        for (size_t i = 0; i < array_value.size(); ++i)
+        {
+            if (i > 0)
+            {
+                out.push_back(',');
+            }
+            array_value[i].write(out);
+        }
+        out.push_back(']');
+        break;
+    case Type::Object:
+        out.push_back('{');
+        for (size_t i = 0; i < object_value.size(); ++i)
+        {
+            if (i > 0)
+            {
+                out.push_back(',');
+            }
+            write_string(out, object_value[i].key);
+            out.push_back(':');
+            object_value[i].value.write(out);
+        }
+        out.push_back('}');
+        break;
+    }
+}
+
+std::string Value::to_string() const
+{
+    std::string out;
+    write(out);
+    return out;
+}
+
+Value parse(std::string_view text)
+{
+    return Parser(text).parse_document();
+}
+
+}}  // namespace Anno::Json
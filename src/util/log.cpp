@@ -0,0 +1,45 @@
+#include "util/log.h"
+
+#include <iostream>
+
+namespace Anno { namespace Log {
+
+// Innermost Capture on this thread, if any
+static thread_local Capture* current_capture = nullptr;
+
+std::ostream& out()
+{
+    return current_capture != nullptr ? current_capture->discarded : std::cout;
+}
+
+std::ostream& err()
+{
+    return current_capture != nullptr ? current_capture->errors : std::cerr;
+}
+
+/*
+ * Capture class
+ */
+
+Capture::Capture()
+    : previous(current_capture)
+{
+    current_capture = this;
+}
+
+Capture::~Capture()
+{
+    current_capture = previous;
+}
+
+std::string Capture::get_errors() const
+{
+    std::string text = errors.str();
+    while (!text.empty() && text.back() == '\n')
+    {
+        text.pop_back();
+    }
+    return text;
+}
+
+}}  // namespace Anno::Log
@@ -0,0 +1,17 @@
+#include "util/parallel_utils.h"
+
+namespace Anno { namespace ParallelUtils {
+
+unsigned resolve_num_jobs(int requested_jobs)
+{
+    if (requested_jobs > 0)
+    {
+        return static_cast<unsigned>(requested_jobs);
+    }
+
+    // May return 0 if the value is not computable
+    const unsigned num_cores = std::thread::hardware_concurrency();
+    return num_cores > 0 ? num_cores : 1;
+}
+
+}}  // namespace Anno::ParallelUtils
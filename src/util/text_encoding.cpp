@@ -0,0 +1,165 @@
+#include "util/text_encoding.h"
+
+#include <array>
+
+namespace Anno { namespace TextEncoding {
+
+/*
+ * Helper methods
+ */
+
+// Code points for bytes 0x80-0x9F, which is where Windows-1252 differs from Latin-1.
+// Unassigned bytes map to the C1 control with the same value, as Windows does, so that they round-trip.
+static constexpr std::array<std::uint16_t, 32> windows1252_high_code_points = {
+    0x20AC, 0x0081, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,  //
+    0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008D, 0x017D, 0x008F,  //
+    0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,  //
+    0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x009D, 0x017E, 0x0178,  //
+};
+
+static std::optional<char> to_windows1252(std::uint32_t code_point)
+{
+    if (code_point < 0x80 || (code_point >= 0xA0 && code_point <= 0xFF))
+    {
+        return static_cast<char>(code_point);
+    }
+    for (size_t i = 0; i < windows1252_high_code_points.size(); ++i)
+    {
+        if (windows1252_high_code_points[i] == code_point)
+        {
+            return static_cast<char>(0x80 + i);
+        }
+    }
+    return std::nullopt;
+}
+
+/*
+ * Conversions
+ */
+
+void append_utf8(std::string& out, std::uint32_t code_point)
+{
+    if (code_point < 0x80)
+    {
+        out.push_back(static_cast<char>(code_point));
+    }
+    else if (code_point < 0x800)
+    {
+        out.push_back(static_cast<char>(0xc0 | (code_point >> 6)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    }
+    else if (code_point < 0x10000)
+    {
+        out.push_back(static_cast<char>(0xe0 | (code_point >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    }
+    else
+    {
+        out.push_back(static_cast<char>(0xf0 | (code_point >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    }
+}
+
+std::optional<std::uint32_t> decode_utf8(std::string_view text, size_t& pos)
+{
+    const auto lead = static_cast<unsigned char>(text[pos]);
+    if (lead < 0x80)
+    {
+        ++pos;
+        return lead;
+    }
+
+    size_t length = 0;
+    std::uint32_t code_point = 0;
+    std::uint32_t min_code_point = 0;
+    if ((lead & 0xe0) == 0xc0)
+    {
+        length = 2;
+        code_point = lead & 0x1f;
+        min_code_point = 0x80;
+    }
+    else if ((lead & 0xf0) == 0xe0)
+    {
+        length = 3;
+        code_point = lead & 0x0f;
+        min_code_point = 0x800;
+    }
+    else if ((lead & 0xf8) == 0xf0)
+    {
+        length = 4;
+        code_point = lead & 0x07;
+        min_code_point = 0x10000;
+    }
+    else
+    {
+        ++pos;
+        return std::nullopt;
+    }
+
+    if (text.size() - pos < length)
+    {
+        ++pos;
+        return std::nullopt;
+    }
+    for (size_t i = 1; i < length; ++i)
+    {
+        const auto continuation = static_cast<unsigned char>(text[pos + i]);
+        if ((continuation & 0xc0) != 0x80)
+        {
+            ++pos;
+            return std::nullopt;
+        }
+        code_point = (code_point << 6) | (continuation & 0x3f);
+    }
+
+    // Reject overlong encodings, surrogates and anything beyond the Unicode range
+    if (code_point < min_code_point || (code_point >= 0xd800 && code_point <= 0xdfff) || code_point > 0x10ffff)
+    {
+        ++pos;
+        return std::nullopt;
+    }
+
+    pos += length;
+    return code_point;
+}
+
+std::string windows1252_to_utf8(std::string_view text)
+{
+    std::string out;
+    out.reserve(text.size());
+    for (char c : text)
+    {
+        const auto byte = static_cast<unsigned char>(c);
+        if (byte < 0x80)
+        {
+            out.push_back(c);
+        }
+        else if (byte < 0xA0)
+        {
+            append_utf8(out, windows1252_high_code_points[byte - 0x80]);
+        }
+        else
+        {
+            append_utf8(out, byte);
+        }
+    }
+    return out;
+}
+
+std::string utf8_to_windows1252(std::string_view text)
+{
+    std::string out;
+    out.reserve(text.size());
+    for (size_t pos = 0; pos < text.size();)
+    {
+        const std::optional<std::uint32_t> code_point = decode_utf8(text, pos);
+        const std::optional<char> c = code_point.has_value() ? to_windows1252(*code_point) : std::nullopt;
+        out.push_back(c.value_or('?'));
+    }
+    return out;
+}
+
+}}  // namespace Anno::TextEncoding
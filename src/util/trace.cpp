@@ -0,0 +1,288 @@
+#include "util/trace.h"
+
+#include <fstream>
+#include <ios>
+#include <memory>
+#include <mutex>
+#include <utility>  // move, pair
+#include <vector>
+
+#include "util/json.h"
+#include "util/log.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <csignal>
+#include <pthread.h>
+#endif
+
+namespace Anno { namespace Trace {
+
+/*
+ * Helper methods
+ */
+
+namespace {
+
+struct Event
+{
+    const char* category;
+    const char* name;
+    std::chrono::steady_clock::time_point start_time;
+    std::chrono::steady_clock::time_point end_time;
+    std::optional<std::uint64_t> bytes;
+    std::string detail;
+};
+
+// Events are recorded into a buffer per thread, so that threads never contend with each other (the mutex is only
+// needed while the trace is being collected)
+struct ThreadBuffer
+{
+    std::mutex mutex;
+    int thread_id = 0;
+    std::vector<Event> events;
+};
+
+}  // namespace
+
+// Buffers are shared between their thread and this list, so that neither can free a buffer the other is using.
+// A buffer is dropped from the list once its thread has exited and its events have been collected.
+static std::mutex buffers_mutex;
+static std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+static int next_thread_id = 1;
+static std::chrono::steady_clock::time_point trace_start_time;
+
+// Output path of the active Session, if any; guarded by `session_mutex`
+static std::mutex session_mutex;
+static std::optional<std::filesystem::path> session_output_path;
+
+static ThreadBuffer& get_thread_buffer()
+{
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+    if (buffer == nullptr)
+    {
+        std::scoped_lock lock(buffers_mutex);
+        buffer = buffers.emplace_back(std::make_shared<ThreadBuffer>());
+        buffer->thread_id = next_thread_id++;
+    }
+    return *buffer;
+}
+
+static std::int64_t to_microseconds(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+/*
+ * Tracing
+ */
+
+void start()
+{
+    std::scoped_lock lock(buffers_mutex);
+    for (const auto& buffer : buffers)
+    {
+        std::scoped_lock buffer_lock(buffer->mutex);
+        buffer->events.clear();
+    }
+    trace_start_time = std::chrono::steady_clock::now();
+    Detail::is_enabled = true;
+}
+
+void stop(const std::filesystem::path& output_path)
+{
+    Detail::is_enabled = false;
+
+    // Collect the events from every thread. Threads that are still recording keep their buffers, and any span that
+    // ends from now on is simply dropped.
+    std::vector<std::pair<int, std::vector<Event>>> recorded_events;
+    {
+        std::scoped_lock lock(buffers_mutex);
+        for (const auto& buffer : buffers)
+        {
+            std::scoped_lock buffer_lock(buffer->mutex);
+            recorded_events.emplace_back(buffer->thread_id, std::move(buffer->events));
+            buffer->events.clear();
+        }
+        std::erase_if(buffers, [](const std::shared_ptr<ThreadBuffer>& buffer) { return buffer.use_count() == 1; });
+    }
+
+    std::vector<Json::Value> trace_events;
+    for (const auto& [thread_id, events] : recorded_events)
+    {
+        for (const auto& event : events)
+        {
+            Json::Value args = Json::Value(std::vector<Json::Member>());
+            if (event.bytes.has_value())
+            {
+                args.set("bytes", static_cast<std::int64_t>(*event.bytes));
+            }
+            if (!event.detail.empty())
+            {
+                args.set("path", event.detail);
+            }
+
+            Json::Value trace_event;
+            trace_event.set("name", event.name);
+            trace_event.set("cat", event.category);
+            trace_event.set("ph", "X");
+            trace_event.set("ts", to_microseconds(event.start_time - trace_start_time));
+            trace_event.set("dur", to_microseconds(event.end_time - event.start_time));
+            trace_event.set("pid", 1);
+            trace_event.set("tid", thread_id);
+            trace_event.set("args", std::move(args));
+            trace_events.push_back(std::move(trace_event));
+        }
+    }
+
+    Json::Value document;
+    document.set("traceEvents", std::move(trace_events));
+    document.set("displayTimeUnit", "ms");
+
+    std::ofstream file_stream(output_path, std::ios::binary);
+    if (!file_stream)
+    {
+        throw std::ios_base::failure("Failed to open file for writing: " + output_path.string());
+    }
+
+    const std::string text = document.to_string() + '\n';
+    file_stream.write(text.data(), text.size());
+    if (!file_stream)
+    {
+        throw std::ios_base::failure("Error writing file: " + output_path.string());
+    }
+}
+
+/*
+ * Session class
+ */
+
+// Writes the trace for the active Session, unless this has already been done
+static void finish_session()
+{
+    std::scoped_lock lock(session_mutex);
+    if (!session_output_path.has_value())
+    {
+        return;
+    }
+
+    try
+    {
+        stop(*session_output_path);
+    }
+    catch (const std::ios_base::failure& e)
+    {
+        Log::err() << "Failed to write trace: " << e.what() << '\n';
+    }
+    session_output_path.reset();
+}
+
+Session::Session(std::filesystem::path output_path)
+{
+    {
+        std::scoped_lock lock(session_mutex);
+        session_output_path = std::move(output_path);
+    }
+    start();
+    handle_interruptions();
+}
+
+Session::~Session()
+{
+    finish_session();
+    stop_handling_interruptions();
+}
+
+#ifdef _WIN32
+
+// Called on its own thread, after which the process is terminated
+static BOOL WINAPI handle_console_event(DWORD)
+{
+    finish_session();
+    return FALSE;
+}
+
+void Session::handle_interruptions()
+{
+    SetConsoleCtrlHandler(handle_console_event, TRUE);
+}
+
+void Session::stop_handling_interruptions()
+{
+    SetConsoleCtrlHandler(handle_console_event, FALSE);
+}
+
+#else
+
+static sigset_t get_interruption_signals()
+{
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    return signals;
+}
+
+void Session::handle_interruptions()
+{
+    // Signals are blocked here (and so in every thread started from now on), and received by a dedicated thread
+    // instead, which is free to write the trace before letting the signal take its course
+    const sigset_t signals = get_interruption_signals();
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    interruption_thread = std::thread([signals]() {
+        int signal_number = 0;
+        sigwait(&signals, &signal_number);
+
+        {
+            std::scoped_lock lock(session_mutex);
+            if (!session_output_path.has_value())
+            {
+                // Woken up by the Session finishing
+                return;
+            }
+        }
+
+        finish_session();
+        std::signal(signal_number, SIG_DFL);
+        pthread_sigmask(SIG_UNBLOCK, &signals, nullptr);
+        raise(signal_number);
+    });
+}
+
+void Session::stop_handling_interruptions()
+{
+    if (interruption_thread.joinable())
+    {
+        // The trace has already been written, so this just wakes the thread up
+        pthread_kill(interruption_thread.native_handle(), SIGTERM);
+        interruption_thread.join();
+    }
+
+    const sigset_t signals = get_interruption_signals();
+    pthread_sigmask(SIG_UNBLOCK, &signals, nullptr);
+}
+
+#endif
+
+/*
+ * Span class
+ */
+
+void Span::record()
+{
+    const auto end_time = std::chrono::steady_clock::now();
+
+    // Tracing may have stopped while the span was open
+    if (!is_enabled())
+    {
+        return;
+    }
+
+    ThreadBuffer& buffer = get_thread_buffer();
+    std::scoped_lock lock(buffer.mutex);
+    buffer.events.push_back({ category, name, start_time, end_time, bytes, std::move(detail) });
+}
+
+}}  // namespace Anno::Trace